@@ -0,0 +1,235 @@
+/*
+ * FontInventory.h - Reads the font inventory published by a running FontEnum
+ *
+ * FontEnum started with --publish copies its font list into named
+ * shared memory after every enumeration and rescan. This header is all
+ * another process needs to read it in place, without enumerating fonts
+ * itself:
+ *
+ *     FontInventoryView inventory;
+ *     if (inventory.Open()) {
+ *         for (UINT32 i = 0; i < inventory.Count(); i++) {
+ *             const FontInventoryRecord& rec = inventory.Record(i);
+ *             wprintf(L"%s %s\n", inventory.String(rec.familyName), inventory.String(rec.styleName));
+ *         }
+ *     }
+ *     ...
+ *     if (inventory.IsStale()) inventory.Open();  // Fonts were rescanned
+ *
+ * Layout
+ * ======
+ * The control section "Local\FontEnum.Inventory" (FontInventoryControl)
+ * holds the sequence number of the current inventory. Each inventory is
+ * written once into its own section, "Local\FontEnum.Inventory.<sequence>",
+ * and never changed afterwards, so a view stays valid and consistent for
+ * as long as the client keeps it, even after FontEnum publishes a newer
+ * inventory or exits. An inventory section uses FontEnum's snapshot
+ * layout:
+ *
+ *   FontInventoryHeader
+ *   FontInventoryRecord[recordCount]  at recordsOffset
+ *   wchar_t strings[stringsSize]      NUL-terminated strings, at stringsOffset
+ *
+ * Records reference strings by wchar_t offset into the string table;
+ * offset 0 is the empty string. Sections live in the session namespace,
+ * so only processes of the same logon session see them, and FontEnum
+ * creates them so that only its own user can write to them; other users
+ * can map them for reading only.
+ */
+
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>          // swprintf_s
+
+#define FONT_INVENTORY_CONTROL_NAME L"Local\\FontEnum.Inventory"
+#define FONT_INVENTORY_SECTION_NAME L"Local\\FontEnum.Inventory.%llu"   // Formatted with the sequence
+
+#define FONT_INVENTORY_MAGIC    0x49564E46  // "FNVI"
+#define FONT_INVENTORY_VERSION  1
+
+#define FONT_INVENTORY_FLAG_ITALIC      0x0001
+#define FONT_INVENTORY_FLAG_FIXED       0x0002
+#define FONT_INVENTORY_FLAG_VARIABLE    0x0004
+#define FONT_INVENTORY_FLAG_PENDING     0x0008  // Fixed pitch and axes not read yet
+
+/*
+ * FontInventoryControl - The control section
+ *
+ * sequence is 0 while nothing is published (e.g. after FontEnum exited).
+ */
+struct FontInventoryControl {
+    UINT32 magic;                   // FONT_INVENTORY_MAGIC
+    UINT32 version;                 // FONT_INVENTORY_VERSION
+    volatile LONG64 sequence;       // Current inventory section
+    volatile LONG64 lastSequence;   // Last number handed out to a publisher
+};
+
+struct FontInventoryHeader {
+    UINT32 magic;           // FONT_INVENTORY_MAGIC
+    UINT32 version;         // FONT_INVENTORY_VERSION
+    UINT64 sequence;        // Matches the section name
+    UINT64 fingerprint;     // State of the installed fonts the list was read from
+    UINT32 modeName;        // String offset: "GDI", "DirectWrite", "FontSet", "OpenType", ...
+    UINT32 recordCount;
+    UINT32 recordsOffset;   // Byte offset of the first FontInventoryRecord
+    UINT32 stringsOffset;   // Byte offset of the string table
+    UINT32 stringsSize;     // String table size in wchar_t units
+    UINT32 reserved;
+};
+
+struct FontInventoryRecord {
+    UINT32 familyName;      // String table offsets (wchar_t units)
+    UINT32 styleName;
+    UINT32 filePath;        // Empty for GDI
+    UINT32 variableAxes;    // e.g. "wght 100-900, wdth 75-100"
+    INT32 weight;           // 100-900
+    UINT16 flags;           // FONT_INVENTORY_FLAG_*
+    UINT16 charSet;         // GDI charset
+    UINT32 faceIndex;       // Face index within filePath
+};
+
+/*
+ * FontInventoryView - A read-only mapping of the current inventory
+ *
+ * Open() validates every offset once, so the accessors are plain loads.
+ * Not thread-safe to reopen while other threads read the view.
+ */
+class FontInventoryView {
+public:
+    FontInventoryView() = default;
+    ~FontInventoryView() { Close(); }
+    FontInventoryView(const FontInventoryView&) = delete;
+    FontInventoryView& operator=(const FontInventoryView&) = delete;
+
+    /*
+     * Maps the current inventory, replacing the one already open
+     *
+     * Returns false if no FontEnum is publishing or the sections are
+     * from another version.
+     */
+    bool Open()
+    {
+        Close();
+        m_hControl = OpenFileMappingW(FILE_MAP_READ, FALSE, FONT_INVENTORY_CONTROL_NAME);
+        if (!m_hControl) return false;
+        m_control = static_cast<const FontInventoryControl*>(
+            MapViewOfFile(m_hControl, FILE_MAP_READ, 0, 0, sizeof(FontInventoryControl)));
+        if (!m_control || m_control->magic != FONT_INVENTORY_MAGIC ||
+            m_control->version != FONT_INVENTORY_VERSION) {
+            Close();
+            return false;
+        }
+
+        // A newer inventory may replace the current one between reading
+        // its number and opening it; the next number is then current
+        for (int attempt = 0; attempt < 4; attempt++) {
+            UINT64 sequence = static_cast<UINT64>(m_control->sequence);
+            if (sequence == 0) break;
+            if (MapInventory(sequence)) return true;
+        }
+        Close();
+        return false;
+    }
+
+    void Close()
+    {
+        if (m_view) UnmapViewOfFile(m_view);
+        if (m_hSection) CloseHandle(m_hSection);
+        if (m_control) UnmapViewOfFile(m_control);
+        if (m_hControl) CloseHandle(m_hControl);
+        m_view = nullptr;
+        m_hSection = NULL;
+        m_control = nullptr;
+        m_hControl = NULL;
+        m_header = nullptr;
+        m_records = nullptr;
+        m_strings = nullptr;
+    }
+
+    bool IsOpen() const { return m_header != nullptr; }
+
+    /*
+     * Returns true once FontEnum has published a newer inventory (or
+     * stopped publishing); the view itself stays valid until reopened
+     */
+    bool IsStale() const
+    {
+        return !m_header || static_cast<UINT64>(m_control->sequence) != m_header->sequence;
+    }
+
+    UINT64 Sequence() const { return m_header ? m_header->sequence : 0; }
+    UINT64 Fingerprint() const { return m_header ? m_header->fingerprint : 0; }
+    const wchar_t* ModeName() const { return m_header ? String(m_header->modeName) : L""; }
+    UINT32 Count() const { return m_header ? m_header->recordCount : 0; }
+    const FontInventoryRecord& Record(UINT32 index) const { return m_records[index]; }
+
+    /*
+     * Returns the NUL-terminated string at offset (a record field)
+     */
+    const wchar_t* String(UINT32 offset) const { return m_strings + offset; }
+
+private:
+    bool MapInventory(UINT64 sequence)
+    {
+        wchar_t name[64];
+        swprintf_s(name, FONT_INVENTORY_SECTION_NAME, static_cast<unsigned long long>(sequence));
+        m_hSection = OpenFileMappingW(FILE_MAP_READ, FALSE, name);
+        if (!m_hSection) return false;
+        m_view = MapViewOfFile(m_hSection, FILE_MAP_READ, 0, 0, 0);
+        MEMORY_BASIC_INFORMATION info = {};
+        if (!m_view || !VirtualQuery(m_view, &info, sizeof(info)) || !Validate(info.RegionSize, sequence)) {
+            if (m_view) UnmapViewOfFile(m_view);
+            CloseHandle(m_hSection);
+            m_view = nullptr;
+            m_hSection = NULL;
+            m_header = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool Validate(SIZE_T size, UINT64 sequence)
+    {
+        const BYTE* data = static_cast<const BYTE*>(m_view);
+        const FontInventoryHeader* header = reinterpret_cast<const FontInventoryHeader*>(data);
+        if (size < sizeof(FontInventoryHeader) || header->magic != FONT_INVENTORY_MAGIC ||
+            header->version != FONT_INVENTORY_VERSION || header->sequence != sequence) {
+            return false;
+        }
+
+        UINT64 recordsEnd = UINT64(header->recordsOffset) + UINT64(header->recordCount) * sizeof(FontInventoryRecord);
+        UINT64 stringsEnd = UINT64(header->stringsOffset) + UINT64(header->stringsSize) * sizeof(wchar_t);
+        if (header->recordsOffset % alignof(FontInventoryRecord) != 0 || header->stringsOffset % sizeof(wchar_t) != 0 ||
+            recordsEnd > size || stringsEnd > size || header->stringsSize == 0) {
+            return false;
+        }
+
+        const FontInventoryRecord* records = reinterpret_cast<const FontInventoryRecord*>(data + header->recordsOffset);
+        const wchar_t* strings = reinterpret_cast<const wchar_t*>(data + header->stringsOffset);
+        const UINT32 stringsSize = header->stringsSize;
+        if (strings[stringsSize - 1] != L'\0' || header->modeName >= stringsSize) {
+            return false;   // Guarantees every in-range offset is NUL-terminated
+        }
+        for (UINT32 i = 0; i < header->recordCount; i++) {
+            const FontInventoryRecord& rec = records[i];
+            if (rec.familyName >= stringsSize || rec.styleName >= stringsSize ||
+                rec.filePath >= stringsSize || rec.variableAxes >= stringsSize) {
+                return false;
+            }
+        }
+
+        m_header = header;
+        m_records = records;
+        m_strings = strings;
+        return true;
+    }
+
+    HANDLE m_hControl = NULL;
+    const FontInventoryControl* m_control = nullptr;
+    HANDLE m_hSection = NULL;
+    void* m_view = nullptr;
+    const FontInventoryHeader* m_header = nullptr;
+    const FontInventoryRecord* m_records = nullptr;
+    const wchar_t* m_strings = nullptr;
+};
@@ -6,6 +6,12 @@
  * 2. DirectWrite - Modern API with better Unicode support and font metrics
  * 3. FontSet API - Windows 10+ API with access to variable font axes and file paths
  *
+ * An "All APIs" mode runs the three side by side and joins their results,
+ * "Open folder..." reads the font files under any folder through the
+ * FontSet path, and "OpenType" parses the font files' tables directly.
+ * "Families" lists one collapsible row per DirectWrite family and reads
+ * the faces only when a group is expanded or a background pass gets to it.
+ *
  * Architecture Overview
  * =====================
  * The application follows a typical Win32 GUI structure:
@@ -15,22 +21,46 @@
  *
  * Code Organization
  * =================
- * 1. Includes & Pragmas (lines ~45-55)
- * 2. Constants - Control IDs (lines ~57-65)
- * 3. Global Variables - Window handles, state (lines ~67-105)
- * 4. Data Structures - FontInfo, EnumMode (lines ~80-100)
- * 5. Utility Functions - ContainsIgnoreCase (lines ~107-115)
- * 6. Forward Declarations (lines ~117-125)
- * 7. GDI Font Enumeration (lines ~127-185)
- * 8. DirectWrite Font Enumeration (lines ~187-300)
- * 9. FontSet Font Enumeration (lines ~302-490)
- * 10. Font Data Management - ClearFonts, ApplyFilter (lines ~492-520)
- * 11. UI Update Functions - UpdateStatusText, PopulateListView (lines ~522-580)
- * 12. Preview Panel - UpdatePreview, PreviewWndProc (lines ~582-655)
- * 13. UI Creation - CreateControls (lines ~657-770)
- * 14. Layout - ResizeControls (lines ~772-785)
- * 15. Window Procedure - WndProc (lines ~787-865)
- * 16. Entry Point - wWinMain (lines ~867-920)
+ * 1. Includes & Pragmas (lines ~66-111)
+ * 2. Constants - Control IDs (lines ~113-131)
+ * 3. Constants - Custom window messages (lines ~133-158)
+ * 4. Global Variables - Window handles, state (lines ~160-182)
+ * 5. Data Structures - FontInfo, FontStore, SearchIndex, EnumJob (lines ~184-672)
+ * 6. Utility Functions - FoldCase, HashBytes, MappedFile, StageClock, ParallelForChunks (lines ~674-996)
+ * 7. Tracing - TraceLogging provider, BeginTraceActivity (lines ~998-1029)
+ * 8. Substring Search Kernel - SSE2/AVX2 FindSubstring (lines ~1031-1148)
+ * 9. Forward Declarations (lines ~1150-1182)
+ * 10. Enumeration Worker - FontBatcher, EnumerationThreadProc (lines ~1184-1314)
+ * 11. GDI Font Enumeration (lines ~1316-1416)
+ * 12. Enumeration Session - GetSessionFontCollection, GetSessionFontSet, GetSessionFontResource (lines ~1418-1758)
+ * 13. DirectWrite Font Enumeration (lines ~1760-2008)
+ * 14. FontSet Font Enumeration (lines ~2010-2439)
+ * 15. Font Folder Enumeration - ScanFontFolders, EnumerateFolderFonts (lines ~2441-2685)
+ * 16. OpenType Table Enumeration - OpenTypeReader, ReadOpenTypeFace, EnumerateOpenTypeFonts (lines ~2687-3009)
+ * 17. All APIs Enumeration - FontCollector, EnumerateAllFonts (lines ~3011-3169)
+ * 18. Enumeration Snapshots - ReadSnapshot, SaveSnapshot, ComputeFontFingerprint (lines ~3171-3662)
+ * 19. Inventory Publishing - PublishFontInventory, UnpublishFontInventory (lines ~3664-3827)
+ * 20. Coverage Index - CoverageIndex, CoverageThreadProc, SaveCoverage (lines ~3829-4289)
+ * 21. Duplicate Files - DuplicateThreadProc, SaveFileHashes, StartDuplicateScan (lines ~4291-4591)
+ * 22. Family Groups - FamilyFaceThreadProc, StartFamilyFaceLoad, ApplyFamilyGrouping (lines ~4593-4830)
+ * 23. Filter Queries - CompileQuery, TestQueryTerm, QueryNarrows (lines ~4832-5195)
+ * 24. Font Data Management - ClearFonts, SortFonts, search index, ApplyFilter (lines ~5197-5412)
+ * 25. List Sorting - BuildCollationRanks, GetSortOrder, OnColumnClick (lines ~5414-5655)
+ * 26. Type-Ahead - UpdatePrefixIndex, OnFindItem (lines ~5657-5755)
+ * 27. Background Enumeration - StartEnumeration, OnFontBatch (lines ~5757-6007)
+ * 28. Font Change Handling - StartRescan, ApplyRescan, FontCollectionWatcherProc (lines ~6009-6256)
+ * 29. Deferred Face Details - DetailThreadProc, OnCacheHint, OnFontDetails (lines ~6258-6500)
+ * 30. Coverage Results - OnCoverageBatch, OnCoverageDone (lines ~6502-6550)
+ * 31. Duplicate Results - OnDuplicatesDone (lines ~6552-6615)
+ * 32. Family Group Results - OnFamilyFaces, ToggleFamilyGroup (lines ~6617-6719)
+ * 33. UI Update Functions - UpdateStatusText, OnGetDispInfo, PopulateListView (lines ~6721-6922)
+ * 34. Preview Panel - SelectPreviewFont, OnAxisSlider, PreviewWndProc (Direct2D) (lines ~6924-7383)
+ * 35. Row Thumbnails - ThumbnailThreadProc, OnThumbnails, OnListCustomDraw (lines ~7385-7876)
+ * 36. UI Creation - CreateControls (lines ~7878-8062)
+ * 37. Layout - ResizeControls (lines ~8064-8097)
+ * 38. Window Procedure - WndProc (lines ~8099-8316)
+ * 39. Command-Line Mode - FontOutputStream, RunBenchmark, RunCommandLine (lines ~8318-8892)
+ * 40. Entry Point - wWinMain (lines ~8894-8981)
  */
 
 // ============================================================================
@@ -40,13 +70,40 @@
 #include <windows.h>
 #include <commctrl.h>      // Common controls (ListView)
 #include <dwrite_3.h>      // DirectWrite 3 for FontSet API
+#include <d2d1.h>          // Direct2D for row thumbnails
+#include <shobjidl.h>      // IFileOpenDialog (Open folder)
+#include <sddl.h>          // Security descriptors for inventory sections
+#include <TraceLoggingProvider.h>   // ETW events for WPA (see TRACING)
+#include <winmeta.h>        // WINEVENT_OPCODE_START / STOP
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>        // __cpuidex, _xgetbv, _BitScanForward
+#include <immintrin.h>     // SSE2 / AVX2 intrinsics for the filter kernel
+#define FONTENUM_SIMD 1
+#endif
 #include <vector>
 #include <string>
+#include <string_view>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <memory_resource>  // Monotonic arenas for FontBatch strings
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <stdlib.h>         // __argc / __wargv
+#include "FontInventory.h"  // Shared memory inventory layout (see INVENTORY PUBLISHING)
 
 // Link required libraries
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "dwrite.lib")
+#pragma comment(lib, "d2d1.lib")
+#pragma comment(lib, "ole32.lib")      // COM and shell items for the folder picker
+#pragma comment(lib, "shell32.lib")
+#pragma comment(lib, "advapi32.lib")   // Registry timestamps, inventory section security
 
 // Enable visual styles for modern control appearance
 #pragma comment(linker,"\"/manifestdependency:type='win32' \
@@ -66,6 +123,39 @@ processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
 #define IDC_STATUS_LABEL    1006    // Status text showing font count
 #define IDC_SEARCH_EDIT     1007    // Filter text input
 #define IDC_SEARCH_LABEL    1008    // "Filter:" label
+#define IDC_ALL_BUTTON      1009    // "All APIs" comparison button
+#define IDC_AXIS_SLIDER     1010    // First preview axis slider (PREVIEW_MAX_AXES in a row)
+#define IDC_AXIS_LABEL      1020    // First preview axis label
+#define IDC_FOLDER_BUTTON   1030    // "Open folder..." button
+#define IDC_OPENTYPE_BUTTON 1031    // "OpenType" table parser button
+#define IDC_FAMILIES_BUTTON 1032    // "Families" grouped view button
+
+// ============================================================================
+// CONSTANTS - Custom window messages
+// ============================================================================
+// Posted by the enumeration worker thread to the main window
+
+#define WM_APP_FONT_BATCH   (WM_APP + 1)    // wParam = generation, lParam = FontBatch*
+#define WM_APP_ENUM_DONE    (WM_APP + 2)    // wParam = generation, lParam = unused
+#define WM_APP_FONTS_EXPIRED (WM_APP + 3)   // System font collection expired (watcher thread)
+#define WM_APP_FONT_DETAILS (WM_APP + 4)    // wParam = details generation, lParam = FontDetailsBatch*
+#define WM_APP_COVERAGE_BATCH (WM_APP + 5)  // wParam = coverage generation, lParam = CoverageBatch*
+#define WM_APP_COVERAGE_DONE (WM_APP + 6)   // wParam = coverage generation, lParam = unused
+#define WM_APP_THUMBNAILS   (WM_APP + 7)    // wParam = unused, lParam = ThumbnailBatch*
+#define WM_APP_DUPLICATES_DONE (WM_APP + 8) // wParam = duplicate pass generation, lParam = unused
+#define WM_APP_FAMILY_FACES (WM_APP + 9)    // wParam = face loader generation, lParam = FamilyFacesBatch*
+#define WM_APP_FAMILY_FACES_DONE (WM_APP + 10) // wParam = face loader generation, lParam = unused
+
+#define IDT_FILTER_TIMER    1               // Coalesces filter edits (see FILTER_DELAY_MS)
+#define FILTER_DELAY_MS     150             // Delay after the last keystroke before filtering
+#define IDT_RESCAN_TIMER    2               // Coalesces font change notifications
+#define RESCAN_DELAY_MS     750             // Quiet period after the last font change
+
+#define FONT_BATCH_SIZE     256             // Fonts per WM_APP_FONT_BATCH message
+#define FONT_BATCH_ARENA_BYTES  (FONT_BATCH_SIZE * 256)  // First arena block of a FontBatch
+#define FONTSET_CHUNK_SIZE  64              // Font set indices handed to a thread at a time
+#define DETAIL_BATCH_SIZE   64              // Faces per WM_APP_FONT_DETAILS message
+#define COVERAGE_CHUNK_SIZE 16              // Faces per coverage work item and WM_APP_COVERAGE_BATCH
 
 // ============================================================================
 // GLOBAL VARIABLES
@@ -77,12 +167,19 @@ HWND g_hListView = NULL;         // ListView control
 HWND g_hGdiButton = NULL;        // GDI button
 HWND g_hDWriteButton = NULL;     // DirectWrite button
 HWND g_hFontSetButton = NULL;    // FontSet button
+HWND g_hAllButton = NULL;        // All APIs button
+HWND g_hFolderButton = NULL;     // Open folder button
+HWND g_hOpenTypeButton = NULL;   // OpenType parser button
+HWND g_hFamiliesButton = NULL;   // Grouped families button
 HWND g_hPreviewStatic = NULL;    // Preview panel
 HWND g_hStatusLabel = NULL;      // Status label
 HWND g_hSearchEdit = NULL;       // Filter input
 HWND g_hSearchLabel = NULL;      // "Filter:" label
 HINSTANCE g_hInstance = NULL;    // Application instance
 std::wstring g_filterText;       // Current filter string
+bool g_appliedFilterValid = false; // False once g_fonts is cleared or reordered
+int g_sortColumn = -1;           // Clicked column, or -1 for storage order (SortFonts)
+bool g_sortDescending = false;   // Sort direction of g_sortColumn (see LIST SORTING)
 
 // ============================================================================
 // DATA STRUCTURES
@@ -93,7 +190,11 @@ enum class EnumMode {
     None,        // No enumeration performed yet
     GDI,         // EnumFontFamiliesEx (legacy)
     DirectWrite, // IDWriteFontCollection (modern)
-    FontSet      // IDWriteFontSet (Windows 10+)
+    FontSet,     // IDWriteFontSet (Windows 10+)
+    All,         // All three concurrently, joined into one table
+    Folder,      // Font files under a chosen folder, via a built IDWriteFontSet
+    OpenType,    // Font files parsed directly (name/OS/2/post/fvar), no DirectWrite
+    Families     // DirectWrite families as groups, faces loaded later (see FAMILY GROUPS)
 };
 
 EnumMode g_currentMode = EnumMode::None;
@@ -103,691 +204,7675 @@ EnumMode g_currentMode = EnumMode::None;
  *
  * Different enumeration APIs provide different levels of detail:
  * - GDI: familyName, styleName, weight, italic, fixedPitch, charSet
- * - DirectWrite: Same as GDI plus better Unicode handling
- * - FontSet: All above plus filePath, variableAxes, isVariable
+ * - DirectWrite: Same as GDI plus better Unicode handling, filePath, faceIndex
+ * - FontSet: All above plus variableAxes, isVariable
+ * - All APIs: the FontSet record where there is one, plus sources
+ * - OpenType: the FontSet fields, read from the font file's own tables
+ * - Families: one group row per family (isGroup, faceCount) until its
+ *   faces are loaded as DirectWrite records
+ *
+ * FontSet enumeration only reads the cheap properties; the details that
+ * need the font file (fixedPitch, and the axes on systems without
+ * IDWriteFontSet1) are filled in later while detailsPending is set
+ * (see DEFERRED FACE DETAILS).
+ *
+ * The strings are polymorphic: enumerators construct each FontInfo on
+ * the arena of the batch it goes into (FontBatcher::Arena), so reading
+ * a face allocates nothing from the heap. Copies use the default heap.
  */
+using FontString = std::pmr::wstring;
+
 struct FontInfo {
-    std::wstring familyName;    // e.g., "Arial", "Segoe UI"
-    std::wstring styleName;     // e.g., "Regular", "Bold Italic"
-    std::wstring filePath;      // Full path to font file (FontSet API only)
-    std::wstring variableAxes;  // Variable font axes, e.g., "wght 100-900" (FontSet API only)
+    FontInfo() = default;
+    explicit FontInfo(std::pmr::memory_resource* arena)
+        : familyName(arena), styleName(arena), filePath(arena), variableAxes(arena) {}
+
+    FontString familyName;      // e.g., "Arial", "Segoe UI"
+    FontString styleName;       // e.g., "Regular", "Bold Italic"
+    FontString filePath;        // Full path to font file (DirectWrite and FontSet APIs)
+    FontString variableAxes;    // Variable font axes, e.g., "wght 100-900" (FontSet API only)
     int weight;                 // Font weight: 400=Normal, 700=Bold, etc.
     bool italic;                // Whether this is an italic/oblique style
     bool fixedPitch;            // True for monospace fonts
     bool isVariable;            // True if font has variable axes
     int charSet;                // Character set (GDI-specific)
+    UINT32 faceIndex = 0;       // Face index within filePath (TTC collections)
+    bool detailsPending = false; // File-backed details not read yet
+    BYTE sources = 0;           // FONT_SOURCE_* APIs reporting the face (All APIs mode only)
+    bool isGroup = false;       // Family row standing for its faces (Families mode only)
+    UINT32 faceCount = 0;       // Faces in the family (group rows; not kept in FontStore)
 };
 
-// Font data storage
-std::vector<FontInfo> g_fonts;              // All enumerated fonts
-std::vector<size_t> g_filteredIndices;      // Indices of fonts matching filter
-
-// Selected font state (for preview)
-std::wstring g_selectedFont;                // Selected font family name
-std::wstring g_selectedStyle;               // Selected font style name
-int g_selectedWeight = FW_NORMAL;           // Selected font weight
-bool g_selectedItalic = false;              // Selected font italic flag
-
-// ============================================================================
-// UTILITY FUNCTIONS
-// ============================================================================
-
 /*
- * Case-insensitive substring search
- * Used for filtering fonts by name
+ * FontDetails - The file-backed properties of a face
+ *
+ * Reading these requires creating a font face, which maps the font
+ * file, so they are computed on demand by the details worker.
  */
-bool ContainsIgnoreCase(const std::wstring& str, const std::wstring& substr) {
-    if (substr.empty()) return true;
-    std::wstring strLower = str;
-    std::wstring substrLower = substr;
-    std::transform(strLower.begin(), strLower.end(), strLower.begin(), ::towlower);
-    std::transform(substrLower.begin(), substrLower.end(), substrLower.begin(), ::towlower);
-    return strLower.find(substrLower) != std::wstring::npos;
-}
-
-// ============================================================================
-// FORWARD DECLARATIONS
-// ============================================================================
-
-LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
-void EnumerateGDIFonts();
-void EnumerateDirectWriteFonts();
-void EnumerateFontSetFonts();
-void PopulateListView();
-void ApplyFilter();
-void UpdateStatusText();
-void UpdatePreview();
-void ClearFonts();
-
-// ============================================================================
-// FONT ENUMERATION - GDI API
-// ============================================================================
+struct FontDetails {
+    UINT32 fontIndex = 0;       // Index into g_fonts when requested
+    bool fixedPitch = false;
+    bool isVariable = false;
+    FontString variableAxes;
+};
 
 /*
- * Callback function for GDI font enumeration
+ * StringPool - Interns strings into arena chunks
  *
- * Called once for each font face found by EnumFontFamiliesExW.
- * Extracts font information and adds unique fonts to the collection.
+ * Every distinct string is stored once, NUL-terminated, in a large
+ * chunk that never moves, and is referred to by a 32-bit ID. ID 0 is
+ * always the empty string.
  */
-int CALLBACK EnumFontFamExProc(
-    const LOGFONTW* lpelfe,
-    const TEXTMETRICW* lpntme,
-    DWORD FontType,
-    LPARAM lParam)
-{
-    // Cast to extended structure for style name access
-    const ENUMLOGFONTEXW* elfex = reinterpret_cast<const ENUMLOGFONTEXW*>(lpelfe);
-
-    FontInfo info;
-    info.familyName = lpelfe->lfFaceName;
-    info.styleName = elfex->elfStyle;
-    info.weight = lpelfe->lfWeight;
-    info.italic = lpelfe->lfItalic != 0;
-    info.fixedPitch = (lpelfe->lfPitchAndFamily & FIXED_PITCH) != 0;
-    info.charSet = lpelfe->lfCharSet;
+class StringPool {
+public:
+    StringPool() { Clear(); }
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
 
-    // Skip duplicates (same family + style combination)
-    bool exists = false;
-    for (const auto& f : g_fonts) {
-        if (f.familyName == info.familyName && f.styleName == info.styleName) {
-            exists = true;
-            break;
+    UINT32 Intern(std::wstring_view str)
+    {
+        auto it = m_ids.find(str);
+        if (it != m_ids.end()) return it->second;
+
+        size_t needed = str.size() + 1;
+        if (needed > m_chunkCapacity - m_chunkUsed) {
+            m_chunkCapacity = (std::max)(needed, CHUNK_CHARS);
+            m_chunks.emplace_back(new wchar_t[m_chunkCapacity]);
+            m_chunkUsed = 0;
         }
+        wchar_t* dest = m_chunks.back().get() + m_chunkUsed;
+        wmemcpy(dest, str.data(), str.size());
+        dest[str.size()] = L'\0';
+        m_chunkUsed += needed;
+
+        UINT32 id = static_cast<UINT32>(m_strings.size());
+        m_strings.emplace_back(dest, str.size());
+        m_ids.emplace(m_strings.back(), id);
+        return id;
     }
 
-    if (!exists) {
-        g_fonts.push_back(info);
+    // Returns the ID of str, or UINT32_MAX if it was never interned
+    UINT32 Find(std::wstring_view str) const
+    {
+        auto it = m_ids.find(str);
+        return it == m_ids.end() ? UINT32_MAX : it->second;
     }
 
-    return 1; // Return 1 to continue enumeration
-}
-
-/*
- * Enumerates fonts using the GDI EnumFontFamiliesEx API
- *
- * This is the oldest font enumeration API, available on all Windows versions.
- * Limitations:
- * - No access to font file paths
- * - No variable font axis information
- * - Limited style name accuracy for some fonts
- */
-void EnumerateGDIFonts()
-{
-    ClearFonts();
-
-    HDC hdc = GetDC(g_hWnd);
-
-    // Set up LOGFONT to enumerate all fonts
-    LOGFONTW lf = {};
-    lf.lfCharSet = DEFAULT_CHARSET;  // Enumerate all character sets
-    lf.lfFaceName[0] = L'\0';        // Enumerate all font families
-    lf.lfPitchAndFamily = 0;
+    const wchar_t* CStr(UINT32 id) const { return m_strings[id].data(); }
+    std::wstring_view View(UINT32 id) const { return m_strings[id]; }
+    size_t Count() const { return m_strings.size(); }
 
-    // Enumerate all font families
-    EnumFontFamiliesExW(hdc, &lf, EnumFontFamExProc, 0, 0);
+    void Clear()
+    {
+        m_ids.clear();
+        m_strings.clear();
+        m_chunks.clear();
+        m_chunkUsed = m_chunkCapacity = 0;
+        Intern(std::wstring_view());
+    }
 
-    ReleaseDC(g_hWnd, hdc);
+private:
+    static constexpr size_t CHUNK_CHARS = 32 * 1024;
 
-    // Sort alphabetically by family name
-    std::sort(g_fonts.begin(), g_fonts.end(),
-        [](const FontInfo& a, const FontInfo& b) {
-            return a.familyName < b.familyName;
-        });
+    std::vector<std::unique_ptr<wchar_t[]>> m_chunks;
+    size_t m_chunkUsed = 0;
+    size_t m_chunkCapacity = 0;
+    std::vector<std::wstring_view> m_strings;               // Indexed by ID
+    std::unordered_map<std::wstring_view, UINT32> m_ids;    // Views into m_chunks
+};
 
-    g_currentMode = EnumMode::GDI;
-    ApplyFilter();
-}
+#define FONT_FLAG_ITALIC    0x01
+#define FONT_FLAG_FIXED     0x02
+#define FONT_FLAG_VARIABLE  0x04
+#define FONT_FLAG_PENDING   0x08    // Details not read yet (FontInfo::detailsPending)
+#define FONT_FLAG_GROUP     0x10    // Family group row (FontInfo::isGroup)
 
-// ============================================================================
-// FONT ENUMERATION - DirectWrite API
-// ============================================================================
+#define FONT_SOURCE_GDI     0x01    // FontInfo::sources bits
+#define FONT_SOURCE_DWRITE  0x02
+#define FONT_SOURCE_FONTSET 0x04
 
 /*
- * Enumerates fonts using the DirectWrite IDWriteFontCollection API
- *
- * DirectWrite provides better support for:
- * - OpenType features
- * - Complex script shaping
- * - Font fallback
- * - Accurate style names
+ * FontStore - Compact storage for the enumerated fonts
  *
- * Available on Windows Vista and later.
+ * FontInfo is what the enumerators produce and hand over in batches;
+ * the UI thread keeps the faces here instead, as a structure of arrays.
+ * Names, paths and axis strings are interned (a family is stored once,
+ * not once per face; a TTC path once per collection), so a face costs
+ * 4 string IDs, a 16-bit weight, packed flags, the charset, the face
+ * index and the source APIs. Reordering (sorting, removals) permutes the columns by index.
  */
-void EnumerateDirectWriteFonts()
-{
-    ClearFonts();
+class FontStore {
+public:
+    FontStore() = default;
+    FontStore(const FontStore&) = delete;
+    FontStore& operator=(const FontStore&) = delete;
 
-    // Create DirectWrite factory
-    IDWriteFactory* pDWriteFactory = nullptr;
-    IDWriteFontCollection* pFontCollection = nullptr;
+    size_t size() const { return m_family.size(); }
+    bool empty() const { return m_family.empty(); }
 
-    HRESULT hr = DWriteCreateFactory(
-        DWRITE_FACTORY_TYPE_SHARED,
-        __uuidof(IDWriteFactory),
-        reinterpret_cast<IUnknown**>(&pDWriteFactory));
+    void clear()
+    {
+        m_family.clear();
+        m_style.clear();
+        m_path.clear();
+        m_axes.clear();
+        m_weight.clear();
+        m_flags.clear();
+        m_charSet.clear();
+        m_faceIndex.clear();
+        m_sources.clear();
+        m_pool.Clear();
+    }
 
-    if (FAILED(hr)) {
-        MessageBoxW(g_hWnd, L"Failed to create DirectWrite factory", L"Error", MB_OK | MB_ICONERROR);
-        return;
+    void reserve(size_t count)
+    {
+        m_family.reserve(count);
+        m_style.reserve(count);
+        m_path.reserve(count);
+        m_axes.reserve(count);
+        m_weight.reserve(count);
+        m_flags.reserve(count);
+        m_charSet.reserve(count);
+        m_faceIndex.reserve(count);
+        m_sources.reserve(count);
     }
 
-    // Get the system font collection
-    hr = pDWriteFactory->GetSystemFontCollection(&pFontCollection, FALSE);
-    if (FAILED(hr)) {
-        pDWriteFactory->Release();
-        MessageBoxW(g_hWnd, L"Failed to get system font collection", L"Error", MB_OK | MB_ICONERROR);
-        return;
+    void Add(const FontInfo& info)
+    {
+        AddInterned(m_pool.Intern(info.familyName), m_pool.Intern(info.styleName),
+            m_pool.Intern(info.filePath), m_pool.Intern(info.variableAxes), info.weight,
+            static_cast<BYTE>(
+                (info.italic ? FONT_FLAG_ITALIC : 0) |
+                (info.fixedPitch ? FONT_FLAG_FIXED : 0) |
+                (info.isVariable ? FONT_FLAG_VARIABLE : 0) |
+                (info.detailsPending ? FONT_FLAG_PENDING : 0) |
+                (info.isGroup ? FONT_FLAG_GROUP : 0)),
+            info.charSet, info.faceIndex, info.sources);
     }
 
-    UINT32 familyCount = pFontCollection->GetFontFamilyCount();
+    // Interns str for AddInterned, for loaders that share strings between faces
+    UINT32 Intern(std::wstring_view str) { return m_pool.Intern(str); }
 
-    // Iterate through each font family
-    for (UINT32 i = 0; i < familyCount; i++) {
-        IDWriteFontFamily* pFontFamily = nullptr;
-        hr = pFontCollection->GetFontFamily(i, &pFontFamily);
-        if (FAILED(hr)) continue;
+    // Appends a face whose strings are already in this store's pool
+    void AddInterned(UINT32 family, UINT32 style, UINT32 path, UINT32 axes, int weight,
+        BYTE flags, int charSet, UINT32 faceIndex, BYTE sources)
+    {
+        m_family.push_back(family);
+        m_style.push_back(style);
+        m_path.push_back(path);
+        m_axes.push_back(axes);
+        m_weight.push_back(static_cast<UINT16>(weight));
+        m_flags.push_back(flags);
+        m_charSet.push_back(static_cast<BYTE>(charSet));
+        m_faceIndex.push_back(faceIndex);
+        m_sources.push_back(sources);
+    }
 
-        // Get family name (prefer English)
-        IDWriteLocalizedStrings* pFamilyNames = nullptr;
-        hr = pFontFamily->GetFamilyNames(&pFamilyNames);
-        if (SUCCEEDED(hr)) {
-            UINT32 index = 0;
-            BOOL exists = FALSE;
+    // Expands face i back into a FontInfo (for handing between stores)
+    FontInfo Get(size_t i) const
+    {
+        FontInfo info;
+        info.familyName = Family(i);
+        info.styleName = Style(i);
+        info.filePath = Path(i);
+        info.variableAxes = Axes(i);
+        info.weight = Weight(i);
+        info.italic = IsItalic(i);
+        info.fixedPitch = IsFixedPitch(i);
+        info.isVariable = IsVariable(i);
+        info.charSet = CharSet(i);
+        info.faceIndex = FaceIndex(i);
+        info.detailsPending = DetailsPending(i);
+        info.sources = Sources(i);
+        info.isGroup = IsGroup(i);
+        return info;
+    }
 
-            // Try to find English name first
-            pFamilyNames->FindLocaleName(L"en-us", &index, &exists);
-            if (!exists) {
-                index = 0;
-            }
+    // Stores the deferred details of face i and clears its pending flag
+    void SetDetails(size_t i, const FontDetails& details)
+    {
+        m_axes[i] = m_pool.Intern(details.variableAxes);
+        m_flags[i] = static_cast<BYTE>((m_flags[i] & FONT_FLAG_ITALIC) |
+            (details.fixedPitch ? FONT_FLAG_FIXED : 0) |
+            (details.isVariable ? FONT_FLAG_VARIABLE : 0));
+    }
 
-            UINT32 length = 0;
-            pFamilyNames->GetStringLength(index, &length);
+    // String accessors return NUL-terminated views into the pool
+    std::wstring_view Family(size_t i) const { return m_pool.View(m_family[i]); }
+    std::wstring_view Style(size_t i) const { return m_pool.View(m_style[i]); }
+    std::wstring_view Path(size_t i) const { return m_pool.View(m_path[i]); }
+    std::wstring_view Axes(size_t i) const { return m_pool.View(m_axes[i]); }
+    UINT32 FamilyId(size_t i) const { return m_family[i]; }
+    UINT32 StyleId(size_t i) const { return m_style[i]; }
+    UINT32 PathId(size_t i) const { return m_path[i]; }
+    UINT32 AxesId(size_t i) const { return m_axes[i]; }
+    const StringPool& Pool() const { return m_pool; }
+
+    int Weight(size_t i) const { return m_weight[i]; }
+    bool IsItalic(size_t i) const { return (m_flags[i] & FONT_FLAG_ITALIC) != 0; }
+    bool IsFixedPitch(size_t i) const { return (m_flags[i] & FONT_FLAG_FIXED) != 0; }
+    bool IsVariable(size_t i) const { return (m_flags[i] & FONT_FLAG_VARIABLE) != 0; }
+    bool DetailsPending(size_t i) const { return (m_flags[i] & FONT_FLAG_PENDING) != 0; }
+    bool IsGroup(size_t i) const { return (m_flags[i] & FONT_FLAG_GROUP) != 0; }
+    int CharSet(size_t i) const { return m_charSet[i]; }
+    BYTE Flags(size_t i) const { return m_flags[i]; }
+    UINT32 FaceIndex(size_t i) const { return m_faceIndex[i]; }
+    BYTE Sources(size_t i) const { return m_sources[i]; }
+
+    /*
+     * Rebuilds the store as faces order[0], order[1], ...
+     *
+     * order may omit faces (they are dropped); their strings stay in the
+     * pool until the next clear().
+     */
+    void Select(const std::vector<UINT32>& order)
+    {
+        Gather(m_family, order);
+        Gather(m_style, order);
+        Gather(m_path, order);
+        Gather(m_axes, order);
+        Gather(m_weight, order);
+        Gather(m_flags, order);
+        Gather(m_charSet, order);
+        Gather(m_faceIndex, order);
+        Gather(m_sources, order);
+    }
 
-            std::wstring familyName(length + 1, L'\0');
-            pFamilyNames->GetString(index, &familyName[0], length + 1);
-            familyName.resize(length);
+private:
+    template <typename T>
+    static void Gather(std::vector<T>& column, const std::vector<UINT32>& order)
+    {
+        std::vector<T> result;
+        result.reserve(order.size());
+        for (UINT32 i : order) {
+            result.push_back(column[i]);
+        }
+        column.swap(result);
+    }
 
-            // Each family can contain multiple fonts (Regular, Bold, Italic, etc.)
-            UINT32 fontCount = pFontFamily->GetFontCount();
-            for (UINT32 j = 0; j < fontCount; j++) {
-                IDWriteFont* pFont = nullptr;
-                hr = pFontFamily->GetFont(j, &pFont);
-                if (FAILED(hr)) continue;
+    StringPool m_pool;
+    std::vector<UINT32> m_family;
+    std::vector<UINT32> m_style;
+    std::vector<UINT32> m_path;
+    std::vector<UINT32> m_axes;
+    std::vector<UINT16> m_weight;
+    std::vector<BYTE> m_flags;          // FONT_FLAG_*
+    std::vector<BYTE> m_charSet;
+    std::vector<UINT32> m_faceIndex;
+    std::vector<BYTE> m_sources;        // FONT_SOURCE_*
+};
 
-                // Get face/style name
-                IDWriteLocalizedStrings* pFaceNames = nullptr;
-                hr = pFont->GetFaceNames(&pFaceNames);
+// Font data storage
+FontStore g_fonts;                          // All enumerated fonts
+std::vector<size_t> g_filteredIndices;      // Indices of fonts matching filter
 
-                std::wstring styleName;
-                if (SUCCEEDED(hr)) {
-                    UINT32 faceIndex = 0;
-                    BOOL faceExists = FALSE;
-                    pFaceNames->FindLocaleName(L"en-us", &faceIndex, &faceExists);
-                    if (!faceExists) faceIndex = 0;
+/*
+ * SearchIndex - Case-folded names used by ApplyFilter
+ *
+ * Built once per enumeration. Every font contributes "FAMILY\0STYLE\0"
+ * to one contiguous buffer, folded with the invariant (ordinal) case
+ * mapping, so filtering never touches the FontStore strings.
+ * Entry i spans text[offsets[i]] .. text[offsets[i + 1]]; the NUL
+ * separators keep a match from spanning family and style.
+ */
+struct SearchIndex {
+    std::vector<wchar_t> text;
+    std::vector<UINT32> offsets = { 0 };    // offsets.size() == font count + 1
+};
 
-                    UINT32 faceLength = 0;
-                    pFaceNames->GetStringLength(faceIndex, &faceLength);
-                    styleName.resize(faceLength + 1);
-                    pFaceNames->GetString(faceIndex, &styleName[0], faceLength + 1);
-                    styleName.resize(faceLength);
+SearchIndex g_searchIndex;
 
-                    pFaceNames->Release();
-                }
+/*
+ * PrefixIndex - Fonts and list rows ordered by folded family name, for
+ * ListView type-ahead (see OnFindItem)
+ *
+ * Both orders are built on the first keystroke after a change: fonts
+ * when g_fonts changes, rows when g_filteredIndices does.
+ */
+struct PrefixIndex {
+    std::vector<UINT32> fonts;      // g_fonts indices by (folded family, index)
+    std::vector<UINT32> rows;       // List rows by (folded family, row)
+    std::vector<UINT32> rowRank;    // Position of each row in rows
+    bool fontsValid = false;
+    bool rowsValid = false;
+};
 
-                FontInfo info;
-                info.familyName = familyName;
-                info.styleName = styleName;
-                info.weight = pFont->GetWeight();
-                info.italic = (pFont->GetStyle() == DWRITE_FONT_STYLE_ITALIC ||
-                              pFont->GetStyle() == DWRITE_FONT_STYLE_OBLIQUE);
-
-                // Check if font is monospaced (requires IDWriteFont1)
-                info.fixedPitch = false;
-                IDWriteFont1* pFont1 = nullptr;
-                if (SUCCEEDED(pFont->QueryInterface(__uuidof(IDWriteFont1), (void**)&pFont1))) {
-                    info.fixedPitch = pFont1->IsMonospacedFont() == TRUE;
-                    pFont1->Release();
-                }
-                info.charSet = DEFAULT_CHARSET;
+PrefixIndex g_prefixIndex;
+
+/*
+ * FontSink - Receives enumerated fonts directly instead of the UI thread
+ *
+ * Used by the command-line mode. Write may be called concurrently from
+ * several enumeration threads; implementations serialize internally.
+ */
+class FontSink {
+public:
+    virtual ~FontSink() = default;
+    virtual void Write(const std::vector<FontInfo>& fonts) = 0;
+};
 
-                g_fonts.push_back(info);
+/*
+ * EnumStage - Phases of an enumeration, timed by the benchmark mode
+ */
+enum class EnumStage {
+    Factory,        // DirectWrite factory creation
+    FontSource,     // System collection / font set (or screen DC) acquisition
+    Names,          // Family and style names, weight, style
+    Paths,          // Font file path and face index
+    Details,        // Axes and monospace flag
+    Store,          // Handing results on (batches, sink)
+    Sort,           // SortFonts
+    Populate,       // Search index, filter and row text
+    Count
+};
 
-                pFont->Release();
-            }
+#define ENUM_STAGE_COUNT static_cast<size_t>(EnumStage::Count)
 
-            pFamilyNames->Release();
-        }
+/*
+ * StageTimings - Accumulated QueryPerformanceCounter ticks per EnumStage
+ *
+ * Per-face stages are added from every enumeration thread, so for
+ * parallel enumerations they measure thread time, not elapsed time.
+ */
+struct StageTimings {
+    std::atomic<INT64> ticks[ENUM_STAGE_COUNT] = {};
+};
 
-        pFontFamily->Release();
+/*
+ * AllocationCounter - Heap allocations made on behalf of a job
+ *
+ * Counted by operator new on threads inside an AllocationScope (see
+ * UTILITY FUNCTIONS); memory DirectWrite allocates internally isn't seen.
+ */
+struct AllocationCounter {
+    std::atomic<UINT64> count{ 0 };
+    std::atomic<UINT64> bytes{ 0 };
+};
+
+/*
+ * EnumJob - State shared between the UI thread and an enumeration worker
+ *
+ * The UI thread owns the job; the worker only reads mode/generation and
+ * writes the progress counters and the error result. Cancellation is
+ * cooperative: enumerators poll IsCancelled() between faces.
+ */
+struct EnumJob {
+    EnumMode mode = EnumMode::None;
+    UINT generation = 0;                    // Matches wParam of posted messages
+    std::wstring folderPath;                // Directory to scan (Folder mode)
+    std::atomic<bool> cancelled{ false };   // Set by the UI thread to stop the run
+    std::atomic<UINT32> processed{ 0 };     // Faces/families examined so far
+    std::atomic<UINT32> total{ 0 };         // Expected count (0 if unknown, e.g. GDI)
+    std::atomic<UINT32> found{ 0 };         // Fonts handed to FontBatcher
+    const wchar_t* errorText = nullptr;     // Set by the worker on failure
+
+    // Snapshot handling (see ENUMERATION SNAPSHOTS)
+    bool useSnapshot = true;                // Stream the on-disk snapshot if still valid
+    bool revalidateOnly = false;            // Only check snapshotFingerprint, don't enumerate
+    UINT64 snapshotFingerprint = 0;         // Fingerprint of the snapshot being revalidated
+    UINT64 fingerprint = 0;                 // Font state at the start of the run (worker)
+    bool fromSnapshot = false;              // Results came from the snapshot (worker)
+    bool snapshotStale = false;             // Revalidation found changed fonts (worker)
+
+    // Incremental rescan after a font change (see StartRescan)
+    bool rescan = false;                    // Results are diffed against g_fonts, not appended
+    bool checkForUpdates = false;           // Ask DirectWrite to refresh its system collection
+
+    // Output (see FontBatcher)
+    FontSink* sink = nullptr;               // Receives batches instead of the main window
+    StageTimings* timings = nullptr;        // Benchmark stage timings (see StageClock)
+    AllocationCounter allocations;          // Heap traffic of the enumerator (see RunEnumerator)
+    bool deferDetails = true;               // Leave file-backed details to the details worker
+    const EnumJob* parent = nullptr;        // All APIs run this backend belongs to
+
+    bool IsCancelled() const
+    {
+        return cancelled.load(std::memory_order_relaxed) || (parent && parent->IsCancelled());
     }
+};
 
-    pFontCollection->Release();
-    pDWriteFactory->Release();
+/*
+ * FontBatch - A group of enumerated fonts handed to the UI thread
+ *
+ * Allocated by the worker and posted via WM_APP_FONT_BATCH; the UI thread
+ * takes ownership and deletes it. The fonts' strings live in the batch's
+ * monotonic arena, which is freed in one step with the batch (declared
+ * first, so it outlives fonts).
+ */
+struct FontBatch {
+    std::pmr::monotonic_buffer_resource arena{ FONT_BATCH_ARENA_BYTES };
+    UINT generation = 0;
+    UINT32 processed = 0;       // Progress snapshot at the time of posting
+    UINT32 total = 0;
+    std::vector<FontInfo> fonts;
+};
 
-    // Sort by family name, then by style name
-    std::sort(g_fonts.begin(), g_fonts.end(),
-        [](const FontInfo& a, const FontInfo& b) {
-            if (a.familyName != b.familyName)
-                return a.familyName < b.familyName;
-            return a.styleName < b.styleName;
-        });
+// Background enumeration state (UI thread only)
+std::unique_ptr<EnumJob> g_enumJob;         // Running job, or null when idle
+std::thread g_enumThread;                   // Worker executing g_enumJob
+UINT g_enumGeneration = 0;                  // Incremented for every new job
+UINT32 g_enumProcessed = 0;                 // Progress from the latest batch
+UINT32 g_enumTotal = 0;
+bool g_fontsFromSnapshot = false;           // g_fonts was loaded from an on-disk snapshot
+UINT64 g_fontsFingerprint = 0;              // Font state g_fonts was enumerated from
+FontStore g_rescanFonts;                    // Results of a running rescan, diffed when done
+size_t g_rescanAdded = 0;                   // Outcome of the last rescan (status text)
+size_t g_rescanRemoved = 0;
+HANDLE g_hWatcherStop = NULL;               // Signals the font collection watcher to exit
+std::thread g_watcherThread;                // Waits for DirectWrite collection expiry
+unsigned g_enumThreadCount = 0;             // Parallel enumeration threads (0 = one per core, 1 = serial)
+std::wstring g_folderPath;                  // Folder scanned by Folder mode
 
-    g_currentMode = EnumMode::DirectWrite;
-    ApplyFilter();
-}
+// Selected font state (for preview)
+std::wstring g_selectedFont;                // Selected font family name
+std::wstring g_selectedStyle;               // Selected font style name
+int g_selectedWeight = FW_NORMAL;           // Selected font weight
+bool g_selectedItalic = false;              // Selected font italic flag
+std::wstring g_selectedPath;                // Selected face's file (empty for GDI)
+UINT32 g_selectedFaceIndex = 0;             // Face index within g_selectedPath
 
 // ============================================================================
-// FONT ENUMERATION - FontSet API (Windows 10+)
+// UTILITY FUNCTIONS
 // ============================================================================
 
 /*
- * Enumerates fonts using the DirectWrite IDWriteFontSet API
+ * Appends a case-folded copy of str to out
  *
- * The FontSet API (Windows 10+) provides access to:
- * - Font file paths
- * - Variable font axis information (weight ranges, width ranges, etc.)
- * - More detailed font properties
- *
- * This is the most comprehensive font enumeration API available.
+ * Uses the invariant-locale uppercase mapping, the same one that
+ * CompareStringOrdinal(..., bIgnoreCase = TRUE) uses. The mapping is
+ * one-to-one per UTF-16 code unit, so the folded text has the same length.
  */
-void EnumerateFontSetFonts()
+void FoldCaseAppend(const wchar_t* str, size_t length, std::vector<wchar_t>& out)
 {
-    ClearFonts();
+    if (length == 0) return;
+    size_t start = out.size();
+    out.resize(start + length);
+    int len = static_cast<int>(length);
+    if (LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, str, len,
+            &out[start], len, NULL, NULL, 0) != len) {
+        std::copy(str, str + length, out.begin() + start);  // Unfoldable; keep as-is
+    }
+}
 
-    // Create DirectWrite factory (version 3 required for FontSet API)
-    IDWriteFactory3* pDWriteFactory3 = nullptr;
+/*
+ * Returns a case-folded copy of str (see FoldCaseAppend)
+ */
+std::wstring FoldCase(std::wstring_view str)
+{
+    std::vector<wchar_t> folded;
+    FoldCaseAppend(str.data(), str.size(), folded);
+    return std::wstring(folded.begin(), folded.end());
+}
 
-    HRESULT hr = DWriteCreateFactory(
-        DWRITE_FACTORY_TYPE_SHARED,
-        __uuidof(IDWriteFactory3),
-        reinterpret_cast<IUnknown**>(&pDWriteFactory3));
+/*
+ * Returns the display name of an enumeration mode (also used in file names)
+ */
+const wchar_t* GetModeName(EnumMode mode)
+{
+    switch (mode) {
+        case EnumMode::GDI: return L"GDI";
+        case EnumMode::DirectWrite: return L"DirectWrite";
+        case EnumMode::FontSet: return L"FontSet";
+        case EnumMode::All: return L"All APIs";
+        case EnumMode::Folder: return L"Folder";
+        case EnumMode::OpenType: return L"OpenType";
+        case EnumMode::Families: return L"Families";
+        default: return L"No";
+    }
+}
 
-    if (FAILED(hr)) {
-        MessageBoxW(g_hWnd, L"Failed to create DirectWrite factory 3.\nThis feature requires Windows 10 or later.",
-            L"Error", MB_OK | MB_ICONERROR);
-        return;
+/*
+ * FNV-1a hash, used for fingerprints and cache keys (not cryptographic)
+ */
+#define FNV_OFFSET_BASIS    14695981039346656037ULL
+#define FNV_PRIME           1099511628211ULL
+
+UINT64 HashBytes(UINT64 hash, const void* data, size_t size)
+{
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
     }
+    return hash;
+}
 
-    // Get the system font set
-    IDWriteFontSet* pFontSet = nullptr;
-    hr = pDWriteFactory3->GetSystemFontSet(&pFontSet);
-    if (FAILED(hr)) {
-        pDWriteFactory3->Release();
-        MessageBoxW(g_hWnd, L"Failed to get system font set", L"Error", MB_OK | MB_ICONERROR);
-        return;
+/*
+ * 64-bit content hash of a byte range (the xxHash64 algorithm, seed 0)
+ *
+ * Consumes eight bytes at a time over four independent lanes, so it
+ * runs at about memory bandwidth. Used to find identical font files,
+ * not to detect tampering.
+ */
+UINT64 HashContents(const BYTE* data, size_t size)
+{
+    const UINT64 P1 = 11400714785074694791ULL, P2 = 14029467366897019727ULL, P3 = 1609587929392839161ULL;
+    const UINT64 P4 = 9650029242287828579ULL, P5 = 2870177450012600261ULL;
+    auto read64 = [](const BYTE* p) { UINT64 v; memcpy(&v, p, sizeof(v)); return v; };
+    auto round = [&](UINT64 acc, UINT64 input) { return _rotl64(acc + input * P2, 31) * P1; };
+    auto merge = [&](UINT64 acc, UINT64 lane) { return (acc ^ round(0, lane)) * P1 + P4; };
+
+    const BYTE* p = data;
+    const BYTE* end = data + size;
+    UINT64 h;
+    if (size >= 32) {
+        UINT64 v1 = P1 + P2, v2 = P2, v3 = 0, v4 = 0 - P1;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+        h = _rotl64(v1, 1) + _rotl64(v2, 7) + _rotl64(v3, 12) + _rotl64(v4, 18);
+        h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+    } else {
+        h = P5;
     }
+    h += size;
 
-    UINT32 fontCount = pFontSet->GetFontCount();
+    for (; end - p >= 8; p += 8) {
+        h = _rotl64(h ^ round(0, read64(p)), 27) * P1 + P4;
+    }
+    if (end - p >= 4) {
+        UINT32 v;
+        memcpy(&v, p, sizeof(v));
+        h = _rotl64(h ^ (v * P1), 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h = _rotl64(h ^ (*p * P5), 11) * P1;
+    }
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
 
-    // Iterate through each font in the set
-    for (UINT32 i = 0; i < fontCount; i++) {
-        IDWriteFontFaceReference* pFontFaceRef = nullptr;
-        hr = pFontSet->GetFontFaceReference(i, &pFontFaceRef);
-        if (FAILED(hr)) continue;
+/*
+ * Writes size bytes to hFile, retrying short writes
+ */
+bool WriteAll(HANDLE hFile, const void* data, size_t size)
+{
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    while (size > 0) {
+        DWORD chunk = static_cast<DWORD>((std::min)(size, static_cast<size_t>(1 << 30)));
+        DWORD written = 0;
+        if (!WriteFile(hFile, bytes, chunk, &written, NULL) || written == 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
 
-        FontInfo info;
+/*
+ * MappedFile - Read-only memory mapping of a whole file
+ *
+ * The file and mapping handles are closed as soon as the view exists;
+ * the view alone keeps the data accessible until Close().
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
 
-        // --- Extract font file path ---
-        IDWriteFontFile* pFontFile = nullptr;
-        if (SUCCEEDED(pFontFaceRef->GetFontFile(&pFontFile))) {
-            IDWriteFontFileLoader* pLoader = nullptr;
-            if (SUCCEEDED(pFontFile->GetLoader(&pLoader))) {
-                // Only local fonts have file paths
-                IDWriteLocalFontFileLoader* pLocalLoader = nullptr;
-                if (SUCCEEDED(pLoader->QueryInterface(__uuidof(IDWriteLocalFontFileLoader), (void**)&pLocalLoader))) {
-                    const void* refKey = nullptr;
-                    UINT32 refKeySize = 0;
-                    if (SUCCEEDED(pFontFile->GetReferenceKey(&refKey, &refKeySize))) {
-                        UINT32 pathLen = 0;
-                        if (SUCCEEDED(pLocalLoader->GetFilePathLengthFromKey(refKey, refKeySize, &pathLen))) {
-                            info.filePath.resize(pathLen + 1);
-                            if (SUCCEEDED(pLocalLoader->GetFilePathFromKey(refKey, refKeySize, &info.filePath[0], pathLen + 1))) {
-                                info.filePath.resize(pathLen);
-                            }
-                        }
-                    }
-                    pLocalLoader->Release();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const wchar_t* path)
+    {
+        Close();
+
+        HANDLE hFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size = {};
+        HANDLE hMapping = NULL;
+        if (GetFileSizeEx(hFile, &size) && size.QuadPart > 0 && size.QuadPart <= MAXDWORD) {
+            hMapping = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        }
+        CloseHandle(hFile);
+        if (!hMapping) return false;
+
+        m_data = static_cast<const BYTE*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(hMapping);
+        if (!m_data) return false;
+
+        m_size = static_cast<size_t>(size.QuadPart);
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+            m_data = nullptr;
+        }
+        m_size = 0;
+    }
+
+    const BYTE* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const BYTE* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+/*
+ * StageClock - Attributes elapsed time to enumeration stages
+ *
+ * Each Lap(stage) charges the time since the previous lap (or since
+ * construction) to stage. Does nothing unless the job has timings, so
+ * enumerators can keep their laps in place at negligible cost.
+ */
+class StageClock {
+public:
+    explicit StageClock(const EnumJob& job) : m_timings(job.timings)
+    {
+        if (m_timings) QueryPerformanceCounter(&m_last);
+    }
+
+    // Untimed, for code shared with workers outside an enumeration
+    StageClock() : m_timings(nullptr) {}
+
+    void Lap(EnumStage stage)
+    {
+        if (!m_timings) return;
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        m_timings->ticks[static_cast<size_t>(stage)] += now.QuadPart - m_last.QuadPart;
+        m_last = now;
+    }
+
+    // Starts the next lap without charging the time since the last one
+    // (e.g. after a parallel phase timed by per-thread clocks)
+    void Restart()
+    {
+        if (m_timings) QueryPerformanceCounter(&m_last);
+    }
+
+private:
+    StageTimings* m_timings;
+    LARGE_INTEGER m_last = {};
+};
+
+thread_local AllocationCounter* t_allocationCounter = nullptr;     // Set by AllocationScope
+
+/*
+ * AllocationScope - Counts the thread's heap allocations into counter
+ * while in scope (nullptr stops counting); restores the previous one
+ */
+class AllocationScope {
+public:
+    explicit AllocationScope(AllocationCounter* counter) : m_previous(t_allocationCounter)
+    {
+        t_allocationCounter = counter;
+    }
+    ~AllocationScope() { t_allocationCounter = m_previous; }
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    AllocationCounter* m_previous;
+};
+
+/*
+ * Global operator new/delete - the CRT heap, counted per AllocationScope
+ *
+ * The array and nothrow forms call these. Threads outside a scope only
+ * pay for the thread-local load.
+ */
+void* operator new(size_t size)
+{
+    if (AllocationCounter* counter = t_allocationCounter) {
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+        counter->bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    for (;;) {
+        if (void* p = malloc(size ? size : 1)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+/*
+ * Number of threads to use for a parallel pass over count items
+ *
+ * Honors g_enumThreadCount (0 = one per logical core) and never starts
+ * more threads than there are chunks of work.
+ */
+unsigned GetEnumThreadCount(UINT32 count, UINT32 chunkSize)
+{
+    unsigned threads = g_enumThreadCount;
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    UINT32 chunks = (count + chunkSize - 1) / chunkSize;
+    threads = (std::min)(threads, static_cast<unsigned>(chunks));
+    return threads > 0 ? threads : 1;
+}
+
+/*
+ * Runs body(begin, end, worker) over [0, count) in chunks of chunkSize
+ *
+ * Chunks are handed out dynamically from a shared counter, so a thread
+ * that hits slow faces doesn't hold up the others. The calling thread
+ * acts as worker 0; the call returns when every chunk has been processed.
+ * The threads count their allocations with the calling thread's scope.
+ */
+template <typename Body>
+void ParallelForChunks(UINT32 count, UINT32 chunkSize, unsigned threadCount, Body&& body)
+{
+    std::atomic<UINT32> next{ 0 };
+    AllocationCounter* counter = t_allocationCounter;
+    auto worker = [&](unsigned workerIndex) {
+        AllocationScope scope(counter);
+        for (;;) {
+            UINT32 begin = next.fetch_add(chunkSize);
+            if (begin >= count) break;
+            UINT32 end = (std::min)(count, begin + chunkSize);
+            body(begin, end, workerIndex);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < threadCount; t++) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// ============================================================================
+// TRACING - TraceLogging (ETW) provider
+// ============================================================================
+// Start/stop activities around enumerations, filter passes, list updates
+// and preview paints, for WPA. Events cost a single enabled check when no
+// trace session is listening, so tracing is always compiled in.
+//
+//   tracelog -start FontEnum -guid #d9453133-4f9d-4dfc-b63f-153f6fc26a90 -f FontEnum.etl
+//   tracelog -stop FontEnum
+
+TRACELOGGING_DEFINE_PROVIDER(
+    g_traceProvider,
+    "FontEnum",
+    // {d9453133-4f9d-4dfc-b63f-153f6fc26a90}
+    (0xd9453133, 0x4f9d, 0x4dfc, 0xb6, 0x3f, 0x15, 0x3f, 0x6f, 0xc2, 0x6a, 0x90));
+
+std::atomic<UINT32> g_fontFacesCreated{ 0 };    // IDWriteFontFace objects created (trace counter)
+
+/*
+ * Returns true and a new activity ID if a session is listening
+ *
+ * Callers write the start and stop events only when this returned true,
+ * so the pair stays consistent even if a session starts in between.
+ */
+bool BeginTraceActivity(GUID& activityId)
+{
+    if (!TraceLoggingProviderEnabled(g_traceProvider, 0, 0)) {
+        return false;
+    }
+    EventActivityIdControl(EVENT_ACTIVITY_CTRL_CREATE_ID, &activityId);
+    return true;
+}
+
+// ============================================================================
+// SUBSTRING SEARCH KERNEL
+// ============================================================================
+// Vectorized search used by ApplyFilter over the concatenated, folded names
+// in g_searchIndex. Candidates are found by comparing the query's first code
+// unit against 16 (AVX2) or 8 (SSE2) positions at once, then verified with
+// wmemcmp. A scalar loop handles the tail and non-x86 builds.
+
+/*
+ * Returns true if the CPU and OS support AVX2 (checked once)
+ */
+bool HasAVX2()
+{
+#ifdef FONTENUM_SIMD
+    static const bool hasAVX2 = [] {
+        int info[4] = {};
+        __cpuidex(info, 1, 0);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;   // AVX state not enabled by the OS
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return hasAVX2;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Scalar search for query in text[pos..last + query length)
+ */
+size_t FindScalar(const wchar_t* text, size_t pos, size_t last,
+    const wchar_t* query, size_t queryLen)
+{
+    for (; pos <= last; pos++) {
+        if (text[pos] == query[0] && wmemcmp(text + pos + 1, query + 1, queryLen - 1) == 0) {
+            return pos;
+        }
+    }
+    return std::wstring_view::npos;
+}
+
+#ifdef FONTENUM_SIMD
+/*
+ * Verifies each candidate bit in a movemask result (two bits per
+ * UTF-16 code unit) and returns the first real match, or npos
+ */
+inline size_t VerifyCandidates(unsigned mask, const wchar_t* text, size_t blockPos,
+    const wchar_t* query, size_t queryLen)
+{
+    while (mask) {
+        unsigned long bit;
+        _BitScanForward(&bit, mask);
+        size_t candidate = blockPos + bit / 2;
+        if (wmemcmp(text + candidate + 1, query + 1, queryLen - 1) == 0) {
+            return candidate;
+        }
+        mask &= ~(3u << bit);
+    }
+    return std::wstring_view::npos;
+}
+
+size_t FindSSE2(const wchar_t* text, size_t pos, size_t last,
+    const wchar_t* query, size_t queryLen)
+{
+    const __m128i first = _mm_set1_epi16(static_cast<short>(query[0]));
+    // Every start position in the block must be <= last, which also keeps
+    // the 8-unit load inside the buffer
+    for (; pos + 8 <= last + 1; pos += 8) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi16(block, first)));
+        if (mask) {
+            size_t match = VerifyCandidates(mask, text, pos, query, queryLen);
+            if (match != std::wstring_view::npos) return match;
+        }
+    }
+    return FindScalar(text, pos, last, query, queryLen);
+}
+
+size_t FindAVX2(const wchar_t* text, size_t pos, size_t last,
+    const wchar_t* query, size_t queryLen)
+{
+    const __m256i first = _mm256_set1_epi16(static_cast<short>(query[0]));
+    for (; pos + 16 <= last + 1; pos += 16) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + pos));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(block, first)));
+        if (mask) {
+            size_t match = VerifyCandidates(mask, text, pos, query, queryLen);
+            if (match != std::wstring_view::npos) return match;
+        }
+    }
+    return FindSSE2(text, pos, last, query, queryLen);
+}
+#endif
+
+/*
+ * Finds the first occurrence of query in text[pos..length), or npos
+ *
+ * Dispatches to the widest kernel the CPU supports. Allocation-free.
+ */
+size_t FindSubstring(const wchar_t* text, size_t length, size_t pos, std::wstring_view query)
+{
+    if (query.empty()) return pos <= length ? pos : std::wstring_view::npos;
+    if (query.size() > length || pos > length - query.size()) return std::wstring_view::npos;
+
+    size_t last = length - query.size();  // Last valid start position
+#ifdef FONTENUM_SIMD
+    if (HasAVX2()) {
+        return FindAVX2(text, pos, last, query.data(), query.size());
+    }
+    return FindSSE2(text, pos, last, query.data(), query.size());
+#else
+    return FindScalar(text, pos, last, query.data(), query.size());
+#endif
+}
+
+// ============================================================================
+// FORWARD DECLARATIONS
+// ============================================================================
+
+LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
+void EnumerateGDIFonts(EnumJob& job);
+void EnumerateDirectWriteFonts(EnumJob& job);
+void EnumerateFontSetFonts(EnumJob& job);
+void EnumerateAllFonts(EnumJob& job);
+void EnumerateFolderFonts(EnumJob& job);
+void EnumerateOpenTypeFonts(EnumJob& job);
+void EnumerateDirectWriteFamilies(EnumJob& job);
+void StartEnumeration(EnumMode mode, bool useSnapshot = true);
+UINT64 ComputeFontFingerprint(const EnumJob* job);
+bool LoadSnapshotBatches(EnumJob& job);
+void ApplyRescan(const FontStore& fresh);
+void StartDetailSweep();
+void CancelEnumeration();
+void PopulateListView();
+void ApplyFilter();
+void UpdateStatusText();
+void UpdatePreview();
+void SelectPreviewFont();
+void ResizeControls(HWND hWnd);
+void ClearFonts();
+void RebuildSearchIndex();
+void ResetQueryMemos();
+void ShowSourceColumns(bool show);
+void InvalidateSortOrders(int column);
+void ApplySortOrder();
+const std::vector<UINT32>& GetSortOrder(int column);
+void UpdateSortArrows();
+int FindRowForFont(size_t fontIndex);
+
+// ============================================================================
+// ENUMERATION WORKER - Batching results back to the UI thread
+// ============================================================================
+
+/*
+ * Collects fonts produced by an enumerator and posts them to the main
+ * window in groups of FONT_BATCH_SIZE, so the list fills progressively
+ * without a message per font. Any remainder is posted on destruction.
+ * Jobs with a sink hand each group to the sink instead and reuse the
+ * batch's arena for the next group.
+ */
+class FontBatcher {
+public:
+    explicit FontBatcher(EnumJob& job) : m_job(job) {}
+    ~FontBatcher() { Flush(); }
+
+    FontBatcher(const FontBatcher&) = delete;
+    FontBatcher& operator=(const FontBatcher&) = delete;
+
+    /*
+     * Returns the arena of the batch the next Add goes into; a FontInfo
+     * constructed on it is moved into the batch without copying
+     */
+    std::pmr::memory_resource* Arena()
+    {
+        if (!m_batch) {
+            m_batch = std::make_unique<FontBatch>();
+            m_batch->fonts.reserve(FONT_BATCH_SIZE);
+        }
+        return &m_batch->arena;
+    }
+
+    void Add(FontInfo&& info)
+    {
+        m_job.found++;
+        Arena();
+        m_batch->fonts.push_back(std::move(info));
+        if (m_batch->fonts.size() >= FONT_BATCH_SIZE) {
+            Flush();
+        }
+    }
+
+    void Flush()
+    {
+        if (!m_batch || m_batch->fonts.empty()) {
+            return;
+        }
+        if (m_job.IsCancelled()) {
+            m_batch->fonts.clear();
+            m_batch->arena.release();
+            return;
+        }
+        if (m_job.sink) {
+            m_job.sink->Write(m_batch->fonts);   // Sinks copy what they keep
+            m_batch->fonts.clear();
+            m_batch->arena.release();
+            return;
+        }
+        m_batch->generation = m_job.generation;
+        m_batch->processed = m_job.processed.load();
+        m_batch->total = m_job.total.load();
+        if (PostMessageW(g_hWnd, WM_APP_FONT_BATCH, m_job.generation,
+                reinterpret_cast<LPARAM>(m_batch.get()))) {
+            m_batch.release();  // Now owned by the UI thread
+        } else {
+            m_batch.reset();
+        }
+    }
+
+private:
+    EnumJob& m_job;
+    std::unique_ptr<FontBatch> m_batch;
+};
+
+/*
+ * Runs the enumerator for the job's mode inside an "Enumerate" trace activity
+ */
+void RunEnumerator(EnumJob& job)
+{
+    AllocationScope allocationScope(&job.allocations);
+    GUID activity;
+    bool tracing = BeginTraceActivity(activity);
+    UINT32 facesBefore = g_fontFacesCreated.load();
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "Enumerate", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_START),
+            TraceLoggingWideString(GetModeName(job.mode), "Mode"));
+    }
+
+    switch (job.mode) {
+        case EnumMode::GDI: EnumerateGDIFonts(job); break;
+        case EnumMode::DirectWrite: EnumerateDirectWriteFonts(job); break;
+        case EnumMode::FontSet: EnumerateFontSetFonts(job); break;
+        case EnumMode::All: EnumerateAllFonts(job); break;
+        case EnumMode::Folder: EnumerateFolderFonts(job); break;
+        case EnumMode::OpenType: EnumerateOpenTypeFonts(job); break;
+        case EnumMode::Families: EnumerateDirectWriteFamilies(job); break;
+        default: break;
+    }
+
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "Enumerate", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+            TraceLoggingWideString(GetModeName(job.mode), "Mode"),
+            TraceLoggingUInt32(job.processed.load(), "Processed"),
+            TraceLoggingUInt32(job.found.load(), "FontsFound"),
+            TraceLoggingUInt32(g_fontFacesCreated.load() - facesBefore, "FacesCreated"),
+            TraceLoggingUInt64(job.allocations.count.load(), "HeapAllocations"),
+            TraceLoggingUInt64(job.allocations.bytes.load(), "HeapBytes"),
+            TraceLoggingBool(job.IsCancelled(), "Cancelled"),
+            TraceLoggingBool(job.errorText != nullptr, "Failed"));
+    }
+}
+
+/*
+ * Worker thread entry point - serves the job from its snapshot when the
+ * installed fonts are unchanged, otherwise runs the enumerator for the
+ * job's mode, and notifies the UI thread when it finishes (or is cancelled)
+ */
+void EnumerationThreadProc(EnumJob* job)
+{
+    job->fingerprint = ComputeFontFingerprint(job);
+
+    if (job->revalidateOnly) {
+        // The UI already shows the snapshot; just report whether it's stale
+        job->snapshotStale = job->fingerprint != job->snapshotFingerprint;
+    } else if (!job->useSnapshot || !LoadSnapshotBatches(*job)) {
+        RunEnumerator(*job);
+    }
+    PostMessageW(g_hWnd, WM_APP_ENUM_DONE, job->generation, 0);
+}
+
+// ============================================================================
+// FONT ENUMERATION - GDI API
+// ============================================================================
+
+/*
+ * State passed to EnumFontFamExProc through its LPARAM
+ */
+struct GdiEnumState {
+    EnumJob* job;
+    FontBatcher* batcher;
+    std::unordered_set<std::wstring> seen;  // Family + style keys already added (see MakeGdiFontKey)
+};
+
+/*
+ * Builds the de-duplication key for a GDI face
+ *
+ * GDI reports the same face once per charset under DEFAULT_CHARSET, so
+ * faces are keyed by family and style; NUL can't occur in either name.
+ */
+std::wstring MakeGdiFontKey(std::wstring_view familyName, std::wstring_view styleName)
+{
+    std::wstring key;
+    key.reserve(familyName.size() + 1 + styleName.size());
+    key += familyName;
+    key += L'\0';
+    key += styleName;
+    return key;
+}
+
+/*
+ * Callback function for GDI font enumeration
+ *
+ * Called once for each font face found by EnumFontFamiliesExW.
+ * Extracts font information and adds unique fonts to the collection.
+ */
+int CALLBACK EnumFontFamExProc(
+    const LOGFONTW* lpelfe,
+    const TEXTMETRICW* lpntme,
+    DWORD FontType,
+    LPARAM lParam)
+{
+    GdiEnumState* state = reinterpret_cast<GdiEnumState*>(lParam);
+    if (state->job->IsCancelled()) {
+        return 0; // Return 0 to stop enumeration
+    }
+    state->job->processed++;
+
+    // Cast to extended structure for style name access
+    const ENUMLOGFONTEXW* elfex = reinterpret_cast<const ENUMLOGFONTEXW*>(lpelfe);
+
+    FontInfo info(state->batcher->Arena());
+    info.familyName = lpelfe->lfFaceName;
+    info.styleName = elfex->elfStyle;
+    info.weight = lpelfe->lfWeight;
+    info.italic = lpelfe->lfItalic != 0;
+    info.fixedPitch = (lpelfe->lfPitchAndFamily & FIXED_PITCH) != 0;
+    info.isVariable = false;
+    info.charSet = lpelfe->lfCharSet;
+
+    // Skip duplicates (same family + style combination)
+    if (state->seen.insert(MakeGdiFontKey(info.familyName, info.styleName)).second) {
+        state->batcher->Add(std::move(info));
+    }
+
+    return 1; // Return 1 to continue enumeration
+}
+
+/*
+ * Enumerates fonts using the GDI EnumFontFamiliesEx API
+ *
+ * This is the oldest font enumeration API, available on all Windows versions.
+ * Limitations:
+ * - No access to font file paths
+ * - No variable font axis information
+ * - Limited style name accuracy for some fonts
+ *
+ * Runs on the enumeration worker thread, so it uses a screen DC rather
+ * than the main window's DC.
+ */
+void EnumerateGDIFonts(EnumJob& job)
+{
+    StageClock clock(job);
+    FontBatcher batcher(job);
+    GdiEnumState state = { &job, &batcher, {} };
+    state.seen.reserve(4096);
+
+    HDC hdc = GetDC(NULL);
+    clock.Lap(EnumStage::FontSource);
+
+    // Set up LOGFONT to enumerate all fonts
+    LOGFONTW lf = {};
+    lf.lfCharSet = DEFAULT_CHARSET;  // Enumerate all character sets
+    lf.lfFaceName[0] = L'\0';        // Enumerate all font families
+    lf.lfPitchAndFamily = 0;
+
+    // Enumerate all font families
+    EnumFontFamiliesExW(hdc, &lf, EnumFontFamExProc, reinterpret_cast<LPARAM>(&state), 0);
+    clock.Lap(EnumStage::Names);    // GDI reports everything in one callback
+
+    ReleaseDC(NULL, hdc);
+}
+
+// ============================================================================
+// ENUMERATION SESSION - DirectWrite objects kept across enumerations
+// ============================================================================
+
+/*
+ * The session holds the shared DirectWrite factory, the system font
+ * collection and the system font set for as long as the process runs, so
+ * each mode button, the face loader and the details worker take the
+ * already-loaded objects instead of fetching them again. A warm-up
+ * thread loads them right after the window first paints, so the first
+ * click doesn't start cold either.
+ *
+ * Objects are loaded outside the lock and installed under it; a thread
+ * that loses the race releases its copy. A refresh (a rescan after a
+ * font change, or collection expiry) drops everything, and the next
+ * caller loads the new state.
+ *
+ * The session also caches one IDWriteFontFile per font file path, shared
+ * by every face of a TTC/OTC, and one IDWriteFontResource per face index,
+ * shared by the named instances of a variable font. Only the details
+ * worker uses them, so the worker releases them whenever its sweep runs
+ * out of work instead of keeping them for the life of the process.
+ */
+#define FONT_SESSION_FILE_LIMIT     4096    // Font files kept in the resource cache
+
+/*
+ * FontSessionFile - A cached font file and the resources of its faces
+ */
+struct FontSessionFile {
+    IDWriteFontFile* pFontFile = nullptr;
+    std::vector<IDWriteFontResource*> resources;    // By face index; nullptr until created
+};
+
+/*
+ * FontSession - The shared DirectWrite state (see above)
+ */
+struct FontSession {
+    std::mutex mutex;                           // Guards everything below
+    IDWriteFactory* pFactory = nullptr;
+    IDWriteFontCollection* pCollection = nullptr;
+    IDWriteFontSet* pFontSet = nullptr;         // nullptr before Windows 10
+    std::unordered_map<std::wstring, FontSessionFile> files;
+};
+
+FontSession g_fontSession;
+std::thread g_sessionWarmupThread;
+
+/*
+ * Releases the cached font files and resources (lock held)
+ */
+void ClearSessionFiles()
+{
+    for (auto& entry : g_fontSession.files) {
+        for (IDWriteFontResource* pResource : entry.second.resources) {
+            if (pResource) pResource->Release();
+        }
+        entry.second.pFontFile->Release();
+    }
+    g_fontSession.files.clear();
+}
+
+/*
+ * Releases the cached font files and resources
+ *
+ * Called by the details worker once its sweep is done; later requests
+ * start a new cache.
+ */
+void ReleaseSessionFiles()
+{
+    std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+    ClearSessionFiles();
+}
+
+/*
+ * Returns the shared factory (AddRef'd), creating it on first use
+ */
+HRESULT GetSessionFactory(IDWriteFactory** ppFactory)
+{
+    std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+    if (!g_fontSession.pFactory) {
+        HRESULT hr = DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory),
+            reinterpret_cast<IUnknown**>(&g_fontSession.pFactory));
+        if (FAILED(hr)) {
+            g_fontSession.pFactory = nullptr;
+            return hr;
+        }
+    }
+    g_fontSession.pFactory->AddRef();
+    *ppFactory = g_fontSession.pFactory;
+    return S_OK;
+}
+
+/*
+ * Drops the session's collection, font set and cached files
+ *
+ * The next caller loads the current system state.
+ */
+void InvalidateFontSession()
+{
+    std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+    if (g_fontSession.pCollection) { g_fontSession.pCollection->Release(); g_fontSession.pCollection = nullptr; }
+    if (g_fontSession.pFontSet) { g_fontSession.pFontSet->Release(); g_fontSession.pFontSet = nullptr; }
+    ClearSessionFiles();
+}
+
+/*
+ * Returns the session's factory and system font collection (both AddRef'd)
+ *
+ * checkForUpdates asks DirectWrite to refresh its cached collection and
+ * replaces the session's state with the result.
+ */
+HRESULT GetSessionFontCollection(BOOL checkForUpdates, IDWriteFactory** ppFactory, IDWriteFontCollection** ppCollection)
+{
+    HRESULT hr = GetSessionFactory(ppFactory);
+    if (FAILED(hr)) return hr;
+
+    if (checkForUpdates) {
+        InvalidateFontSession();
+    } else {
+        std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+        if (g_fontSession.pCollection) {
+            g_fontSession.pCollection->AddRef();
+            *ppCollection = g_fontSession.pCollection;
+            return S_OK;
+        }
+    }
+
+    IDWriteFontCollection* pCollection = nullptr;
+    hr = (*ppFactory)->GetSystemFontCollection(&pCollection, checkForUpdates);
+    if (FAILED(hr)) {
+        (*ppFactory)->Release();
+        *ppFactory = nullptr;
+        return hr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+    if (g_fontSession.pCollection && !checkForUpdates) {
+        pCollection->Release();     // Another thread loaded it first
+        pCollection = g_fontSession.pCollection;
+    } else {
+        if (g_fontSession.pCollection) g_fontSession.pCollection->Release();
+        g_fontSession.pCollection = pCollection;
+    }
+    pCollection->AddRef();
+    *ppCollection = pCollection;
+    return S_OK;
+}
+
+/*
+ * Returns the session's factory and system font set (both AddRef'd)
+ *
+ * Fails with E_NOINTERFACE before Windows 10. checkForUpdates refreshes
+ * the system collection first so the font set reflects the new state.
+ */
+HRESULT GetSessionFontSet(BOOL checkForUpdates, IDWriteFactory3** ppFactory3, IDWriteFontSet** ppFontSet)
+{
+    IDWriteFactory* pFactory = nullptr;
+    HRESULT hr = GetSessionFactory(&pFactory);
+    if (FAILED(hr)) return hr;
+    hr = pFactory->QueryInterface(__uuidof(IDWriteFactory3), reinterpret_cast<void**>(ppFactory3));
+    pFactory->Release();
+    if (FAILED(hr)) {
+        *ppFactory3 = nullptr;
+        return hr;
+    }
+
+    if (checkForUpdates) {
+        IDWriteFontCollection* pFreshCollection = nullptr;
+        if (SUCCEEDED(GetSessionFontCollection(TRUE, &pFactory, &pFreshCollection))) {
+            pFreshCollection->Release();
+            pFactory->Release();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+        if (g_fontSession.pFontSet) {
+            g_fontSession.pFontSet->AddRef();
+            *ppFontSet = g_fontSession.pFontSet;
+            return S_OK;
+        }
+    }
+
+    IDWriteFontSet* pFontSet = nullptr;
+    hr = (*ppFactory3)->GetSystemFontSet(&pFontSet);
+    if (FAILED(hr)) {
+        (*ppFactory3)->Release();
+        *ppFactory3 = nullptr;
+        return hr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+    if (g_fontSession.pFontSet) {
+        pFontSet->Release();    // Another thread loaded it first
+        pFontSet = g_fontSession.pFontSet;
+    } else {
+        g_fontSession.pFontSet = pFontSet;
+    }
+    pFontSet->AddRef();
+    *ppFontSet = pFontSet;
+    return S_OK;
+}
+
+/*
+ * Returns the font resource of faceIndex in the file at path (AddRef'd)
+ *
+ * The file reference is shared by all faces of the file and the
+ * resource by all instances of the face. Requires IDWriteFactory6
+ * (Windows 10 1803); returns nullptr if unavailable or the file can't
+ * be read. Past FONT_SESSION_FILE_LIMIT files, resources are created
+ * without being cached.
+ */
+IDWriteFontResource* GetSessionFontResource(const std::wstring& path, UINT32 faceIndex)
+{
+    IDWriteFontFile* pFontFile = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+        auto it = g_fontSession.files.find(path);
+        if (it != g_fontSession.files.end()) {
+            FontSessionFile& file = it->second;
+            if (faceIndex < file.resources.size() && file.resources[faceIndex]) {
+                file.resources[faceIndex]->AddRef();
+                return file.resources[faceIndex];
+            }
+            pFontFile = file.pFontFile;
+            pFontFile->AddRef();
+        }
+    }
+
+    IDWriteFactory* pFactory = nullptr;
+    IDWriteFactory6* pFactory6 = nullptr;
+    if (FAILED(GetSessionFactory(&pFactory))) return nullptr;
+    HRESULT hr = pFactory->QueryInterface(__uuidof(IDWriteFactory6), (void**)&pFactory6);
+    pFactory->Release();
+    if (FAILED(hr)) {
+        if (pFontFile) pFontFile->Release();
+        return nullptr;
+    }
+
+    IDWriteFontResource* pResource = nullptr;
+    if ((pFontFile || SUCCEEDED(pFactory6->CreateFontFileReference(path.c_str(), NULL, &pFontFile))) &&
+        FAILED(pFactory6->CreateFontResource(pFontFile, faceIndex, &pResource))) {
+        pResource = nullptr;
+    }
+    pFactory6->Release();
+    if (!pResource) {
+        if (pFontFile) pFontFile->Release();
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(g_fontSession.mutex);
+    auto it = g_fontSession.files.find(path);
+    if (it == g_fontSession.files.end()) {
+        if (g_fontSession.files.size() >= FONT_SESSION_FILE_LIMIT) {
+            pFontFile->Release();
+            return pResource;
+        }
+        it = g_fontSession.files.emplace(path, FontSessionFile()).first;
+        it->second.pFontFile = pFontFile;   // The cache takes this reference
+    } else {
+        pFontFile->Release();
+    }
+
+    FontSessionFile& file = it->second;
+    if (faceIndex >= file.resources.size()) {
+        file.resources.resize(faceIndex + 1, nullptr);
+    }
+    if (file.resources[faceIndex]) {
+        pResource->Release();   // Another thread created it first
+        pResource = file.resources[faceIndex];
+    } else {
+        file.resources[faceIndex] = pResource;
+    }
+    pResource->AddRef();
+    return pResource;
+}
+
+/*
+ * Warm-up thread - loads the system font set and collection ahead of
+ * the first click
+ *
+ * Runs below normal priority so it doesn't compete with painting or a
+ * startup enumeration (which simply takes whatever is loaded first).
+ */
+void SessionWarmupThreadProc()
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+    GUID activity;
+    bool tracing = BeginTraceActivity(activity);
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "SessionWarmup", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_START));
+    }
+
+    IDWriteFactory3* pFactory3 = nullptr;
+    IDWriteFontSet* pFontSet = nullptr;
+    if (SUCCEEDED(GetSessionFontSet(FALSE, &pFactory3, &pFontSet))) {
+        pFontSet->GetFontCount();
+        pFontSet->Release();
+        pFactory3->Release();
+    }
+
+    IDWriteFactory* pFactory = nullptr;
+    IDWriteFontCollection* pCollection = nullptr;
+    if (SUCCEEDED(GetSessionFontCollection(FALSE, &pFactory, &pCollection))) {
+        pCollection->GetFontFamilyCount();
+        pCollection->Release();
+        pFactory->Release();
+    }
+
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "SessionWarmup", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_STOP));
+    }
+}
+
+/*
+ * Starts the warm-up thread; called once the window has painted
+ */
+void StartSessionWarmup()
+{
+    g_sessionWarmupThread = std::thread(SessionWarmupThreadProc);
+}
+
+/*
+ * Waits for the warm-up and releases the session
+ *
+ * Called at exit, after every thread that uses the session has stopped.
+ */
+void ReleaseFontSession()
+{
+    if (g_sessionWarmupThread.joinable()) {
+        g_sessionWarmupThread.join();
+    }
+    InvalidateFontSession();
+    if (g_fontSession.pFactory) {
+        g_fontSession.pFactory->Release();
+        g_fontSession.pFactory = nullptr;
+    }
+}
+
+// ============================================================================
+// FONT ENUMERATION - DirectWrite API
+// ============================================================================
+
+/*
+ * Fills info.filePath and info.faceIndex from a font face reference
+ *
+ * Only fonts served by the local file loader have a path; others keep
+ * an empty path. Shared by the DirectWrite and FontSet enumerators.
+ */
+void ReadFontFaceReferenceLocation(IDWriteFontFaceReference* pFontFaceRef, FontInfo& info)
+{
+    info.faceIndex = pFontFaceRef->GetFontFaceIndex();
+
+    IDWriteFontFile* pFontFile = nullptr;
+    if (SUCCEEDED(pFontFaceRef->GetFontFile(&pFontFile))) {
+        IDWriteFontFileLoader* pLoader = nullptr;
+        if (SUCCEEDED(pFontFile->GetLoader(&pLoader))) {
+            // Only local fonts have file paths
+            IDWriteLocalFontFileLoader* pLocalLoader = nullptr;
+            if (SUCCEEDED(pLoader->QueryInterface(__uuidof(IDWriteLocalFontFileLoader), (void**)&pLocalLoader))) {
+                const void* refKey = nullptr;
+                UINT32 refKeySize = 0;
+                if (SUCCEEDED(pFontFile->GetReferenceKey(&refKey, &refKeySize))) {
+                    UINT32 pathLen = 0;
+                    if (SUCCEEDED(pLocalLoader->GetFilePathLengthFromKey(refKey, refKeySize, &pathLen))) {
+                        info.filePath.resize(pathLen + 1);
+                        if (SUCCEEDED(pLocalLoader->GetFilePathFromKey(refKey, refKeySize, &info.filePath[0], pathLen + 1))) {
+                            info.filePath.resize(pathLen);
+                        } else {
+                            info.filePath.clear();
+                        }
+                    }
+                }
+                pLocalLoader->Release();
+            }
+            pLoader->Release();
+        }
+        pFontFile->Release();
+    }
+}
+
+/*
+ * Reads the English (en-us) string of names, or its first string, into
+ * name (reusing its storage)
+ */
+void ReadLocalizedName(IDWriteLocalizedStrings* pNames, FontString& name)
+{
+    UINT32 index = 0;
+    BOOL exists = FALSE;
+    pNames->FindLocaleName(L"en-us", &index, &exists);
+    if (!exists) {
+        index = 0;
+    }
+
+    UINT32 length = 0;
+    pNames->GetStringLength(index, &length);
+    name.resize(length + 1);
+    pNames->GetString(index, &name[0], length + 1);
+    name.resize(length);
+}
+
+/*
+ * Reads one face of a DirectWrite family into info
+ *
+ * Shared by the DirectWrite enumerator and the Families face loader.
+ */
+void ReadDirectWriteFace(IDWriteFont* pFont, std::wstring_view familyName, FontInfo& info, StageClock& clock)
+{
+    // Get face/style name
+    IDWriteLocalizedStrings* pFaceNames = nullptr;
+    if (SUCCEEDED(pFont->GetFaceNames(&pFaceNames))) {
+        ReadLocalizedName(pFaceNames, info.styleName);
+        pFaceNames->Release();
+    }
+
+    info.familyName = familyName;
+    info.weight = pFont->GetWeight();
+    info.italic = (pFont->GetStyle() == DWRITE_FONT_STYLE_ITALIC ||
+                  pFont->GetStyle() == DWRITE_FONT_STYLE_OBLIQUE);
+    clock.Lap(EnumStage::Names);
+
+    // Check if font is monospaced (requires IDWriteFont1)
+    info.fixedPitch = false;
+    IDWriteFont1* pFont1 = nullptr;
+    if (SUCCEEDED(pFont->QueryInterface(__uuidof(IDWriteFont1), (void**)&pFont1))) {
+        info.fixedPitch = pFont1->IsMonospacedFont() == TRUE;
+        pFont1->Release();
+    }
+    info.isVariable = false;
+    info.charSet = DEFAULT_CHARSET;
+    clock.Lap(EnumStage::Details);
+
+    // File path and face index (requires IDWriteFont3); used to
+    // match faces across rescans
+    IDWriteFont3* pFont3 = nullptr;
+    if (SUCCEEDED(pFont->QueryInterface(__uuidof(IDWriteFont3), (void**)&pFont3))) {
+        IDWriteFontFaceReference* pFontFaceRef = nullptr;
+        if (SUCCEEDED(pFont3->GetFontFaceReference(&pFontFaceRef))) {
+            ReadFontFaceReferenceLocation(pFontFaceRef, info);
+            pFontFaceRef->Release();
+        }
+        pFont3->Release();
+    }
+    clock.Lap(EnumStage::Paths);
+}
+
+/*
+ * Gets the session's factory and system collection, setting
+ * job.errorText on failure
+ */
+bool OpenSystemFontCollection(EnumJob& job, BOOL checkForUpdates, StageClock& clock,
+    IDWriteFactory** ppDWriteFactory, IDWriteFontCollection** ppFontCollection)
+{
+    IDWriteFactory* pDWriteFactory = nullptr;
+    if (FAILED(GetSessionFactory(&pDWriteFactory))) {
+        job.errorText = L"Failed to create DirectWrite factory";
+        return false;
+    }
+    pDWriteFactory->Release();      // Only checked here; the session keeps it
+    clock.Lap(EnumStage::Factory);
+
+    if (FAILED(GetSessionFontCollection(checkForUpdates, ppDWriteFactory, ppFontCollection))) {
+        job.errorText = L"Failed to get system font collection";
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Enumerates fonts using the DirectWrite IDWriteFontCollection API
+ *
+ * DirectWrite provides better support for:
+ * - OpenType features
+ * - Complex script shaping
+ * - Font fallback
+ * - Accurate style names
+ *
+ * Available on Windows Vista and later.
+ * Runs on the enumeration worker thread; progress is counted per family.
+ */
+void EnumerateDirectWriteFonts(EnumJob& job)
+{
+    StageClock clock(job);
+    FontBatcher batcher(job);
+
+    IDWriteFactory* pDWriteFactory = nullptr;
+    IDWriteFontCollection* pFontCollection = nullptr;
+    if (!OpenSystemFontCollection(job, job.checkForUpdates ? TRUE : FALSE, clock, &pDWriteFactory, &pFontCollection)) {
+        return;
+    }
+
+    UINT32 familyCount = pFontCollection->GetFontFamilyCount();
+    job.total = familyCount;
+    clock.Lap(EnumStage::FontSource);
+
+    // Iterate through each font family
+    FontString familyName;      // Reused; faces copy it into their batch
+    for (UINT32 i = 0; i < familyCount && !job.IsCancelled(); i++) {
+        job.processed = i + 1;
+
+        IDWriteFontFamily* pFontFamily = nullptr;
+        HRESULT hr = pFontCollection->GetFontFamily(i, &pFontFamily);
+        if (FAILED(hr)) continue;
+
+        // Get family name (prefer English)
+        IDWriteLocalizedStrings* pFamilyNames = nullptr;
+        hr = pFontFamily->GetFamilyNames(&pFamilyNames);
+        if (SUCCEEDED(hr)) {
+            ReadLocalizedName(pFamilyNames, familyName);
+
+            // Each family can contain multiple fonts (Regular, Bold, Italic, etc.)
+            UINT32 fontCount = pFontFamily->GetFontCount();
+            for (UINT32 j = 0; j < fontCount; j++) {
+                IDWriteFont* pFont = nullptr;
+                hr = pFontFamily->GetFont(j, &pFont);
+                if (FAILED(hr)) continue;
+
+                FontInfo info(batcher.Arena());
+                ReadDirectWriteFace(pFont, familyName, info, clock);
+                batcher.Add(std::move(info));
+                clock.Lap(EnumStage::Store);
+
+                pFont->Release();
+            }
+
+            pFamilyNames->Release();
+        }
+
+        pFontFamily->Release();
+    }
+
+    pFontCollection->Release();
+    pDWriteFactory->Release();
+}
+
+/*
+ * Enumerates the DirectWrite families as group rows (Families mode)
+ *
+ * Reads only each family's name and face count, so the list appears
+ * without creating a single IDWriteFont; the faces are loaded later by
+ * the family face loader (see FAMILY GROUPS), from the same session
+ * collection.
+ */
+void EnumerateDirectWriteFamilies(EnumJob& job)
+{
+    StageClock clock(job);
+    FontBatcher batcher(job);
+
+    IDWriteFactory* pDWriteFactory = nullptr;
+    IDWriteFontCollection* pFontCollection = nullptr;
+    if (!OpenSystemFontCollection(job, job.checkForUpdates ? TRUE : FALSE, clock, &pDWriteFactory, &pFontCollection)) {
+        return;
+    }
+
+    UINT32 familyCount = pFontCollection->GetFontFamilyCount();
+    job.total = familyCount;
+    clock.Lap(EnumStage::FontSource);
+
+    for (UINT32 i = 0; i < familyCount && !job.IsCancelled(); i++) {
+        job.processed = i + 1;
+
+        IDWriteFontFamily* pFontFamily = nullptr;
+        if (FAILED(pFontCollection->GetFontFamily(i, &pFontFamily))) continue;
+
+        IDWriteLocalizedStrings* pFamilyNames = nullptr;
+        if (SUCCEEDED(pFontFamily->GetFamilyNames(&pFamilyNames))) {
+            FontInfo info(batcher.Arena());
+            ReadLocalizedName(pFamilyNames, info.familyName);
+            info.weight = DWRITE_FONT_WEIGHT_NORMAL;    // Previewed as the family's regular face
+            info.italic = false;
+            info.fixedPitch = false;
+            info.isVariable = false;
+            info.charSet = DEFAULT_CHARSET;
+            info.isGroup = true;
+            info.faceCount = pFontFamily->GetFontCount();
+            pFamilyNames->Release();
+            clock.Lap(EnumStage::Names);
+
+            batcher.Add(std::move(info));
+            clock.Lap(EnumStage::Store);
+        }
+
+        pFontFamily->Release();
+    }
+
+    pFontCollection->Release();
+    pDWriteFactory->Release();
+}
+
+// ============================================================================
+// FONT ENUMERATION - FontSet API (Windows 10+)
+// ============================================================================
+
+/*
+ * Formats an OpenType axis tag (e.g. "wght")
+ */
+std::wstring FormatAxisTag(DWRITE_FONT_AXIS_TAG tag)
+{
+    wchar_t tagStr[5] = {
+        (wchar_t)(tag & 0xFF),
+        (wchar_t)((tag >> 8) & 0xFF),
+        (wchar_t)((tag >> 16) & 0xFF),
+        (wchar_t)((tag >> 24) & 0xFF),
+        0
+    };
+    return tagStr;
+}
+
+/*
+ * Formats the variable axes among ranges, e.g. "wght 100-900, wdth 75-100"
+ *
+ * Only axes whose range isn't a single value are listed; isVariable is
+ * set if there is at least one.
+ */
+void DescribeAxisRanges(const DWRITE_FONT_AXIS_RANGE* axisRanges, UINT32 axisCount,
+    bool& isVariable, FontString& axes)
+{
+    for (UINT32 a = 0; a < axisCount; a++) {
+        if (axisRanges[a].minValue == axisRanges[a].maxValue) continue;
+        isVariable = true;
+
+        // Build axis description string
+        if (!axes.empty()) {
+            axes += L", ";
+        }
+
+        wchar_t axisBuf[64];
+        swprintf_s(axisBuf, L"%s %.0f-%.0f", FormatAxisTag(axisRanges[a].axisTag).c_str(),
+            axisRanges[a].minValue, axisRanges[a].maxValue);
+        axes += axisBuf;
+    }
+}
+
+/*
+ * Reads the variable font axes of a font resource
+ */
+void ReadFontResourceAxes(IDWriteFontResource* pFontResource, FontDetails& details)
+{
+    UINT32 axisCount = pFontResource->GetFontAxisCount();
+    if (axisCount == 0) return;
+
+    DWRITE_FONT_AXIS_RANGE axisRanges[16];
+    std::vector<DWRITE_FONT_AXIS_RANGE> moreRanges;
+    DWRITE_FONT_AXIS_RANGE* ranges = axisRanges;
+    if (axisCount > ARRAYSIZE(axisRanges)) {
+        moreRanges.resize(axisCount);
+        ranges = moreRanges.data();
+    }
+    if (SUCCEEDED(pFontResource->GetFontAxisRanges(ranges, axisCount))) {
+        DescribeAxisRanges(ranges, axisCount, details.isVariable, details.variableAxes);
+    }
+}
+
+/*
+ * Reads the file-backed details of a face: the monospace flag and the
+ * variable font axes (axes whose range isn't a single value)
+ *
+ * Creates the font face, which maps the font file; this is the
+ * expensive part of FontSet enumeration and is deferred where possible.
+ */
+void ReadFontFaceDetails(IDWriteFontFaceReference* pFontFaceRef, FontDetails& details)
+{
+    IDWriteFontFace3* pFontFace3 = nullptr;
+    if (FAILED(pFontFaceRef->CreateFontFace(&pFontFace3))) {
+        return;
+    }
+    g_fontFacesCreated++;
+
+    details.fixedPitch = pFontFace3->IsMonospacedFont() == TRUE;
+
+    // --- Extract variable font axis information ---
+    // Requires querying IDWriteFontFace5 for the font resource
+    IDWriteFontFace5* pFontFace5 = nullptr;
+    if (SUCCEEDED(pFontFace3->QueryInterface(__uuidof(IDWriteFontFace5), (void**)&pFontFace5))) {
+        IDWriteFontResource* pFontResource = nullptr;
+        if (SUCCEEDED(pFontFace5->GetFontResource(&pFontResource))) {
+            ReadFontResourceAxes(pFontResource, details);
+            pFontResource->Release();
+        }
+        pFontFace5->Release();
+    }
+    pFontFace3->Release();
+}
+
+/*
+ * ReadFontFaceDetails for a face opened from a (cached) font resource
+ *
+ * The resource already has the axes; only the monospace flag needs a
+ * font face, created at the default instance.
+ */
+void ReadFontResourceDetails(IDWriteFontResource* pFontResource, FontDetails& details)
+{
+    IDWriteFontFace5* pFontFace5 = nullptr;
+    if (SUCCEEDED(pFontResource->CreateFontFace(DWRITE_FONT_SIMULATIONS_NONE, nullptr, 0, &pFontFace5))) {
+        g_fontFacesCreated++;
+        details.fixedPitch = pFontFace5->IsMonospacedFont() == TRUE;
+        pFontFace5->Release();
+    }
+    ReadFontResourceAxes(pFontResource, details);
+}
+
+/*
+ * FontSetBulkProperties - Per-index properties read for the whole font set
+ *
+ * Built once per enumeration from the distinct property values
+ * (IDWriteFontSet::GetPropertyValues) and the indices matching each
+ * (IDWriteFontSet1::GetFilteredFontIndices), instead of a string lookup
+ * and _wtoi per face.
+ */
+struct FontSetBulkProperties {
+    IDWriteFontSet1* pFontSet1 = nullptr;   // Not owned
+    std::vector<int> weights;               // DWRITE_FONT_WEIGHT per index
+    std::vector<int> styles;                // DWRITE_FONT_STYLE per index
+};
+
+/*
+ * Fills values[i] with the numeric value of propertyId for every index
+ *
+ * Faces without the property keep defaultValue. Returns false if the
+ * font set can't list or filter by the property.
+ */
+bool ReadFontSetNumericProperty(IDWriteFontSet1* pFontSet1, DWRITE_FONT_PROPERTY_ID propertyId,
+    int defaultValue, std::vector<int>& values)
+{
+    UINT32 fontCount = pFontSet1->GetFontCount();
+    values.assign(fontCount, defaultValue);
+
+    IDWriteStringList* pValues = nullptr;
+    if (FAILED(pFontSet1->GetPropertyValues(propertyId, &pValues))) {
+        return false;
+    }
+
+    bool ok = true;
+    std::vector<UINT32> indices(fontCount);
+    std::wstring value;
+    for (UINT32 k = 0; k < pValues->GetCount() && ok; k++) {
+        UINT32 length = 0;
+        if (FAILED(pValues->GetStringLength(k, &length))) continue;
+        value.resize(length + 1);
+        if (FAILED(pValues->GetString(k, &value[0], length + 1))) continue;
+        value.resize(length);
+
+        DWRITE_FONT_PROPERTY property = { propertyId, value.c_str(), L"" };
+        UINT32 matchCount = 0;
+        if (FAILED(pFontSet1->GetFilteredFontIndices(&property, 1, FALSE,
+                indices.data(), fontCount, &matchCount))) {
+            ok = false;
+            break;
+        }
+        int number = _wtoi(value.c_str());
+        for (UINT32 j = 0; j < matchCount; j++) {
+            values[indices[j]] = number;
+        }
+    }
+
+    pValues->Release();
+    return ok;
+}
+
+/*
+ * Reads the axis ranges of font set entry i without creating a font face
+ *
+ * Returns false if the entry has axes but every range is a single value:
+ * system font sets list a variable font once per named instance, pinned
+ * to that instance's coordinates, so only the font resource has the full
+ * ranges. info is then left non-variable for the caller to complete.
+ */
+bool ReadFontSetAxisRanges(IDWriteFontSet1* pFontSet1, UINT32 i, FontInfo& info)
+{
+    DWRITE_FONT_AXIS_RANGE axisRanges[16];
+    std::vector<DWRITE_FONT_AXIS_RANGE> moreRanges;
+    DWRITE_FONT_AXIS_RANGE* ranges = axisRanges;
+    UINT32 axisCount = 0;
+    HRESULT hr = pFontSet1->GetFontAxisRanges(i, axisRanges, ARRAYSIZE(axisRanges), &axisCount);
+    if (hr == E_NOT_SUFFICIENT_BUFFER && axisCount > 0) {
+        moreRanges.resize(axisCount);
+        ranges = moreRanges.data();
+        hr = pFontSet1->GetFontAxisRanges(i, ranges, axisCount, &axisCount);
+    }
+    if (FAILED(hr) || axisCount == 0) return true;     // Static font (or no data)
+
+    DescribeAxisRanges(ranges, axisCount, info.isVariable, info.variableAxes);
+    return info.isVariable;
+}
+
+/*
+ * Reads one entry of a font set into info
+ *
+ * With bulk (IDWriteFontSet1), weight, style and axes come from the font
+ * set data and no font face is created (except for the axes of named
+ * instances, see ReadFontSetAxisRanges); otherwise they are read per
+ * face and the axes are deferred to the details worker. Without
+ * deferDetails, the file-backed details are read here as well.
+ *
+ * Independent per index (the font set and the objects it hands out are
+ * free-threaded), so it may be called concurrently for different indices.
+ * Returns false if the entry has no usable family name.
+ */
+bool ReadFontSetFont(IDWriteFontSet* pFontSet, UINT32 i, FontInfo& info,
+    const FontSetBulkProperties* bulk, bool deferDetails, StageClock& clock)
+{
+    IDWriteFontFaceReference* pFontFaceRef = nullptr;
+    HRESULT hr = pFontSet->GetFontFaceReference(i, &pFontFaceRef);
+    if (FAILED(hr)) return false;
+
+    // --- Extract font file path and face index ---
+    ReadFontFaceReferenceLocation(pFontFaceRef, info);
+    clock.Lap(EnumStage::Paths);
+
+    // --- Extract font properties from the font set ---
+
+    // Get family name
+    IDWriteLocalizedStrings* pFamilyNames = nullptr;
+    BOOL exists = FALSE;
+    hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_FAMILY_NAME, &exists, &pFamilyNames);
+    if (SUCCEEDED(hr) && exists && pFamilyNames) {
+        UINT32 index = 0;
+        BOOL found = FALSE;
+        pFamilyNames->FindLocaleName(L"en-us", &index, &found);
+        if (!found) index = 0;
+
+        UINT32 length = 0;
+        pFamilyNames->GetStringLength(index, &length);
+        info.familyName.resize(length + 1);
+        pFamilyNames->GetString(index, &info.familyName[0], length + 1);
+        info.familyName.resize(length);
+        pFamilyNames->Release();
+    }
+
+    // Get style/face name
+    IDWriteLocalizedStrings* pFaceNames = nullptr;
+    hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_FACE_NAME, &exists, &pFaceNames);
+    if (SUCCEEDED(hr) && exists && pFaceNames) {
+        UINT32 index = 0;
+        BOOL found = FALSE;
+        pFaceNames->FindLocaleName(L"en-us", &index, &found);
+        if (!found) index = 0;
+
+        UINT32 length = 0;
+        pFaceNames->GetStringLength(index, &length);
+        info.styleName.resize(length + 1);
+        pFaceNames->GetString(index, &info.styleName[0], length + 1);
+        info.styleName.resize(length);
+        pFaceNames->Release();
+    }
+
+    if (bulk) {
+        // Weight, style and axis ranges straight from the font set data
+        info.weight = bulk->weights[i];
+        info.italic = (bulk->styles[i] == DWRITE_FONT_STYLE_ITALIC || bulk->styles[i] == DWRITE_FONT_STYLE_OBLIQUE);
+        info.charSet = DEFAULT_CHARSET;
+        info.fixedPitch = false;
+        info.isVariable = false;
+        clock.Lap(EnumStage::Names);
+        bool axesKnown = ReadFontSetAxisRanges(bulk->pFontSet1, i, info);
+
+        // The monospace flag still needs the font file, and so do the axes
+        // of a named instance; the details worker reads both from the
+        // resource (SetDetails replaces the axes)
+        if (!info.filePath.empty() && deferDetails) {
+            info.detailsPending = true;
+        } else {
+            FontDetails details;
+            ReadFontFaceDetails(pFontFaceRef, details);
+            info.fixedPitch = details.fixedPitch;
+            if (!axesKnown) {
+                info.isVariable = details.isVariable;
+                info.variableAxes = details.variableAxes;
+            }
+        }
+        clock.Lap(EnumStage::Details);
+
+        pFontFaceRef->Release();
+        return !info.familyName.empty();
+    }
+
+    // Get weight
+    IDWriteLocalizedStrings* pWeightStr = nullptr;
+    hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_WEIGHT, &exists, &pWeightStr);
+    if (SUCCEEDED(hr) && exists && pWeightStr) {
+        wchar_t weightBuf[32] = {};
+        pWeightStr->GetString(0, weightBuf, 32);
+        info.weight = _wtoi(weightBuf);
+        pWeightStr->Release();
+    } else {
+        info.weight = 400;  // Default to normal weight
+    }
+
+    // Get style (italic/oblique)
+    IDWriteLocalizedStrings* pStyleStr = nullptr;
+    hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_STYLE, &exists, &pStyleStr);
+    if (SUCCEEDED(hr) && exists && pStyleStr) {
+        wchar_t styleBuf[32] = {};
+        pStyleStr->GetString(0, styleBuf, 32);
+        int style = _wtoi(styleBuf);
+        info.italic = (style == DWRITE_FONT_STYLE_ITALIC || style == DWRITE_FONT_STYLE_OBLIQUE);
+        pStyleStr->Release();
+    } else {
+        info.italic = false;
+    }
+
+    info.charSet = DEFAULT_CHARSET;
+    clock.Lap(EnumStage::Names);
+
+    // Axes and the monospace flag need the font file; read them later
+    // unless the face can't be found again by path (e.g. remote fonts)
+    if (!info.filePath.empty() && deferDetails) {
+        info.fixedPitch = false;
+        info.isVariable = false;
+        info.detailsPending = true;
+    } else {
+        FontDetails details;
+        ReadFontFaceDetails(pFontFaceRef, details);
+        info.fixedPitch = details.fixedPitch;
+        info.isVariable = details.isVariable;
+        info.variableAxes = std::move(details.variableAxes);
+    }
+    clock.Lap(EnumStage::Details);
+
+    pFontFaceRef->Release();
+
+    return !info.familyName.empty();
+}
+
+/*
+ * Reads every entry of pFontSet and hands the fonts to FontBatchers
+ *
+ * Shared by the system font set and font sets built from folders.
+ * Runs on the enumeration worker thread; progress is counted per face.
+ * Faces are read in parallel (see g_enumThreadCount).
+ */
+void ReadFontSetFonts(EnumJob& job, IDWriteFontSet* pFontSet, StageClock& clock)
+{
+    UINT32 fontCount = pFontSet->GetFontCount();
+    job.total = fontCount;
+
+    // Fast path (Windows 10 1809+): read weight and style for the whole
+    // set up front and axis ranges from the set's own data
+    FontSetBulkProperties bulk;
+    const FontSetBulkProperties* pBulk = nullptr;
+    if (SUCCEEDED(pFontSet->QueryInterface(__uuidof(IDWriteFontSet1), (void**)&bulk.pFontSet1))) {
+        if (ReadFontSetNumericProperty(bulk.pFontSet1, DWRITE_FONT_PROPERTY_ID_WEIGHT, DWRITE_FONT_WEIGHT_NORMAL, bulk.weights) &&
+            ReadFontSetNumericProperty(bulk.pFontSet1, DWRITE_FONT_PROPERTY_ID_STYLE, DWRITE_FONT_STYLE_NORMAL, bulk.styles)) {
+            pBulk = &bulk;
+        }
+    }
+    clock.Lap(EnumStage::FontSource);
+
+    // Split the index range into chunks spread across one thread per core;
+    // each thread batches its own results, which are merged on the UI thread
+    // before the final sort
+    unsigned threadCount = GetEnumThreadCount(fontCount, FONTSET_CHUNK_SIZE);
+    std::vector<std::unique_ptr<FontBatcher>> batchers;
+    for (unsigned t = 0; t < threadCount; t++) {
+        batchers.push_back(std::make_unique<FontBatcher>(job));
+    }
+
+    ParallelForChunks(fontCount, FONTSET_CHUNK_SIZE, threadCount,
+        [&](UINT32 begin, UINT32 end, unsigned worker) {
+            StageClock workerClock(job);
+            for (UINT32 i = begin; i < end && !job.IsCancelled(); i++) {
+                FontInfo info(batchers[worker]->Arena());
+                if (ReadFontSetFont(pFontSet, i, info, pBulk, job.deferDetails, workerClock)) {
+                    batchers[worker]->Add(std::move(info));
+                }
+                job.processed++;
+                workerClock.Lap(EnumStage::Store);
+            }
+        });
+    clock.Restart();
+    batchers.clear();  // Flush remaining batches
+    clock.Lap(EnumStage::Store);
+
+    if (bulk.pFontSet1) bulk.pFontSet1->Release();
+}
+
+/*
+ * Enumerates fonts using the DirectWrite IDWriteFontSet API
+ *
+ * The FontSet API (Windows 10+) provides access to:
+ * - Font file paths
+ * - Variable font axis information (weight ranges, width ranges, etc.)
+ * - More detailed font properties
+ *
+ * This is the most comprehensive font enumeration API available.
+ * Runs on the enumeration worker thread; progress is counted per face.
+ * Faces are read in parallel (see g_enumThreadCount).
+ */
+void EnumerateFontSetFonts(EnumJob& job)
+{
+    StageClock clock(job);
+
+    // Factory version 3 is required for the FontSet API
+    IDWriteFactory* pDWriteFactory = nullptr;
+    IDWriteFactory3* pDWriteFactory3 = nullptr;
+    if (FAILED(GetSessionFactory(&pDWriteFactory)) ||
+        FAILED(pDWriteFactory->QueryInterface(__uuidof(IDWriteFactory3), (void**)&pDWriteFactory3))) {
+        if (pDWriteFactory) pDWriteFactory->Release();
+        job.errorText = L"Failed to create DirectWrite factory 3.\nThis feature requires Windows 10 or later.";
+        return;
+    }
+    pDWriteFactory3->Release();     // Only checked here; the session keeps it
+    pDWriteFactory->Release();
+    clock.Lap(EnumStage::Factory);
+
+    // The session's font set, loaded by the warm-up or an earlier run.
+    // After a font change it refreshes the system collection first so
+    // the font set reflects the new state
+    IDWriteFontSet* pFontSet = nullptr;
+    if (FAILED(GetSessionFontSet(job.checkForUpdates ? TRUE : FALSE, &pDWriteFactory3, &pFontSet))) {
+        job.errorText = L"Failed to get system font set";
+        return;
+    }
+
+    ReadFontSetFonts(job, pFontSet, clock);
+
+    pFontSet->Release();
+    pDWriteFactory3->Release();
+}
+
+// ============================================================================
+// FONT ENUMERATION - Font folders (Windows 10 1703+)
+// ============================================================================
+//
+// "Open folder..." lists the font files under a directory tree instead of
+// the installed fonts. A pool of readers shares one work queue: a
+// directory item lists its entries (queueing subdirectories and font
+// files), a file item adds the file to the reader's own font set builder.
+// Listing and file reads overlap across readers, so on a network share
+// the time is bounded by how many requests are in flight rather than by
+// the round trip per file. The per-reader sets are then merged and read
+// by ReadFontSetFonts, exactly like the system font set.
+
+#define FOLDER_READER_THREADS   16      // Readers in flight (I/O bound, so more than cores)
+
+/*
+ * FolderWorkItem - A directory to list or a font file to add
+ */
+struct FolderWorkItem {
+    std::wstring path;
+    bool isDirectory = true;
+    FILETIME lastWriteTime = {};        // From the directory listing (files only)
+};
+
+/*
+ * FolderScan - Work queue shared by the folder readers
+ *
+ * Items are taken newest first, which walks the tree depth first and
+ * keeps the queue short. The scan is over when the queue is empty and
+ * no reader is busy (busy readers may still queue more items).
+ */
+struct FolderScan {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<FolderWorkItem> items;
+    unsigned busy = 0;                  // Readers processing an item
+    bool stop = false;                  // Cancelled
+};
+
+/*
+ * Returns true if fileName has a font file extension DirectWrite reads
+ */
+bool IsFontFileName(const wchar_t* fileName)
+{
+    const wchar_t* ext = wcsrchr(fileName, L'.');
+    if (!ext) return false;
+    return _wcsicmp(ext, L".ttf") == 0 || _wcsicmp(ext, L".otf") == 0 ||
+        _wcsicmp(ext, L".ttc") == 0 || _wcsicmp(ext, L".otc") == 0;
+}
+
+/*
+ * Lists directory, appending its subdirectories and font files to items
+ *
+ * Uses the large-fetch basic listing, which returns many entries per
+ * round trip and skips the short (8.3) names. Directory reparse points
+ * (junctions, symlinks) are not followed, so loops can't make the scan
+ * endless; file reparse points such as cloud placeholders and
+ * deduplicated files are listed like any other font file.
+ */
+void ListFontFolder(const std::wstring& directory, std::vector<FolderWorkItem>& items)
+{
+    WIN32_FIND_DATAW data;
+    HANDLE hFind = FindFirstFileExW((directory + L"\\*").c_str(), FindExInfoBasic, &data,
+        FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (hFind == INVALID_HANDLE_VALUE) return;
+
+    do {
+        FolderWorkItem item;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+            if (wcscmp(data.cFileName, L".") == 0 || wcscmp(data.cFileName, L"..") == 0) continue;
+        } else if (IsFontFileName(data.cFileName)) {
+            item.isDirectory = false;
+            item.lastWriteTime = data.ftLastWriteTime;
+        } else {
+            continue;
+        }
+        item.path = directory + L"\\" + data.cFileName;
+        items.push_back(std::move(item));
+    } while (FindNextFileW(hFind, &data));
+    FindClose(hFind);
+}
+
+/*
+ * Runs onFile(item, reader) for every font file under roots
+ *
+ * readerCount readers (the calling thread is reader 0) take items from
+ * one shared queue; directory items are listed by the reader that takes
+ * them, so listings and file reads overlap. Progress counts font files.
+ * Returns when the tree has been read or the job is cancelled.
+ */
+template <typename OnFile>
+void ScanFontFolders(EnumJob& job, const std::vector<std::wstring>& roots, unsigned readerCount, OnFile&& onFile)
+{
+    FolderScan scan;
+    for (const auto& path : roots) {
+        FolderWorkItem root;
+        root.path = path;
+        while (root.path.size() > 3 && (root.path.back() == L'\\' || root.path.back() == L'/')) {
+            root.path.pop_back();
+        }
+        scan.items.push_back(std::move(root));
+    }
+
+    auto reader = [&](unsigned readerIndex) {
+        std::vector<FolderWorkItem> found;
+        std::unique_lock<std::mutex> lock(scan.mutex);
+        for (;;) {
+            scan.wake.wait(lock, [&] { return scan.stop || !scan.items.empty() || scan.busy == 0; });
+            if (scan.stop || scan.items.empty()) break;
+
+            FolderWorkItem item = std::move(scan.items.back());
+            scan.items.pop_back();
+            scan.busy++;
+            lock.unlock();
+
+            found.clear();
+            if (item.isDirectory) {
+                ListFontFolder(item.path, found);
+            } else {
+                onFile(item, readerIndex);
+                job.processed++;
+            }
+
+            lock.lock();
+            scan.busy--;
+            for (auto& next : found) {
+                if (!next.isDirectory) job.total++;
+                scan.items.push_back(std::move(next));
+            }
+            if (job.IsCancelled()) {
+                scan.stop = true;
+            }
+            if (scan.stop || !found.empty() || scan.busy == 0) {
+                scan.wake.notify_all();
+            }
+        }
+        scan.wake.notify_all();     // Let the others see the end of the scan
+    };
+
+    std::vector<std::thread> threads;
+    AllocationCounter* counter = t_allocationCounter;     // Readers count with the calling thread
+    for (unsigned t = 1; t < readerCount; t++) {
+        threads.emplace_back([&, t] {
+            AllocationScope scope(counter);
+            reader(t);
+        });
+    }
+    reader(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+/*
+ * Returns the number of folder readers (see FOLDER_READER_THREADS)
+ */
+unsigned GetFolderReaderCount()
+{
+    return g_enumThreadCount ? g_enumThreadCount : FOLDER_READER_THREADS;
+}
+
+/*
+ * Enumerates the fonts in job.folderPath and all of its subfolders
+ *
+ * Runs on the enumeration worker thread, which acts as one of the
+ * readers. Each reader adds its files to its own font set builder,
+ * passing the listed last-write time to CreateFontFileReference so
+ * DirectWrite doesn't query each file for it; files that aren't valid
+ * fonts are skipped. Progress counts font files while the tree is
+ * read, then faces while the merged font set is read.
+ */
+void EnumerateFolderFonts(EnumJob& job)
+{
+    StageClock clock(job);
+
+    IDWriteFactory5* pDWriteFactory5 = nullptr;
+    HRESULT hr = DWriteCreateFactory(
+        DWRITE_FACTORY_TYPE_SHARED,
+        __uuidof(IDWriteFactory5),
+        reinterpret_cast<IUnknown**>(&pDWriteFactory5));
+    if (FAILED(hr)) {
+        job.errorText = L"Failed to create DirectWrite factory 5.\nOpening a font folder requires Windows 10 version 1703 or later.";
+        return;
+    }
+    clock.Lap(EnumStage::Factory);
+
+    DWORD attributes = GetFileAttributesW(job.folderPath.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        pDWriteFactory5->Release();
+        job.errorText = L"Cannot open the folder";
+        return;
+    }
+
+    unsigned readerCount = GetFolderReaderCount();
+    std::vector<IDWriteFontSetBuilder1*> builders;
+    for (unsigned t = 0; t < readerCount; t++) {
+        IDWriteFontSetBuilder1* pBuilder = nullptr;
+        if (FAILED(pDWriteFactory5->CreateFontSetBuilder(&pBuilder))) break;
+        builders.push_back(pBuilder);
+    }
+
+    IDWriteFontSet* pFontSet = nullptr;
+    if (!builders.empty()) {
+        ScanFontFolders(job, { job.folderPath }, static_cast<unsigned>(builders.size()),
+            [&](const FolderWorkItem& item, unsigned reader) {
+                IDWriteFontFile* pFontFile = nullptr;
+                if (SUCCEEDED(pDWriteFactory5->CreateFontFileReference(item.path.c_str(),
+                        &item.lastWriteTime, &pFontFile))) {
+                    builders[reader]->AddFontFile(pFontFile);
+                    pFontFile->Release();
+                }
+            });
+        clock.Lap(EnumStage::FontSource);
+
+        // Merge the readers' sets into the one that is enumerated
+        IDWriteFontSetBuilder1* pMerged = nullptr;
+        if (!job.IsCancelled() && SUCCEEDED(pDWriteFactory5->CreateFontSetBuilder(&pMerged))) {
+            for (IDWriteFontSetBuilder1* pBuilder : builders) {
+                IDWriteFontSet* pPartial = nullptr;
+                if (SUCCEEDED(pBuilder->CreateFontSet(&pPartial))) {
+                    pMerged->AddFontSet(pPartial);
+                    pPartial->Release();
+                }
+            }
+            if (FAILED(pMerged->CreateFontSet(&pFontSet))) {
+                pFontSet = nullptr;
+            }
+            pMerged->Release();
+        }
+        clock.Lap(EnumStage::FontSource);
+    }
+    for (IDWriteFontSetBuilder1* pBuilder : builders) {
+        pBuilder->Release();
+    }
+
+    if (pFontSet) {
+        job.processed = 0;      // From files to faces
+        ReadFontSetFonts(job, pFontSet, clock);
+        pFontSet->Release();
+    } else if (!job.IsCancelled()) {
+        job.errorText = L"Failed to build a font set from the folder";
+    }
+    pDWriteFactory5->Release();
+}
+
+// ============================================================================
+// FONT ENUMERATION - OpenType tables (no DirectWrite)
+// ============================================================================
+//
+// Reads the name, OS/2, post and fvar tables straight from memory-mapped
+// font files, for audits of large font folders where creating DirectWrite
+// objects per face dominates the time. Every face of a collection (TTC/OTC)
+// is listed once, as its default instance, with all details filled in
+// (including the monospace flag), so nothing is deferred.
+//
+// Names follow the family model of the other APIs as far as the tables
+// allow: the WWS names (IDs 21/22) where present, else the typographic
+// (16/17), else the legacy (1/2) names. Every offset and length read from
+// a file is checked against the mapping; malformed faces are skipped.
+
+#define OT_TAG(a, b, c, d)  ((UINT32(a) << 24) | (UINT32(b) << 16) | (UINT32(c) << 8) | UINT32(d))
+
+/*
+ * OpenTypeReader - Bounds-checked big-endian reads from a mapped file
+ *
+ * Reads past the end return 0; callers check Has() for any span they
+ * walk so a bad offset never reads outside the mapping.
+ */
+struct OpenTypeReader {
+    const BYTE* data;
+    size_t size;
+
+    bool Has(size_t offset, size_t length) const
+    {
+        return offset <= size && length <= size - offset;
+    }
+    UINT16 U16(size_t offset) const
+    {
+        return Has(offset, 2) ? static_cast<UINT16>((data[offset] << 8) | data[offset + 1]) : 0;
+    }
+    UINT32 U32(size_t offset) const
+    {
+        return Has(offset, 4) ? (static_cast<UINT32>(U16(offset)) << 16) | U16(offset + 2) : 0;
+    }
+};
+
+/*
+ * OpenTypeTable - Location of a table within the file
+ */
+struct OpenTypeTable {
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+/*
+ * Finds table tag in the table directory of the face at faceOffset
+ *
+ * Returns false if the face has no such table or it lies outside the file.
+ */
+bool FindOpenTypeTable(const OpenTypeReader& file, size_t faceOffset, UINT32 tag, OpenTypeTable& table)
+{
+    UINT16 numTables = file.U16(faceOffset + 4);
+    if (!file.Has(faceOffset + 12, static_cast<size_t>(numTables) * 16)) return false;
+
+    for (UINT16 t = 0; t < numTables; t++) {
+        size_t record = faceOffset + 12 + static_cast<size_t>(t) * 16;
+        if (file.U32(record) != tag) continue;
+        table.offset = file.U32(record + 8);
+        table.length = file.U32(record + 12);
+        return file.Has(table.offset, table.length);
+    }
+    return false;
+}
+
+/*
+ * Reads name nameId from the name table into value
+ *
+ * Prefers Windows Unicode records in US English, then any Windows
+ * Unicode language, then Windows symbol records (also UTF-16BE, used by
+ * symbol fonts, in the same language order), then Unicode-platform and
+ * finally Mac Roman English records. Returns false if there is no usable
+ * record.
+ */
+bool ReadOpenTypeName(const OpenTypeReader& file, const OpenTypeTable& name, UINT16 nameId, FontString& value)
+{
+    if (name.length < 6) return false;
+    UINT16 count = file.U16(name.offset + 2);
+    size_t storage = name.offset + file.U16(name.offset + 4);
+    if (6 + static_cast<size_t>(count) * 12 > name.length) return false;
+
+    int bestScore = 0;
+    size_t bestOffset = 0, bestLength = 0;
+    for (UINT16 r = 0; r < count; r++) {
+        size_t record = name.offset + 6 + static_cast<size_t>(r) * 12;
+        if (file.U16(record + 6) != nameId) continue;
+
+        UINT16 platform = file.U16(record);
+        UINT16 encoding = file.U16(record + 2);
+        UINT16 language = file.U16(record + 4);
+        int score = 0;
+        if (platform == 3 && (encoding == 1 || encoding == 10)) score = language == 0x0409 ? 6 : 5;
+        else if (platform == 3 && encoding == 0) score = language == 0x0409 ? 4 : 3;
+        else if (platform == 0) score = 2;
+        else if (platform == 1 && encoding == 0 && language == 0) score = 1;
+        if (score <= bestScore) continue;
+
+        size_t offset = storage + file.U16(record + 10);
+        size_t length = file.U16(record + 8);
+        if (length == 0 || !file.Has(offset, length)) continue;
+        bestScore = score;
+        bestOffset = offset;
+        bestLength = length;
+    }
+    if (bestScore == 0) return false;
+
+    if (bestScore > 1) {
+        // UTF-16BE
+        value.resize(bestLength / 2);
+        for (size_t i = 0; i < value.size(); i++) {
+            value[i] = static_cast<wchar_t>(file.U16(bestOffset + i * 2));
+        }
+    } else {
+        const char* bytes = reinterpret_cast<const char*>(file.data + bestOffset);
+        int length = MultiByteToWideChar(10000, 0, bytes, static_cast<int>(bestLength), NULL, 0);   // Mac Roman
+        value.resize(length > 0 ? length : 0);
+        if (length > 0) {
+            MultiByteToWideChar(10000, 0, bytes, static_cast<int>(bestLength), &value[0], length);
+        }
+    }
+    return !value.empty();
+}
+
+/*
+ * Reads the variable axes of the face from its fvar table
+ *
+ * The axis records must lie within the table, not just within the file.
+ */
+void ReadOpenTypeAxes(const OpenTypeReader& file, const OpenTypeTable& fvar, FontInfo& info)
+{
+    if (fvar.length < 16) return;
+    size_t axesOffset = file.U16(fvar.offset + 4);
+    UINT16 axisCount = file.U16(fvar.offset + 8);
+    UINT16 axisSize = file.U16(fvar.offset + 10);
+    size_t axesLength = static_cast<size_t>(axisCount) * axisSize;
+    if (axisCount == 0 || axisSize < 20 || axesOffset > fvar.length || axesLength > fvar.length - axesOffset) return;
+    size_t axes = fvar.offset + axesOffset;
+
+    std::vector<DWRITE_FONT_AXIS_RANGE> ranges(axisCount);
+    for (UINT16 a = 0; a < axisCount; a++) {
+        size_t record = axes + static_cast<size_t>(a) * axisSize;
+        // The tag is stored in reading order; DirectWrite tags are little-endian
+        ranges[a].axisTag = static_cast<DWRITE_FONT_AXIS_TAG>(_byteswap_ulong(file.U32(record)));
+        ranges[a].minValue = static_cast<INT32>(file.U32(record + 4)) / 65536.0f;    // 16.16 fixed
+        ranges[a].maxValue = static_cast<INT32>(file.U32(record + 12)) / 65536.0f;
+    }
+    DescribeAxisRanges(ranges.data(), axisCount, info.isVariable, info.variableAxes);
+}
+
+/*
+ * Reads the face whose table directory starts at faceOffset into info
+ *
+ * Returns false if it isn't a TrueType/CFF face or has no family name.
+ */
+bool ReadOpenTypeFace(const OpenTypeReader& file, size_t faceOffset, FontInfo& info)
+{
+    UINT32 version = file.U32(faceOffset);
+    if (version != 0x00010000 && version != OT_TAG('O', 'T', 'T', 'O') && version != OT_TAG('t', 'r', 'u', 'e')) {
+        return false;
+    }
+
+    info.weight = DWRITE_FONT_WEIGHT_NORMAL;
+    info.italic = false;
+    info.fixedPitch = false;
+    info.isVariable = false;
+    info.charSet = DEFAULT_CHARSET;
+
+    // --- Family and style names (WWS, then typographic, then legacy IDs) ---
+    OpenTypeTable name;
+    if (!FindOpenTypeTable(file, faceOffset, OT_TAG('n', 'a', 'm', 'e'), name)) return false;
+    static const UINT16 nameIds[][2] = { { 21, 22 }, { 16, 17 }, { 1, 2 } };
+    for (const auto& ids : nameIds) {
+        if (ReadOpenTypeName(file, name, ids[0], info.familyName)) {
+            if (!ReadOpenTypeName(file, name, ids[1], info.styleName) &&
+                !ReadOpenTypeName(file, name, 2, info.styleName)) {
+                info.styleName = L"Regular";
+            }
+            break;
+        }
+    }
+    if (info.familyName.empty()) return false;
+
+    // --- Weight and slant from OS/2, or head.macStyle without one ---
+    OpenTypeTable table;
+    if (FindOpenTypeTable(file, faceOffset, OT_TAG('O', 'S', '/', '2'), table) && table.length >= 64) {
+        int weight = file.U16(table.offset + 4);
+        if (weight >= 1 && weight <= 9) weight *= 100;      // Legacy 1-9 scale
+        if (weight >= 1 && weight <= 1000) info.weight = weight;
+        UINT16 fsSelection = file.U16(table.offset + 62);
+        info.italic = (fsSelection & 0x0201) != 0;          // ITALIC or OBLIQUE
+        // Some monospaced fonts only say so in PANOSE: Latin Text, Monospaced
+        info.fixedPitch = file.data[table.offset + 32] == 2 && file.data[table.offset + 35] == 9;
+    } else if (FindOpenTypeTable(file, faceOffset, OT_TAG('h', 'e', 'a', 'd'), table) && table.length >= 46) {
+        UINT16 macStyle = file.U16(table.offset + 44);
+        if (macStyle & 0x01) info.weight = DWRITE_FONT_WEIGHT_BOLD;
+        info.italic = (macStyle & 0x02) != 0;
+    }
+
+    // --- Monospace flag (post, or PANOSE above) and variable axes ---
+    if (FindOpenTypeTable(file, faceOffset, OT_TAG('p', 'o', 's', 't'), table) && table.length >= 16) {
+        info.fixedPitch |= file.U32(table.offset + 12) != 0;    // isFixedPitch
+    }
+    if (FindOpenTypeTable(file, faceOffset, OT_TAG('f', 'v', 'a', 'r'), table)) {
+        ReadOpenTypeAxes(file, table, info);
+    }
+    return true;
+}
+
+/*
+ * Reads every face of the mapped file (one, or each face of a TTC/OTC)
+ * into batcher
+ *
+ * Each FontInfo is built on the batch's arena and added as soon as it's
+ * read, so it never outlives the batch it was allocated from (Add may
+ * post the batch).
+ */
+void ReadOpenTypeFaces(const OpenTypeReader& file, const std::wstring& path, FontBatcher& batcher)
+{
+    UINT32 faceCount = 1;
+    bool collection = file.U32(0) == OT_TAG('t', 't', 'c', 'f');
+    if (collection) {
+        faceCount = file.U32(8);
+        if (!file.Has(12, static_cast<size_t>(faceCount) * 4)) return;
+    }
+
+    for (UINT32 i = 0; i < faceCount; i++) {
+        FontInfo info(batcher.Arena());
+        if (ReadOpenTypeFace(file, collection ? file.U32(12 + static_cast<size_t>(i) * 4) : 0, info)) {
+            info.filePath = path;
+            info.faceIndex = i;
+            batcher.Add(std::move(info));
+        }
+    }
+}
+
+/*
+ * Calls ReadOpenTypeFaces, turning a failed page-in of the mapping
+ * (e.g. the network share went away) into a false return
+ *
+ * Faces of the file read before the failure stay in the batch. Kept free
+ * of objects with destructors, as __try requires.
+ */
+bool ReadOpenTypeFacesGuarded(const OpenTypeReader& file, const std::wstring& path, FontBatcher& batcher)
+{
+    __try {
+        ReadOpenTypeFaces(file, path, batcher);
+        return true;
+    } __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        return false;
+    }
+}
+
+/*
+ * Returns the system and per-user font folders
+ */
+std::vector<std::wstring> GetFontFolders()
+{
+    std::vector<std::wstring> folders;
+    wchar_t dir[MAX_PATH];
+    UINT dirLen = GetWindowsDirectoryW(dir, MAX_PATH);
+    if (dirLen > 0 && dirLen < MAX_PATH) {
+        folders.push_back(std::wstring(dir) + L"\\Fonts");
+    }
+    DWORD envLen = GetEnvironmentVariableW(L"LOCALAPPDATA", dir, MAX_PATH);
+    if (envLen > 0 && envLen < MAX_PATH) {
+        std::wstring userFonts = std::wstring(dir) + L"\\Microsoft\\Windows\\Fonts";
+        if (GetFileAttributesW(userFonts.c_str()) != INVALID_FILE_ATTRIBUTES) {
+            folders.push_back(userFonts);
+        }
+    }
+    return folders;
+}
+
+/*
+ * Enumerates fonts by parsing the font files themselves
+ *
+ * Reads job.folderPath and its subfolders, or the system and per-user
+ * font folders if it is empty (fonts registered from elsewhere are not
+ * listed). Files are read by the folder reader pool, each reader
+ * batching its own results. Runs on the enumeration worker thread.
+ */
+void EnumerateOpenTypeFonts(EnumJob& job)
+{
+    StageClock clock(job);
+
+    std::vector<std::wstring> roots;
+    if (!job.folderPath.empty()) {
+        DWORD attributes = GetFileAttributesW(job.folderPath.c_str());
+        if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            job.errorText = L"Cannot open the folder";
+            return;
+        }
+        roots.push_back(job.folderPath);
+    } else {
+        roots = GetFontFolders();
+    }
+    clock.Lap(EnumStage::FontSource);
+
+    unsigned readerCount = GetFolderReaderCount();
+    std::vector<std::unique_ptr<FontBatcher>> batchers;
+    for (unsigned t = 0; t < readerCount; t++) {
+        batchers.push_back(std::make_unique<FontBatcher>(job));
+    }
+
+    ScanFontFolders(job, roots, readerCount, [&](const FolderWorkItem& item, unsigned reader) {
+        StageClock fileClock(job);
+        MappedFile mapping;
+        if (!mapping.Open(item.path.c_str())) return;
+        fileClock.Lap(EnumStage::FontSource);
+
+        // Faces go straight into the reader's batch, so Names includes Store
+        OpenTypeReader file = { mapping.Data(), mapping.Size() };
+        ReadOpenTypeFacesGuarded(file, item.path, *batchers[reader]);
+        fileClock.Lap(EnumStage::Names);
+    });
+    clock.Restart();
+    batchers.clear();  // Flush remaining batches
+    clock.Lap(EnumStage::Store);
+}
+
+// ============================================================================
+// FONT ENUMERATION - All APIs (comparison)
+// ============================================================================
+
+/*
+ * FontCollector - Keeps one backend's results for the join
+ *
+ * FontSet enumeration writes from several threads, so Write locks.
+ */
+class FontCollector : public FontSink {
+public:
+    void Write(const std::vector<FontInfo>& fonts) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fonts.insert(m_fonts.end(), fonts.begin(), fonts.end());
+    }
+
+    std::vector<FontInfo>& Fonts() { return m_fonts; }
+
+private:
+    std::mutex m_mutex;
+    std::vector<FontInfo> m_fonts;
+};
+
+/*
+ * Join keys for EnumerateAllFonts
+ *
+ * The name key is the case-folded family and style, the only thing GDI
+ * reports. The path key (case-folded path, face index and style) matches
+ * DirectWrite and FontSet faces regardless of their family names; the
+ * style keeps the named instances of a variable font apart.
+ */
+std::wstring MakeFontNameKey(const FontInfo& info)
+{
+    std::wstring key = FoldCase(info.familyName);
+    key += L'\0';
+    key += FoldCase(info.styleName);
+    return key;
+}
+
+std::wstring MakeFontPathKey(const FontInfo& info)
+{
+    std::wstring key = FoldCase(info.filePath);
+    key += L'\0';
+    key += std::to_wstring(info.faceIndex);
+    key += L'\0';
+    key += FoldCase(info.styleName);
+    return key;
+}
+
+/*
+ * Enumerates with GDI, DirectWrite and FontSet at the same time and joins
+ * the results into one record per face, with FontInfo::sources telling
+ * which APIs reported it
+ *
+ * GDI and DirectWrite run on threads of their own while FontSet (itself
+ * parallel) runs on the calling thread, so the run takes about as long
+ * as the slowest backend. The join is a hash join: FontSet records are
+ * the build side, DirectWrite probes by path key and then name key, GDI
+ * by name key. A face no other API matched becomes a row of its own.
+ */
+void EnumerateAllFonts(EnumJob& job)
+{
+    struct Backend {
+        EnumMode mode;
+        BYTE source;
+    };
+    static const Backend backends[] = {
+        { EnumMode::FontSet, FONT_SOURCE_FONTSET },
+        { EnumMode::DirectWrite, FONT_SOURCE_DWRITE },
+        { EnumMode::GDI, FONT_SOURCE_GDI },
+    };
+    const size_t backendCount = ARRAYSIZE(backends);
+
+    EnumJob jobs[backendCount];
+    FontCollector results[backendCount];
+    std::vector<std::thread> threads;
+    for (size_t b = 0; b < backendCount; b++) {
+        jobs[b].mode = backends[b].mode;
+        jobs[b].generation = job.generation;
+        jobs[b].checkForUpdates = job.checkForUpdates;
+        jobs[b].sink = &results[b];
+        jobs[b].timings = job.timings;
+        jobs[b].deferDetails = job.deferDetails;
+        jobs[b].parent = &job;
+        if (b > 0) {
+            threads.emplace_back(RunEnumerator, std::ref(jobs[b]));
+        }
+    }
+    RunEnumerator(jobs[0]);
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    StageClock clock(job);
+    for (size_t b = 0; b < backendCount; b++) {
+        job.processed += jobs[b].processed.load();
+        job.total += jobs[b].total.load();
+        job.allocations.count += jobs[b].allocations.count.load();
+        job.allocations.bytes += jobs[b].allocations.bytes.load();
+        if (!job.errorText) job.errorText = jobs[b].errorText;
+    }
+    if (job.IsCancelled()) return;
+
+    std::vector<FontInfo> joined;
+    std::unordered_map<std::wstring, size_t> byPath;
+    std::unordered_map<std::wstring, size_t> byName;
+    size_t expected = 0;
+    for (auto& result : results) expected += result.Fonts().size();
+    joined.reserve(expected);
+    byPath.reserve(expected);
+    byName.reserve(expected);
+
+    // Adds an unmatched face as a row of its own
+    auto addRow = [&](FontInfo&& info, BYTE source) {
+        info.sources = source;
+        size_t row = joined.size();
+        if (!info.filePath.empty()) {
+            byPath.emplace(MakeFontPathKey(info), row);
+        }
+        byName.emplace(MakeFontNameKey(info), row);
+        joined.push_back(std::move(info));
+    };
+
+    // Returns the row matching info not yet claimed by source, or SIZE_MAX
+    auto findRow = [&](const FontInfo& info, BYTE source) -> size_t {
+        if (!info.filePath.empty()) {
+            auto it = byPath.find(MakeFontPathKey(info));
+            if (it != byPath.end() && !(joined[it->second].sources & source)) return it->second;
+        }
+        auto it = byName.find(MakeFontNameKey(info));
+        if (it != byName.end() && !(joined[it->second].sources & source)) return it->second;
+        return SIZE_MAX;
+    };
+
+    for (size_t b = 0; b < backendCount; b++) {
+        BYTE source = backends[b].source;
+        for (FontInfo& info : results[b].Fonts()) {
+            size_t row = b == 0 ? SIZE_MAX : findRow(info, source);
+            if (row == SIZE_MAX) {
+                addRow(std::move(info), source);
+                continue;
+            }
+            FontInfo& match = joined[row];
+            match.sources |= source;
+            if (source == FONT_SOURCE_GDI) {
+                match.charSet = info.charSet;   // Only GDI reports one
+            }
+        }
+        results[b].Fonts().clear();
+    }
+
+    FontBatcher batcher(job);
+    for (FontInfo& info : joined) {
+        batcher.Add(std::move(info));
+    }
+    batcher.Flush();
+    clock.Lap(EnumStage::Store);
+}
+
+// ============================================================================
+// ENUMERATION SNAPSHOTS - Persistent, memory-mapped results per EnumMode
+// ============================================================================
+
+/*
+ * On-disk snapshot format (version 2), little-endian:
+ *
+ *   SnapshotHeader
+ *   SnapshotRecord[recordCount]      fixed-size records, at recordsOffset
+ *   wchar_t strings[stringsSize]     NUL-terminated strings, at stringsOffset
+ *
+ * Records reference strings by wchar_t offset into the string table, so a
+ * mapped snapshot is read in place. Equal strings (e.g. a family shared by
+ * many faces) are stored once. The fingerprint records the system font
+ * state the snapshot was taken from (see ComputeFontFingerprint).
+ *
+ * Snapshots live in %LOCALAPPDATA%\FontEnum\<mode>.snapshot and are
+ * replaced atomically after every successful live enumeration.
+ */
+#define SNAPSHOT_MAGIC          0x534E4546  // "FENS"
+#define SNAPSHOT_VERSION        2
+
+#define SNAPSHOT_FLAG_ITALIC    0x0001
+#define SNAPSHOT_FLAG_FIXED     0x0002
+#define SNAPSHOT_FLAG_VARIABLE  0x0004
+#define SNAPSHOT_FLAG_PENDING   0x0008  // Deferred details not read when saved
+
+struct SnapshotHeader {
+    UINT32 magic;           // SNAPSHOT_MAGIC
+    UINT32 version;         // SNAPSHOT_VERSION
+    UINT32 mode;            // EnumMode the records came from
+    UINT32 recordCount;
+    UINT64 fingerprint;     // ComputeFontFingerprint() when the snapshot was taken
+    UINT32 recordsOffset;   // Byte offset of the first SnapshotRecord
+    UINT32 stringsOffset;   // Byte offset of the string table
+    UINT32 stringsSize;     // String table size in wchar_t units
+    UINT32 reserved;
+};
+
+struct SnapshotRecord {
+    UINT32 familyName;      // String table offsets (wchar_t units)
+    UINT32 styleName;
+    UINT32 filePath;
+    UINT32 variableAxes;
+    INT32 weight;
+    UINT16 flags;           // SNAPSHOT_FLAG_*
+    UINT16 charSet;
+    UINT32 faceIndex;       // Face index within filePath
+};
+
+/*
+ * Returns the path of fileName in %LOCALAPPDATA%\FontEnum, creating the
+ * directory if needed
+ */
+std::wstring GetDataFilePath(const std::wstring& fileName)
+{
+    wchar_t base[MAX_PATH];
+    DWORD len = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+    if (len == 0 || len >= MAX_PATH) return std::wstring();
+
+    std::wstring dir = std::wstring(base) + L"\\FontEnum";
+    CreateDirectoryW(dir.c_str(), NULL);  // Fails harmlessly if it exists
+    return dir + L"\\" + fileName;
+}
+
+/*
+ * Data file writer - writes snapshot files off the UI thread
+ *
+ * The UI thread lays a file out in memory (a copy, cheap next to the
+ * disk write) and queues it with QueueDataFile; the writer thread writes
+ * it under a temporary name and renames it over the old file, so a crash
+ * never leaves a truncated file behind. Queuing a path that is still
+ * waiting replaces its contents. The thread starts with the first write;
+ * StopDataFileWriter writes whatever is still queued before returning.
+ */
+struct DataFileWrite {
+    std::wstring path;
+    std::vector<BYTE> contents;
+};
+
+std::mutex g_dataFileMutex;
+std::condition_variable g_dataFileWake;
+std::deque<DataFileWrite> g_dataFileQueue;     // Guarded by g_dataFileMutex
+bool g_dataFileStop = false;
+std::thread g_dataFileThread;
+
+/*
+ * Appends size bytes at data to contents (for laying out a data file)
+ */
+void AppendBytes(std::vector<BYTE>& contents, const void* data, size_t size)
+{
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    contents.insert(contents.end(), bytes, bytes + size);
+}
+
+/*
+ * Writes contents to path via a temporary file and an atomic rename
+ */
+bool WriteDataFile(const std::wstring& path, const std::vector<BYTE>& contents)
+{
+    std::wstring tempPath = path + L".tmp";
+    HANDLE hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) return false;
+
+    bool ok = WriteAll(hFile, contents.data(), contents.size());
+    CloseHandle(hFile);
+
+    if (!ok || !MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Writer thread - writes queued files until stopped and drained
+ */
+void DataFileThreadProc()
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+    std::unique_lock<std::mutex> lock(g_dataFileMutex);
+    for (;;) {
+        g_dataFileWake.wait(lock, [] { return g_dataFileStop || !g_dataFileQueue.empty(); });
+        if (g_dataFileQueue.empty()) break;     // Stopped, nothing left to write
+
+        DataFileWrite write = std::move(g_dataFileQueue.front());
+        g_dataFileQueue.pop_front();
+        lock.unlock();
+        WriteDataFile(write.path, write.contents);
+        lock.lock();
+    }
+}
+
+/*
+ * Queues contents to be written to path by the writer thread (UI thread)
+ */
+void QueueDataFile(const std::wstring& path, std::vector<BYTE> contents)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_dataFileMutex);
+        auto it = std::find_if(g_dataFileQueue.begin(), g_dataFileQueue.end(),
+            [&](const DataFileWrite& write) { return write.path == path; });
+        if (it != g_dataFileQueue.end()) {
+            it->contents = std::move(contents);     // Only the newest contents matter
+        } else {
+            g_dataFileQueue.push_back({ path, std::move(contents) });
+        }
+    }
+    if (!g_dataFileThread.joinable()) {
+        g_dataFileStop = false;
+        g_dataFileThread = std::thread(DataFileThreadProc);
+    }
+    g_dataFileWake.notify_one();
+}
+
+/*
+ * Writes the files still queued and stops the writer thread
+ */
+void StopDataFileWriter()
+{
+    if (!g_dataFileThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(g_dataFileMutex);
+        g_dataFileStop = true;
+    }
+    g_dataFileWake.notify_one();
+    g_dataFileThread.join();
+}
+
+/*
+ * Returns the snapshot file path for mode
+ */
+std::wstring GetSnapshotPath(EnumMode mode)
+{
+    if (mode == EnumMode::All) return std::wstring();  // Joins are always recomputed
+    if (mode == EnumMode::Folder) return std::wstring();    // Folders change without notice
+    if (mode == EnumMode::Families) return std::wstring();  // Faces load after the group rows
+    return GetDataFilePath(std::wstring(GetModeName(mode)) + L".snapshot");
+}
+
+/*
+ * Mixes the registry key's value count and last-write time into hash
+ */
+void HashRegistryKey(UINT64& hash, HKEY root, const wchar_t* subKey)
+{
+    HKEY hKey = NULL;
+    if (RegOpenKeyExW(root, subKey, 0, KEY_READ, &hKey) != ERROR_SUCCESS) return;
+
+    DWORD valueCount = 0;
+    FILETIME lastWrite = {};
+    if (RegQueryInfoKeyW(hKey, NULL, NULL, NULL, NULL, NULL, NULL, &valueCount,
+            NULL, NULL, NULL, &lastWrite) == ERROR_SUCCESS) {
+        hash = HashBytes(hash, &valueCount, sizeof(valueCount));
+        hash = HashBytes(hash, &lastWrite, sizeof(lastWrite));
+    }
+    RegCloseKey(hKey);
+}
+
+/*
+ * Mixes a file or directory's last-write time into hash
+ */
+void HashFileTime(UINT64& hash, const std::wstring& path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
+        hash = HashBytes(hash, &data.ftLastWriteTime, sizeof(data.ftLastWriteTime));
+    }
+}
+
+/*
+ * Computes a fingerprint of the installed font state
+ *
+ * Covers the font registry keys, the system and per-user font folders,
+ * and every file in the DirectWrite system font set (reference key and
+ * last-write time). Much cheaper than an enumeration: no names are read
+ * and no font faces are created. Runs on the worker thread; stops early
+ * (with a meaningless result) if job is cancelled.
+ */
+UINT64 ComputeFontFingerprint(const EnumJob* job)
+{
+    UINT64 hash = FNV_OFFSET_BASIS;
+
+    const wchar_t* fontsKey = L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts";
+    HashRegistryKey(hash, HKEY_LOCAL_MACHINE, fontsKey);
+    HashRegistryKey(hash, HKEY_CURRENT_USER, fontsKey);
+
+    wchar_t dir[MAX_PATH];
+    UINT dirLen = GetWindowsDirectoryW(dir, MAX_PATH);
+    if (dirLen > 0 && dirLen < MAX_PATH) {
+        HashFileTime(hash, std::wstring(dir) + L"\\Fonts");
+    }
+    DWORD envLen = GetEnvironmentVariableW(L"LOCALAPPDATA", dir, MAX_PATH);
+    if (envLen > 0 && envLen < MAX_PATH) {
+        HashFileTime(hash, std::wstring(dir) + L"\\Microsoft\\Windows\\Fonts");
+    }
+
+    IDWriteFactory3* pDWriteFactory3 = nullptr;
+    if (FAILED(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory3),
+            reinterpret_cast<IUnknown**>(&pDWriteFactory3)))) {
+        return hash;  // Pre-Windows 10: registry and folder times only
+    }
+
+    IDWriteFontSet* pFontSet = nullptr;
+    if (SUCCEEDED(pDWriteFactory3->GetSystemFontSet(&pFontSet))) {
+        UINT32 fontCount = pFontSet->GetFontCount();
+        hash = HashBytes(hash, &fontCount, sizeof(fontCount));
+
+        for (UINT32 i = 0; i < fontCount && !(job && job->IsCancelled()); i++) {
+            IDWriteFontFaceReference* pFontFaceRef = nullptr;
+            if (FAILED(pFontSet->GetFontFaceReference(i, &pFontFaceRef))) continue;
+
+            IDWriteFontFile* pFontFile = nullptr;
+            if (SUCCEEDED(pFontFaceRef->GetFontFile(&pFontFile))) {
+                const void* refKey = nullptr;
+                UINT32 refKeySize = 0;
+                if (SUCCEEDED(pFontFile->GetReferenceKey(&refKey, &refKeySize))) {
+                    hash = HashBytes(hash, refKey, refKeySize);
+
+                    IDWriteFontFileLoader* pLoader = nullptr;
+                    if (SUCCEEDED(pFontFile->GetLoader(&pLoader))) {
+                        IDWriteLocalFontFileLoader* pLocalLoader = nullptr;
+                        if (SUCCEEDED(pLoader->QueryInterface(__uuidof(IDWriteLocalFontFileLoader), (void**)&pLocalLoader))) {
+                            FILETIME lastWrite = {};
+                            if (SUCCEEDED(pLocalLoader->GetLastWriteTimeFromKey(refKey, refKeySize, &lastWrite))) {
+                                hash = HashBytes(hash, &lastWrite, sizeof(lastWrite));
+                            }
+                            pLocalLoader->Release();
+                        }
+                        pLoader->Release();
+                    }
+                }
+                pFontFile->Release();
+            }
+            pFontFaceRef->Release();
+        }
+        pFontSet->Release();
+    }
+    pDWriteFactory3->Release();
+
+    return hash;
+}
+
+/*
+ * SnapshotView - A mapped, validated snapshot, read in place
+ */
+struct SnapshotView {
+    MappedFile file;
+    const SnapshotHeader* header = nullptr;
+    const SnapshotRecord* records = nullptr;
+    const wchar_t* strings = nullptr;
+};
+
+/*
+ * Maps and validates the snapshot for mode
+ *
+ * Returns false if the file is missing, from another version or mode,
+ * or structurally invalid (every offset is bounds-checked).
+ */
+bool OpenSnapshot(EnumMode mode, SnapshotView& view)
+{
+    std::wstring path = GetSnapshotPath(mode);
+    MappedFile& file = view.file;
+    if (path.empty() || !file.Open(path.c_str()) || file.Size() < sizeof(SnapshotHeader)) {
+        return false;
+    }
+
+    const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(file.Data());
+    if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+        header->mode != static_cast<UINT32>(mode)) {
+        return false;
+    }
+
+    UINT64 recordsEnd = UINT64(header->recordsOffset) + UINT64(header->recordCount) * sizeof(SnapshotRecord);
+    UINT64 stringsEnd = UINT64(header->stringsOffset) + UINT64(header->stringsSize) * sizeof(wchar_t);
+    if (header->recordsOffset % alignof(SnapshotRecord) != 0 || header->stringsOffset % sizeof(wchar_t) != 0 ||
+        recordsEnd > file.Size() || stringsEnd > file.Size() || header->stringsSize == 0) {
+        return false;
+    }
+
+    const SnapshotRecord* records = reinterpret_cast<const SnapshotRecord*>(file.Data() + header->recordsOffset);
+    const wchar_t* strings = reinterpret_cast<const wchar_t*>(file.Data() + header->stringsOffset);
+    const UINT32 stringsSize = header->stringsSize;
+    if (strings[stringsSize - 1] != L'\0') {
+        return false;  // Guarantees every in-range offset is NUL-terminated
+    }
+    for (UINT32 i = 0; i < header->recordCount; i++) {
+        const SnapshotRecord& rec = records[i];
+        if (rec.familyName >= stringsSize || rec.styleName >= stringsSize ||
+            rec.filePath >= stringsSize || rec.variableAxes >= stringsSize) {
+            return false;
+        }
+    }
+
+    view.header = header;
+    view.records = records;
+    view.strings = strings;
+    return true;
+}
+
+/*
+ * Reads the snapshot for mode straight into fonts (cleared first)
+ *
+ * Each string table entry is interned once, however many records refer
+ * to it, and the records are stored by the resulting IDs; no FontInfo
+ * is built. fonts is left untouched if the snapshot is unusable.
+ */
+bool ReadSnapshot(EnumMode mode, UINT64* pFingerprint, FontStore& fonts)
+{
+    SnapshotView view;
+    if (!OpenSnapshot(mode, view)) return false;
+
+    // Pool ID per string table offset; only the starts of entries are used
+    std::vector<UINT32> ids(view.header->stringsSize, UINT32_MAX);
+    auto intern = [&](UINT32 offset) -> UINT32 {
+        if (ids[offset] == UINT32_MAX) ids[offset] = fonts.Intern(view.strings + offset);
+        return ids[offset];
+    };
+
+    fonts.clear();
+    fonts.reserve(view.header->recordCount);
+    for (UINT32 i = 0; i < view.header->recordCount; i++) {
+        const SnapshotRecord& rec = view.records[i];
+        fonts.AddInterned(intern(rec.familyName), intern(rec.styleName), intern(rec.filePath),
+            intern(rec.variableAxes), rec.weight,
+            static_cast<BYTE>(
+                ((rec.flags & SNAPSHOT_FLAG_ITALIC) ? FONT_FLAG_ITALIC : 0) |
+                ((rec.flags & SNAPSHOT_FLAG_FIXED) ? FONT_FLAG_FIXED : 0) |
+                ((rec.flags & SNAPSHOT_FLAG_VARIABLE) ? FONT_FLAG_VARIABLE : 0) |
+                ((rec.flags & SNAPSHOT_FLAG_PENDING) ? FONT_FLAG_PENDING : 0)),
+            rec.charSet, rec.faceIndex, 0);
+    }
+
+    *pFingerprint = view.header->fingerprint;
+    return true;
+}
+
+/*
+ * Converts fonts into snapshot records and their string table
+ *
+ * The string table is built from the interned strings still referenced;
+ * pool ID 0 (the empty string) becomes offset 0. Also used for the
+ * shared memory inventory (see INVENTORY PUBLISHING).
+ */
+void BuildSnapshotTables(const FontStore& fonts, std::vector<SnapshotRecord>& records, std::vector<wchar_t>& strings)
+{
+    const StringPool& pool = fonts.Pool();
+    strings.assign(1, L'\0');
+    std::vector<UINT32> stringOffsets(pool.Count(), UINT32_MAX);
+    stringOffsets[0] = 0;
+    auto addString = [&](UINT32 id) -> UINT32 {
+        if (stringOffsets[id] == UINT32_MAX) {
+            std::wstring_view str = pool.View(id);
+            stringOffsets[id] = static_cast<UINT32>(strings.size());
+            strings.insert(strings.end(), str.begin(), str.end());
+            strings.push_back(L'\0');
+        }
+        return stringOffsets[id];
+    };
+
+    records.clear();
+    records.reserve(fonts.size());
+    for (size_t i = 0; i < fonts.size(); i++) {
+        if (fonts.IsGroup(i)) continue;     // Families mode rows stand for faces
+        SnapshotRecord rec = {};
+        rec.familyName = addString(fonts.FamilyId(i));
+        rec.styleName = addString(fonts.StyleId(i));
+        rec.filePath = addString(fonts.PathId(i));
+        rec.variableAxes = addString(fonts.AxesId(i));
+        rec.weight = fonts.Weight(i);
+        rec.flags = static_cast<UINT16>(
+            (fonts.IsItalic(i) ? SNAPSHOT_FLAG_ITALIC : 0) |
+            (fonts.IsFixedPitch(i) ? SNAPSHOT_FLAG_FIXED : 0) |
+            (fonts.IsVariable(i) ? SNAPSHOT_FLAG_VARIABLE : 0) |
+            (fonts.DetailsPending(i) ? SNAPSHOT_FLAG_PENDING : 0));
+        rec.charSet = static_cast<UINT16>(fonts.CharSet(i));
+        rec.faceIndex = fonts.FaceIndex(i);
+        records.push_back(rec);
+    }
+}
+
+/*
+ * Writes fonts as the snapshot for mode
+ *
+ * The records and string table are laid out here, on the calling
+ * thread; the file itself is written by the data file writer.
+ */
+bool SaveSnapshot(EnumMode mode, UINT64 fingerprint, const FontStore& fonts)
+{
+    std::wstring path = GetSnapshotPath(mode);
+    if (path.empty()) return false;
+
+    std::vector<SnapshotRecord> records;
+    std::vector<wchar_t> strings;
+    BuildSnapshotTables(fonts, records, strings);
+
+    SnapshotHeader header = {};
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.mode = static_cast<UINT32>(mode);
+    header.recordCount = static_cast<UINT32>(records.size());
+    header.fingerprint = fingerprint;
+    header.recordsOffset = sizeof(SnapshotHeader);
+    header.stringsOffset = static_cast<UINT32>(sizeof(SnapshotHeader) + records.size() * sizeof(SnapshotRecord));
+    header.stringsSize = static_cast<UINT32>(strings.size());
+
+    std::vector<BYTE> contents;
+    contents.reserve(header.stringsOffset + strings.size() * sizeof(wchar_t));
+    AppendBytes(contents, &header, sizeof(header));
+    AppendBytes(contents, records.data(), records.size() * sizeof(SnapshotRecord));
+    AppendBytes(contents, strings.data(), strings.size() * sizeof(wchar_t));
+    QueueDataFile(path, std::move(contents));
+    return true;
+}
+
+/*
+ * Streams the snapshot for the job's mode if it matches job.fingerprint
+ *
+ * Returns false (and emits nothing) when there is no usable snapshot or
+ * the installed fonts changed since it was written.
+ */
+bool LoadSnapshotBatches(EnumJob& job)
+{
+    SnapshotView view;
+    if (!OpenSnapshot(job.mode, view) || view.header->fingerprint != job.fingerprint) {
+        return false;
+    }
+
+    // Records go straight from the mapping into the batch arenas
+    FontBatcher batcher(job);
+    job.total = view.header->recordCount;
+    for (UINT32 i = 0; i < view.header->recordCount; i++) {
+        const SnapshotRecord& rec = view.records[i];
+        FontInfo font(batcher.Arena());
+        font.familyName = view.strings + rec.familyName;
+        font.styleName = view.strings + rec.styleName;
+        font.filePath = view.strings + rec.filePath;
+        font.variableAxes = view.strings + rec.variableAxes;
+        font.weight = rec.weight;
+        font.italic = (rec.flags & SNAPSHOT_FLAG_ITALIC) != 0;
+        font.fixedPitch = (rec.flags & SNAPSHOT_FLAG_FIXED) != 0;
+        font.isVariable = (rec.flags & SNAPSHOT_FLAG_VARIABLE) != 0;
+        font.detailsPending = (rec.flags & SNAPSHOT_FLAG_PENDING) != 0;
+        font.charSet = rec.charSet;
+        font.faceIndex = rec.faceIndex;
+        job.processed++;
+        batcher.Add(std::move(font));
+    }
+    job.fromSnapshot = true;
+    return true;
+}
+
+// ============================================================================
+// INVENTORY PUBLISHING - g_fonts in shared memory for other processes
+// ============================================================================
+
+/*
+ * With --publish, every completed list (enumeration, rescan, startup
+ * snapshot, finished detail sweep) is copied into a new named section in
+ * the snapshot layout and made current by bumping the sequence number in
+ * the control section; see FontInventory.h for the format and the
+ * header-only reader. Published sections are never written again, so
+ * clients map them read-only and read them in place.
+ *
+ * Both kinds of section are created with a DACL that gives other users
+ * only FILE_MAP_READ; full access stays with the owner (the user running
+ * FontEnum), so other instances of the same user can still publish.
+ */
+static_assert(sizeof(FontInventoryRecord) == sizeof(SnapshotRecord), "Inventory records use the snapshot layout");
+static_assert(FONT_INVENTORY_FLAG_ITALIC == SNAPSHOT_FLAG_ITALIC && FONT_INVENTORY_FLAG_FIXED == SNAPSHOT_FLAG_FIXED &&
+              FONT_INVENTORY_FLAG_VARIABLE == SNAPSHOT_FLAG_VARIABLE && FONT_INVENTORY_FLAG_PENDING == SNAPSHOT_FLAG_PENDING,
+              "Inventory flags use the snapshot values");
+
+bool g_publishInventory = false;                    // --publish
+HANDLE g_hInventoryControl = NULL;
+FontInventoryControl* g_inventoryControl = nullptr;
+HANDLE g_hInventorySection = NULL;                  // Current inventory, kept open while current
+UINT64 g_inventorySequence = 0;
+PSECURITY_DESCRIPTOR g_inventorySecurity = nullptr;  // Owner: all access, everyone: map for reading
+
+// Owner Rights get full access; Everyone gets generic read, which for a
+// section is SECTION_QUERY | SECTION_MAP_READ. Protected, so nothing is
+// inherited from the namespace.
+#define INVENTORY_SECTION_SDDL  L"D:P(A;;GA;;;OW)(A;;GR;;;WD)"
+
+/*
+ * Fills sa with the inventory section security, building it on first use
+ *
+ * Returns false if it can't be built; nothing is published then, rather
+ * than falling back to a section anyone in the session could rewrite.
+ */
+bool GetInventorySecurity(SECURITY_ATTRIBUTES& sa)
+{
+    if (!g_inventorySecurity &&
+        !ConvertStringSecurityDescriptorToSecurityDescriptorW(INVENTORY_SECTION_SDDL, SDDL_REVISION_1,
+            &g_inventorySecurity, NULL)) {
+        g_inventorySecurity = nullptr;
+        return false;
+    }
+    sa.nLength = sizeof(sa);
+    sa.lpSecurityDescriptor = g_inventorySecurity;
+    sa.bInheritHandle = FALSE;
+    return true;
+}
+
+/*
+ * Creates or opens the control section
+ */
+bool OpenInventoryControl()
+{
+    if (g_inventoryControl) return true;
+
+    SECURITY_ATTRIBUTES sa;
+    if (!GetInventorySecurity(sa)) return false;
+    g_hInventoryControl = CreateFileMappingW(INVALID_HANDLE_VALUE, &sa, PAGE_READWRITE,
+        0, sizeof(FontInventoryControl), FONT_INVENTORY_CONTROL_NAME);
+    if (!g_hInventoryControl) return false;
+
+    g_inventoryControl = static_cast<FontInventoryControl*>(
+        MapViewOfFile(g_hInventoryControl, FILE_MAP_WRITE, 0, 0, sizeof(FontInventoryControl)));
+    if (!g_inventoryControl) {
+        CloseHandle(g_hInventoryControl);
+        g_hInventoryControl = NULL;
+        return false;
+    }
+    g_inventoryControl->magic = FONT_INVENTORY_MAGIC;   // Also when another instance created it
+    g_inventoryControl->version = FONT_INVENTORY_VERSION;
+    return true;
+}
+
+/*
+ * Publishes g_fonts as the current inventory (no-op without --publish)
+ */
+bool PublishFontInventory()
+{
+    if (!g_publishInventory || g_currentMode == EnumMode::None || !OpenInventoryControl()) {
+        return false;
+    }
+
+    std::vector<SnapshotRecord> records;
+    std::vector<wchar_t> strings;
+    BuildSnapshotTables(g_fonts, records, strings);
+    UINT32 modeName = static_cast<UINT32>(strings.size());
+    for (const wchar_t* p = GetModeName(g_currentMode); *p; p++) {
+        strings.push_back(*p);
+    }
+    strings.push_back(L'\0');
+
+    FontInventoryHeader header = {};
+    header.magic = FONT_INVENTORY_MAGIC;
+    header.version = FONT_INVENTORY_VERSION;
+    header.fingerprint = g_fontsFingerprint;
+    header.modeName = modeName;
+    header.recordCount = static_cast<UINT32>(records.size());
+    header.recordsOffset = sizeof(FontInventoryHeader);
+    header.stringsOffset = static_cast<UINT32>(sizeof(FontInventoryHeader) + records.size() * sizeof(SnapshotRecord));
+    header.stringsSize = static_cast<UINT32>(strings.size());
+    UINT64 size = UINT64(header.stringsOffset) + strings.size() * sizeof(wchar_t);
+
+    // Numbers come from the control section, so several instances never
+    // share a name; one still held by a client of an earlier run is skipped
+    SECURITY_ATTRIBUTES sa;
+    if (!GetInventorySecurity(sa)) return false;
+    HANDLE hSection = NULL;
+    for (int attempt = 0; attempt < 4 && !hSection; attempt++) {
+        header.sequence = static_cast<UINT64>(InterlockedIncrement64(&g_inventoryControl->lastSequence));
+        wchar_t name[64];
+        swprintf_s(name, FONT_INVENTORY_SECTION_NAME, static_cast<unsigned long long>(header.sequence));
+        hSection = CreateFileMappingW(INVALID_HANDLE_VALUE, &sa, PAGE_READWRITE,
+            static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), name);
+        if (hSection && GetLastError() == ERROR_ALREADY_EXISTS) {
+            CloseHandle(hSection);
+            hSection = NULL;
+        }
+    }
+    if (!hSection) return false;
+
+    BYTE* view = static_cast<BYTE*>(MapViewOfFile(hSection, FILE_MAP_WRITE, 0, 0, 0));
+    if (!view) {
+        CloseHandle(hSection);
+        return false;
+    }
+    memcpy(view, &header, sizeof(header));
+    memcpy(view + header.recordsOffset, records.data(), records.size() * sizeof(SnapshotRecord));
+    memcpy(view + header.stringsOffset, strings.data(), strings.size() * sizeof(wchar_t));
+    UnmapViewOfFile(view);
+
+    // Clients holding the previous section keep their view after we close it
+    InterlockedExchange64(&g_inventoryControl->sequence, static_cast<LONG64>(header.sequence));
+    if (g_hInventorySection) CloseHandle(g_hInventorySection);
+    g_hInventorySection = hSection;
+    g_inventorySequence = header.sequence;
+    return true;
+}
+
+/*
+ * Withdraws the inventory at exit, unless another instance published since
+ */
+void UnpublishFontInventory()
+{
+    if (g_inventoryControl) {
+        InterlockedCompareExchange64(&g_inventoryControl->sequence, 0, static_cast<LONG64>(g_inventorySequence));
+        UnmapViewOfFile(g_inventoryControl);
+        CloseHandle(g_hInventoryControl);
+        g_inventoryControl = nullptr;
+        g_hInventoryControl = NULL;
+    }
+    if (g_hInventorySection) {
+        CloseHandle(g_hInventorySection);
+        g_hInventorySection = NULL;
+    }
+    if (g_inventorySecurity) {
+        LocalFree(g_inventorySecurity);
+        g_inventorySecurity = nullptr;
+    }
+}
+
+// ============================================================================
+// COVERAGE INDEX - Unicode coverage per face, for covers: queries
+// ============================================================================
+
+/*
+ * A face's coverage is its cmap as a sorted list of code point ranges
+ * (IDWriteFontFace1::GetUnicodeRanges): a few dozen ranges for most
+ * fonts instead of a 1.1M-bit bitmap. Identical range sets, common
+ * within a family, are stored once. Faces are keyed by location (path
+ * and face index; family, weight and slant for GDI faces, which have no
+ * path), so the index survives mode switches and reordering.
+ *
+ * The index is built in the background after each enumeration and saved
+ * to %LOCALAPPDATA%\FontEnum\Coverage.snapshot with the font fingerprint:
+ *
+ *   CoverageHeader
+ *   CoverageEntry entries[entryCount]     face key -> set
+ *   UINT32 setOffsets[setCount + 1]       set i = ranges[setOffsets[i] .. setOffsets[i + 1])
+ *   UINT32 ranges[rangeCount * 2]         first, last code point pairs
+ *   wchar_t keys[keysSize]
+ */
+#define COVERAGE_MAGIC      0x56434546  // "FECV"
+#define COVERAGE_VERSION    1
+#define COVERAGE_NONE       UINT32_MAX  // Face not indexed (yet)
+
+struct CoverageHeader {
+    UINT32 magic;           // COVERAGE_MAGIC
+    UINT32 version;         // COVERAGE_VERSION
+    UINT64 fingerprint;     // ComputeFontFingerprint() the index was built under
+    UINT32 entryCount;
+    UINT32 setCount;
+    UINT32 rangeCount;
+    UINT32 keysSize;        // wchar_t units
+};
+
+struct CoverageEntry {
+    UINT32 keyOffset;       // Into keys (wchar_t units)
+    UINT32 keyLength;
+    UINT32 set;
+};
+
+/*
+ * CoverageIndex - Deduplicated range sets and the face key -> set map
+ */
+class CoverageIndex {
+public:
+    CoverageIndex() = default;
+    CoverageIndex(const CoverageIndex&) = delete;
+    CoverageIndex& operator=(const CoverageIndex&) = delete;
+
+    // Returns the ID of the set of ranges (first, last pairs), adding it if new
+    UINT32 AddSet(const std::vector<UINT32>& ranges)
+    {
+        UINT64 hash = HashBytes(FNV_OFFSET_BASIS, ranges.data(), ranges.size() * sizeof(UINT32));
+        auto existing = m_setsByHash.equal_range(hash);
+        for (auto it = existing.first; it != existing.second; ++it) {
+            UINT32 begin = m_setOffsets[it->second];
+            UINT32 end = m_setOffsets[it->second + 1];
+            if (end - begin == ranges.size() &&
+                std::equal(ranges.begin(), ranges.end(), m_ranges.begin() + begin)) {
+                return it->second;
+            }
+        }
+        UINT32 id = SetCount();
+        m_ranges.insert(m_ranges.end(), ranges.begin(), ranges.end());
+        m_setOffsets.push_back(static_cast<UINT32>(m_ranges.size()));
+        m_setsByHash.emplace(hash, id);
+        return id;
+    }
+
+    void SetFace(const std::wstring& key, UINT32 set) { m_faces[key] = set; }
+
+    UINT32 Find(const std::wstring& key) const
+    {
+        auto it = m_faces.find(key);
+        return it == m_faces.end() ? COVERAGE_NONE : it->second;
+    }
+
+    // Binary search for the range containing codePoint
+    bool Covers(UINT32 set, UINT32 codePoint) const
+    {
+        const UINT32* ranges = m_ranges.data() + m_setOffsets[set];
+        size_t count = (m_setOffsets[set + 1] - m_setOffsets[set]) / 2;
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (ranges[mid * 2 + 1] < codePoint) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo < count && ranges[lo * 2] <= codePoint;
+    }
+
+    UINT32 SetCount() const { return static_cast<UINT32>(m_setOffsets.size() - 1); }
+    const std::vector<UINT32>& Ranges() const { return m_ranges; }
+    const std::vector<UINT32>& SetOffsets() const { return m_setOffsets; }
+    const std::unordered_map<std::wstring, UINT32>& Faces() const { return m_faces; }
+    bool empty() const { return m_faces.empty(); }
+
+    void Clear()
+    {
+        m_ranges.clear();
+        m_setOffsets.assign(1, 0);
+        m_setsByHash.clear();
+        m_faces.clear();
+    }
+
+private:
+    std::vector<UINT32> m_ranges;                   // first, last, first, last, ...
+    std::vector<UINT32> m_setOffsets = { 0 };       // Set i spans m_ranges[i] .. [i + 1]
+    std::unordered_multimap<UINT64, UINT32> m_setsByHash;
+    std::unordered_map<std::wstring, UINT32> m_faces;
+};
+
+/*
+ * CoverageRequest - A face location whose cmap should be read
+ */
+struct CoverageRequest {
+    std::wstring key;           // See MakeCoverageKey
+    std::wstring filePath;      // Empty for GDI faces: resolved through GDI interop
+    UINT32 faceIndex = 0;
+    std::wstring familyName;
+    int weight = FW_NORMAL;
+    bool italic = false;
+};
+
+/*
+ * CoverageBatch - Range sets read by the builder, posted to the UI thread
+ */
+struct CoverageBatch {
+    UINT generation = 0;
+    std::vector<std::pair<std::wstring, std::vector<UINT32>>> results;     // Key and ranges
+};
+
+/*
+ * CoverageJob - One background build over the faces not indexed yet
+ */
+struct CoverageJob {
+    UINT generation = 0;
+    std::atomic<bool> cancelled{ false };
+    std::vector<CoverageRequest> requests;
+};
+
+CoverageIndex g_coverage;                   // UI thread only
+UINT64 g_coverageFingerprint = 0;           // Font state g_coverage describes
+std::vector<UINT32> g_faceCoverage;         // Set ID per g_fonts index (see GetFaceCoverage)
+std::unordered_map<std::wstring, std::vector<UINT32>> g_faceCoveragePending;   // Key -> resolved indices still COVERAGE_NONE
+std::unique_ptr<CoverageJob> g_coverageJob;
+std::thread g_coverageThread;
+UINT g_coverageGeneration = 0;
+
+/*
+ * Builds the location key of face i for the coverage index
+ */
+std::wstring MakeCoverageKey(const FontStore& fonts, size_t i)
+{
+    std::wstring key;
+    if (!fonts.Path(i).empty()) {
+        key = fonts.Path(i);
+        key += L'\0';
+        key += std::to_wstring(fonts.FaceIndex(i));
+    } else {
+        key = L'\0';
+        key += fonts.Family(i);
+        key += L'\0';
+        key += std::to_wstring(fonts.Weight(i));
+        key += fonts.IsItalic(i) ? L"i" : L"";
+    }
+    return key;
+}
+
+/*
+ * Drops the resolved per-face set IDs (after reorders or renumbering)
+ */
+void ResetFaceCoverage()
+{
+    g_faceCoverage.clear();
+    g_faceCoveragePending.clear();
+}
+
+/*
+ * Returns the coverage set of g_fonts[fontIndex], or COVERAGE_NONE
+ *
+ * The per-face set IDs are resolved lazily: appended as faces stream
+ * in, and recomputed after reorders. Faces not indexed yet are
+ * remembered by key, so OnCoverageBatch updates just those faces.
+ */
+UINT32 GetFaceCoverage(size_t fontIndex)
+{
+    if (g_faceCoverage.size() > g_fonts.size()) {
+        ResetFaceCoverage();
+    }
+    while (g_faceCoverage.size() <= fontIndex) {
+        UINT32 index = static_cast<UINT32>(g_faceCoverage.size());
+        std::wstring key = MakeCoverageKey(g_fonts, index);
+        UINT32 set = g_coverage.Find(key);
+        if (set == COVERAGE_NONE) {
+            g_faceCoveragePending[std::move(key)].push_back(index);
+        }
+        g_faceCoverage.push_back(set);
+    }
+    return g_faceCoverage[fontIndex];
+}
+
+/*
+ * Reads the cmap of a face as sorted, merged (first, last) pairs
+ */
+void ReadFontCoverage(IDWriteFontFace* pFontFace, std::vector<UINT32>& ranges)
+{
+    ranges.clear();
+    IDWriteFontFace1* pFontFace1 = nullptr;
+    if (FAILED(pFontFace->QueryInterface(__uuidof(IDWriteFontFace1), (void**)&pFontFace1))) {
+        return;  // GetUnicodeRanges needs Windows 8
+    }
+
+    UINT32 count = 0;
+    pFontFace1->GetUnicodeRanges(0, nullptr, &count);  // E_NOT_SUFFICIENT_BUFFER, count set
+    std::vector<DWRITE_UNICODE_RANGE> unicodeRanges(count);
+    if (count > 0 && SUCCEEDED(pFontFace1->GetUnicodeRanges(count, unicodeRanges.data(), &count))) {
+        std::sort(unicodeRanges.begin(), unicodeRanges.begin() + count,
+            [](const DWRITE_UNICODE_RANGE& a, const DWRITE_UNICODE_RANGE& b) { return a.first < b.first; });
+        for (UINT32 r = 0; r < count; r++) {
+            const DWRITE_UNICODE_RANGE& range = unicodeRanges[r];
+            if (!ranges.empty() && range.first <= ranges.back() + 1) {
+                ranges.back() = (std::max)(ranges.back(), range.last);
+            } else {
+                ranges.push_back(range.first);
+                ranges.push_back(range.last);
+            }
+        }
+    }
+    pFontFace1->Release();
+}
+
+/*
+ * Creates the face for request and reads its coverage
+ */
+void ReadRequestCoverage(IDWriteFactory3* pDWriteFactory3, IDWriteGdiInterop* pGdiInterop,
+    const CoverageRequest& request, std::vector<UINT32>& ranges)
+{
+    ranges.clear();
+    IDWriteFontFace* pFontFace = nullptr;
+    if (!request.filePath.empty()) {
+        IDWriteFontFaceReference* pFontFaceRef = nullptr;
+        if (SUCCEEDED(pDWriteFactory3->CreateFontFaceReference(request.filePath.c_str(), NULL,
+                request.faceIndex, DWRITE_FONT_SIMULATIONS_NONE, &pFontFaceRef))) {
+            IDWriteFontFace3* pFontFace3 = nullptr;
+            if (SUCCEEDED(pFontFaceRef->CreateFontFace(&pFontFace3))) {
+                pFontFace = pFontFace3;
+            }
+            pFontFaceRef->Release();
+        }
+    } else if (pGdiInterop) {
+        // The face GDI would select for this family, weight and slant
+        LOGFONTW lf = {};
+        wcsncpy_s(lf.lfFaceName, request.familyName.c_str(), _TRUNCATE);
+        lf.lfWeight = request.weight;
+        lf.lfItalic = request.italic ? TRUE : FALSE;
+        lf.lfCharSet = DEFAULT_CHARSET;
+        IDWriteFont* pFont = nullptr;
+        if (SUCCEEDED(pGdiInterop->CreateFontFromLOGFONT(&lf, &pFont))) {
+            pFont->CreateFontFace(&pFontFace);
+            pFont->Release();
+        }
+    }
+    if (pFontFace) {
+        g_fontFacesCreated++;
+        ReadFontCoverage(pFontFace, ranges);
+        pFontFace->Release();
+    }
+}
+
+/*
+ * Coverage builder - reads the cmaps of the job's faces in parallel
+ *
+ * Runs below normal priority on every thread, since it only serves
+ * covers: queries. Each chunk of COVERAGE_CHUNK_SIZE faces is posted as
+ * one WM_APP_COVERAGE_BATCH; WM_APP_COVERAGE_DONE follows the last.
+ */
+void CoverageThreadProc(CoverageJob* job)
+{
+    IDWriteFactory3* pDWriteFactory3 = nullptr;
+    IDWriteGdiInterop* pGdiInterop = nullptr;
+    if (SUCCEEDED(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory3),
+            reinterpret_cast<IUnknown**>(&pDWriteFactory3)))) {
+        pDWriteFactory3->GetGdiInterop(&pGdiInterop);
+
+        UINT32 count = static_cast<UINT32>(job->requests.size());
+        unsigned threadCount = GetEnumThreadCount(count, COVERAGE_CHUNK_SIZE);
+        ParallelForChunks(count, COVERAGE_CHUNK_SIZE, threadCount, [&](UINT32 begin, UINT32 end, unsigned) {
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+            auto batch = std::make_unique<CoverageBatch>();
+            batch->generation = job->generation;
+            std::vector<UINT32> ranges;
+            for (UINT32 i = begin; i < end; i++) {
+                if (job->cancelled) return;
+                ReadRequestCoverage(pDWriteFactory3, pGdiInterop, job->requests[i], ranges);
+                batch->results.emplace_back(job->requests[i].key, ranges);
+            }
+            if (PostMessageW(g_hWnd, WM_APP_COVERAGE_BATCH, job->generation,
+                    reinterpret_cast<LPARAM>(batch.get()))) {
+                batch.release();  // Owned by the UI thread now
+            }
+        });
+    }
+    if (pGdiInterop) pGdiInterop->Release();
+    if (pDWriteFactory3) pDWriteFactory3->Release();
+
+    PostMessageW(g_hWnd, WM_APP_COVERAGE_DONE, job->generation, 0);
+}
+
+/*
+ * Writes g_coverage to the coverage snapshot
+ *
+ * The file is laid out here and written by the data file writer.
+ */
+bool SaveCoverage()
+{
+    std::wstring path = GetDataFilePath(L"Coverage.snapshot");
+    if (path.empty()) return false;
+
+    std::vector<CoverageEntry> entries;
+    std::vector<wchar_t> keys;
+    entries.reserve(g_coverage.Faces().size());
+    for (const auto& face : g_coverage.Faces()) {
+        entries.push_back({ static_cast<UINT32>(keys.size()), static_cast<UINT32>(face.first.size()), face.second });
+        keys.insert(keys.end(), face.first.begin(), face.first.end());
+    }
+
+    CoverageHeader header = {};
+    header.magic = COVERAGE_MAGIC;
+    header.version = COVERAGE_VERSION;
+    header.fingerprint = g_coverageFingerprint;
+    header.entryCount = static_cast<UINT32>(entries.size());
+    header.setCount = g_coverage.SetCount();
+    header.rangeCount = static_cast<UINT32>(g_coverage.Ranges().size() / 2);
+    header.keysSize = static_cast<UINT32>(keys.size());
+
+    const std::vector<UINT32>& setOffsets = g_coverage.SetOffsets();
+    const std::vector<UINT32>& ranges = g_coverage.Ranges();
+    std::vector<BYTE> contents;
+    contents.reserve(sizeof(header) + entries.size() * sizeof(CoverageEntry) +
+        (setOffsets.size() + ranges.size()) * sizeof(UINT32) + keys.size() * sizeof(wchar_t));
+    AppendBytes(contents, &header, sizeof(header));
+    AppendBytes(contents, entries.data(), entries.size() * sizeof(CoverageEntry));
+    AppendBytes(contents, setOffsets.data(), setOffsets.size() * sizeof(UINT32));
+    AppendBytes(contents, ranges.data(), ranges.size() * sizeof(UINT32));
+    AppendBytes(contents, keys.data(), keys.size() * sizeof(wchar_t));
+    QueueDataFile(path, std::move(contents));
+    return true;
+}
+
+/*
+ * Loads the coverage snapshot into g_coverage if it was built under
+ * fingerprint; every offset is bounds-checked
+ */
+bool LoadCoverage(UINT64 fingerprint)
+{
+    std::wstring path = GetDataFilePath(L"Coverage.snapshot");
+    MappedFile file;
+    if (path.empty() || !file.Open(path.c_str()) || file.Size() < sizeof(CoverageHeader)) {
+        return false;
+    }
+
+    const CoverageHeader* header = reinterpret_cast<const CoverageHeader*>(file.Data());
+    if (header->magic != COVERAGE_MAGIC || header->version != COVERAGE_VERSION ||
+        header->fingerprint != fingerprint) {
+        return false;
+    }
+
+    UINT64 entriesOffset = sizeof(CoverageHeader);
+    UINT64 setsOffset = entriesOffset + UINT64(header->entryCount) * sizeof(CoverageEntry);
+    UINT64 rangesOffset = setsOffset + (UINT64(header->setCount) + 1) * sizeof(UINT32);
+    UINT64 keysOffset = rangesOffset + UINT64(header->rangeCount) * 2 * sizeof(UINT32);
+    if (keysOffset + UINT64(header->keysSize) * sizeof(wchar_t) > file.Size()) {
+        return false;
+    }
+
+    const CoverageEntry* entries = reinterpret_cast<const CoverageEntry*>(file.Data() + entriesOffset);
+    const UINT32* setOffsets = reinterpret_cast<const UINT32*>(file.Data() + setsOffset);
+    const UINT32* ranges = reinterpret_cast<const UINT32*>(file.Data() + rangesOffset);
+    const wchar_t* keys = reinterpret_cast<const wchar_t*>(file.Data() + keysOffset);
+    if (setOffsets[0] != 0 || setOffsets[header->setCount] != header->rangeCount * 2) {
+        return false;
+    }
+
+    g_coverage.Clear();
+    std::vector<UINT32> setIds(header->setCount);
+    std::vector<UINT32> set;
+    for (UINT32 i = 0; i < header->setCount; i++) {
+        if (setOffsets[i] > setOffsets[i + 1] || (setOffsets[i + 1] - setOffsets[i]) % 2 != 0) {
+            g_coverage.Clear();
+            return false;
+        }
+        set.assign(ranges + setOffsets[i], ranges + setOffsets[i + 1]);
+        setIds[i] = g_coverage.AddSet(set);
+    }
+    for (UINT32 i = 0; i < header->entryCount; i++) {
+        const CoverageEntry& entry = entries[i];
+        if (entry.set >= header->setCount || UINT64(entry.keyOffset) + entry.keyLength > header->keysSize) {
+            g_coverage.Clear();
+            return false;
+        }
+        g_coverage.SetFace(std::wstring(keys + entry.keyOffset, entry.keyLength), setIds[entry.set]);
+    }
+    return true;
+}
+
+/*
+ * Stops the running coverage build, if any, and waits for it to exit
+ */
+void CancelCoverageBuild()
+{
+    if (g_coverageJob) {
+        g_coverageJob->cancelled = true;
+    }
+    if (g_coverageThread.joinable()) {
+        g_coverageThread.join();
+    }
+    g_coverageJob.reset();
+}
+
+/*
+ * Starts indexing the faces of g_fonts that have no coverage yet
+ *
+ * Called once g_fonts is complete. After a font change (a different
+ * fingerprint) the index starts over, from the coverage snapshot if one
+ * matches the new state.
+ */
+void StartCoverageBuild()
+{
+    CancelCoverageBuild();
+
+    if (g_coverageFingerprint != g_fontsFingerprint || g_coverage.empty()) {
+        g_coverage.Clear();
+        g_coverageFingerprint = g_fontsFingerprint;
+        LoadCoverage(g_fontsFingerprint);
+        ResetFaceCoverage();
+        ResetQueryMemos();          // Set IDs were renumbered
+    }
+
+    auto job = std::make_unique<CoverageJob>();
+    std::unordered_set<std::wstring> queued;
+    for (size_t i = 0; i < g_fonts.size(); i++) {
+        std::wstring key = MakeCoverageKey(g_fonts, i);
+        if (g_coverage.Find(key) != COVERAGE_NONE || !queued.insert(key).second) continue;
+
+        CoverageRequest request;
+        request.key = std::move(key);
+        request.filePath = g_fonts.Path(i);
+        request.faceIndex = g_fonts.FaceIndex(i);
+        request.familyName = g_fonts.Family(i);
+        request.weight = g_fonts.Weight(i);
+        request.italic = g_fonts.IsItalic(i);
+        job->requests.push_back(std::move(request));
+    }
+    if (job->requests.empty()) return;
+
+    job->generation = ++g_coverageGeneration;
+    g_coverageJob = std::move(job);
+    g_coverageThread = std::thread(CoverageThreadProc, g_coverageJob.get());
+}
+
+// ============================================================================
+// DUPLICATE FILES - Identical font files under different paths, for dup: queries
+// ============================================================================
+
+/*
+ * After each enumeration a background pass looks for font files with
+ * identical contents (per-user installs of a system font, copies bundled
+ * with applications, ...). Every distinct file is stat'ed; only files
+ * whose size matches another's are memory-mapped and hashed
+ * (HashContents), in parallel and below normal priority. Files with the
+ * same size and hash form a duplicate group, shown in the Duplicates
+ * column and matched by dup:yes. Groups are stored per g_fonts path ID,
+ * so a face's group is one array read, whatever the list order.
+ *
+ * Hashes are cached by path, size and last-write time, so later passes
+ * only read new or changed files. The cache is shared by all modes and
+ * saved to %LOCALAPPDATA%\FontEnum\FileHashes.snapshot:
+ *
+ *   FileHashHeader
+ *   FileHashRecord records[recordCount]
+ *   wchar_t paths[pathsSize]              folded paths
+ */
+#define FILE_HASH_MAGIC     0x48464546  // "FEFH"
+#define FILE_HASH_VERSION   1
+#define DUPLICATE_STAT_CHUNK_SIZE   64  // Files stat'ed per work item
+
+struct FileHashHeader {
+    UINT32 magic;           // FILE_HASH_MAGIC
+    UINT32 version;         // FILE_HASH_VERSION
+    UINT32 recordCount;
+    UINT32 pathsSize;       // wchar_t units
+};
+
+struct FileHashRecord {
+    UINT32 pathOffset;      // Into paths (wchar_t units)
+    UINT32 pathLength;
+    UINT64 size;
+    UINT64 lastWriteTime;   // FILETIME as one number
+    UINT64 hash;
+};
+
+/*
+ * FileHashEntry - What is known about one font file
+ */
+struct FileHashEntry {
+    UINT64 size = 0;            // 0 if the file couldn't be found
+    UINT64 lastWriteTime = 0;
+    UINT64 hash = 0;
+    bool hashed = false;        // hash describes this size and time
+};
+
+/*
+ * DuplicateJob - One pass over the distinct files of g_fonts
+ *
+ * entries[i] holds the cached state of paths[i] on input; the worker
+ * updates it in place. The UI thread reads the results after joining.
+ */
+struct DuplicateJob {
+    UINT generation = 0;
+    std::atomic<bool> cancelled{ false };
+    std::vector<std::wstring> paths;
+    std::vector<std::wstring> keys;         // Folded paths
+    std::vector<FileHashEntry> entries;
+    std::vector<UINT32> pathEntries;        // Entry per g_fonts path ID, UINT32_MAX = none (UI thread)
+    UINT32 filesHashed = 0;                 // Read during this pass (worker)
+};
+
+std::unordered_map<std::wstring, FileHashEntry> g_fileHashes;  // Folded path -> cached hash (UI thread)
+bool g_fileHashesLoaded = false;
+std::vector<UINT32> g_duplicateGroups;      // Group number (1-based) per g_fonts path ID, 0 = none
+std::vector<UINT32> g_duplicateGroupSizes;  // Files per group number
+std::unique_ptr<DuplicateJob> g_duplicateJob;
+std::thread g_duplicateThread;
+UINT g_duplicateGeneration = 0;
+
+/*
+ * Returns the duplicate group of g_fonts[fontIndex], or 0 if its file
+ * has no known duplicate
+ *
+ * Paths interned after the last pass (a rescan adding fonts) have no
+ * group until the next pass finishes.
+ */
+UINT32 GetFontDuplicateGroup(size_t fontIndex)
+{
+    UINT32 pathId = g_fonts.PathId(fontIndex);
+    return pathId < g_duplicateGroups.size() ? g_duplicateGroups[pathId] : 0;
+}
+
+/*
+ * Hashes a mapped file, turning a failed page-in (e.g. a share that
+ * went away) into a false return
+ */
+bool HashMappedFile(const BYTE* data, size_t size, UINT64& hash)
+{
+    __try {
+        hash = HashContents(data, size);
+        return true;
+    } __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+        return false;
+    }
+}
+
+/*
+ * Duplicate finder - stats every file, then hashes the files that share
+ * their size with another and have no valid cached hash
+ *
+ * Both phases run on all cores below normal priority. Posts
+ * WM_APP_DUPLICATES_DONE when finished (or cancelled).
+ */
+void DuplicateThreadProc(DuplicateJob* job)
+{
+    UINT32 count = static_cast<UINT32>(job->paths.size());
+    ParallelForChunks(count, DUPLICATE_STAT_CHUNK_SIZE, GetEnumThreadCount(count, DUPLICATE_STAT_CHUNK_SIZE),
+        [&](UINT32 begin, UINT32 end, unsigned) {
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+            for (UINT32 i = begin; i < end && !job->cancelled; i++) {
+                FileHashEntry& entry = job->entries[i];
+                WIN32_FILE_ATTRIBUTE_DATA data;
+                UINT64 size = 0, time = 0;
+                if (GetFileAttributesExW(job->paths[i].c_str(), GetFileExInfoStandard, &data)) {
+                    size = (UINT64(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+                    time = (UINT64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+                }
+                if (size != entry.size || time != entry.lastWriteTime) {
+                    entry.size = size;
+                    entry.lastWriteTime = time;
+                    entry.hashed = false;
+                }
+            }
+        });
+
+    // Only files whose size occurs more than once can have a duplicate
+    std::vector<UINT32> bySize;
+    for (UINT32 i = 0; i < count; i++) {
+        if (job->entries[i].size > 0) bySize.push_back(i);
+    }
+    std::sort(bySize.begin(), bySize.end(), [job](UINT32 a, UINT32 b) {
+        return job->entries[a].size < job->entries[b].size;
+    });
+    std::vector<UINT32> toHash;
+    for (size_t g = 0; g < bySize.size();) {
+        size_t end = g + 1;
+        while (end < bySize.size() && job->entries[bySize[end]].size == job->entries[bySize[g]].size) end++;
+        for (size_t i = g; end - g > 1 && i < end; i++) {
+            if (!job->entries[bySize[i]].hashed) toHash.push_back(bySize[i]);
+        }
+        g = end;
+    }
+
+    std::atomic<UINT32> hashed{ 0 };
+    UINT32 hashCount = static_cast<UINT32>(toHash.size());
+    ParallelForChunks(hashCount, 1, GetEnumThreadCount(hashCount, 1), [&](UINT32 begin, UINT32 end, unsigned) {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+        for (UINT32 i = begin; i < end && !job->cancelled; i++) {
+            FileHashEntry& entry = job->entries[toHash[i]];
+            MappedFile file;
+            if (file.Open(job->paths[toHash[i]].c_str()) && file.Size() == entry.size &&
+                HashMappedFile(file.Data(), file.Size(), entry.hash)) {
+                entry.hashed = true;
+                hashed++;
+            }
+        }
+    });
+    job->filesHashed = hashed;
+
+    PostMessageW(g_hWnd, WM_APP_DUPLICATES_DONE, job->generation, 0);
+}
+
+/*
+ * Writes the hashed entries of g_fileHashes to the file hash snapshot
+ *
+ * The file is laid out here and written by the data file writer.
+ */
+bool SaveFileHashes()
+{
+    std::wstring path = GetDataFilePath(L"FileHashes.snapshot");
+    if (path.empty()) return false;
+
+    std::vector<FileHashRecord> records;
+    std::vector<wchar_t> paths;
+    for (const auto& file : g_fileHashes) {
+        if (!file.second.hashed) continue;
+        FileHashRecord record = {};
+        record.pathOffset = static_cast<UINT32>(paths.size());
+        record.pathLength = static_cast<UINT32>(file.first.size());
+        record.size = file.second.size;
+        record.lastWriteTime = file.second.lastWriteTime;
+        record.hash = file.second.hash;
+        records.push_back(record);
+        paths.insert(paths.end(), file.first.begin(), file.first.end());
+    }
+
+    FileHashHeader header = {};
+    header.magic = FILE_HASH_MAGIC;
+    header.version = FILE_HASH_VERSION;
+    header.recordCount = static_cast<UINT32>(records.size());
+    header.pathsSize = static_cast<UINT32>(paths.size());
+
+    std::vector<BYTE> contents;
+    contents.reserve(sizeof(header) + records.size() * sizeof(FileHashRecord) + paths.size() * sizeof(wchar_t));
+    AppendBytes(contents, &header, sizeof(header));
+    AppendBytes(contents, records.data(), records.size() * sizeof(FileHashRecord));
+    AppendBytes(contents, paths.data(), paths.size() * sizeof(wchar_t));
+    QueueDataFile(path, std::move(contents));
+    return true;
+}
+
+/*
+ * Loads the file hash snapshot into g_fileHashes; every offset is
+ * bounds-checked
+ */
+bool LoadFileHashes()
+{
+    std::wstring path = GetDataFilePath(L"FileHashes.snapshot");
+    MappedFile file;
+    if (path.empty() || !file.Open(path.c_str()) || file.Size() < sizeof(FileHashHeader)) {
+        return false;
+    }
+
+    const FileHashHeader* header = reinterpret_cast<const FileHashHeader*>(file.Data());
+    if (header->magic != FILE_HASH_MAGIC || header->version != FILE_HASH_VERSION) {
+        return false;
+    }
+    UINT64 pathsOffset = sizeof(FileHashHeader) + UINT64(header->recordCount) * sizeof(FileHashRecord);
+    if (pathsOffset + UINT64(header->pathsSize) * sizeof(wchar_t) > file.Size()) {
+        return false;
+    }
+
+    const FileHashRecord* records = reinterpret_cast<const FileHashRecord*>(file.Data() + sizeof(FileHashHeader));
+    const wchar_t* paths = reinterpret_cast<const wchar_t*>(file.Data() + pathsOffset);
+    for (UINT32 i = 0; i < header->recordCount; i++) {
+        const FileHashRecord& record = records[i];
+        if (UINT64(record.pathOffset) + record.pathLength > header->pathsSize) {
+            g_fileHashes.clear();
+            return false;
+        }
+        FileHashEntry& entry = g_fileHashes[std::wstring(paths + record.pathOffset, record.pathLength)];
+        entry.size = record.size;
+        entry.lastWriteTime = record.lastWriteTime;
+        entry.hash = record.hash;
+        entry.hashed = true;
+    }
+    return true;
+}
+
+/*
+ * Stops the running duplicate pass, if any, and waits for it to exit
+ */
+void CancelDuplicateScan()
+{
+    if (g_duplicateJob) {
+        g_duplicateJob->cancelled = true;
+    }
+    if (g_duplicateThread.joinable()) {
+        g_duplicateThread.join();
+    }
+    g_duplicateJob.reset();
+}
+
+/*
+ * Starts looking for duplicates among the files of g_fonts
+ *
+ * Called once g_fonts is complete. The groups of the previous pass stay
+ * in place until this one finishes (ClearFonts drops them, as their path
+ * IDs are about to be reused).
+ */
+void StartDuplicateScan()
+{
+    CancelDuplicateScan();
+    if (!g_fileHashesLoaded) {
+        LoadFileHashes();
+        g_fileHashesLoaded = true;
+    }
+
+    // Paths differing only in case share an entry
+    auto job = std::make_unique<DuplicateJob>();
+    job->pathEntries.assign(g_fonts.Pool().Count(), UINT32_MAX);
+    std::unordered_map<std::wstring, UINT32> queued;    // Folded path -> entry
+    for (size_t i = 0; i < g_fonts.size(); i++) {
+        UINT32 pathId = g_fonts.PathId(i);
+        if (job->pathEntries[pathId] != UINT32_MAX || g_fonts.Path(i).empty()) continue;
+
+        std::wstring key = FoldCase(std::wstring(g_fonts.Path(i)));
+        auto inserted = queued.emplace(key, static_cast<UINT32>(job->paths.size()));
+        job->pathEntries[pathId] = inserted.first->second;
+        if (!inserted.second) continue;
+        auto cached = g_fileHashes.find(key);
+        job->entries.push_back(cached != g_fileHashes.end() ? cached->second : FileHashEntry());
+        job->paths.emplace_back(g_fonts.Path(i));
+        job->keys.push_back(std::move(key));
+    }
+    if (job->paths.empty()) {
+        g_duplicateGroups.clear();
+        g_duplicateGroupSizes.clear();
+        return;
+    }
+
+    job->generation = ++g_duplicateGeneration;
+    g_duplicateJob = std::move(job);
+    g_duplicateThread = std::thread(DuplicateThreadProc, g_duplicateJob.get());
+}
+
+// ============================================================================
+// FAMILY GROUPS - Families mode: group rows, loading faces in the background
+// ============================================================================
+
+/*
+ * The Families mode lists one group row per DirectWrite family (see
+ * EnumerateDirectWriteFamilies). Faces are loaded a family at a time by
+ * the face loader: expanded groups first, then every other family in
+ * list order below normal priority. Loaded faces are appended to g_fonts
+ * like any other record, so filtering, sorting and the background
+ * indexes see them; ApplyFamilyGrouping then arranges the rows as each
+ * group followed by its faces when expanded.
+ */
+#define FAMILY_FACE_BATCH_SIZE  256     // Faces per WM_APP_FAMILY_FACES
+
+/*
+ * FamilyGroup - UI state of one family (keyed by family string ID)
+ */
+struct FamilyGroup {
+    UINT32 faceCount = 0;
+    bool loaded = false;        // Its faces are in g_fonts
+    bool expanded = false;
+};
+
+/*
+ * FamilyFacesBatch - Faces loaded by the face loader
+ *
+ * Posted via WM_APP_FAMILY_FACES; the UI thread takes ownership. Like
+ * FontBatch, the fonts' strings live in the batch's arena.
+ */
+struct FamilyFacesBatch {
+    std::pmr::monotonic_buffer_resource arena{ FONT_BATCH_ARENA_BYTES };
+    UINT generation = 0;
+    std::vector<std::wstring> families;     // Families completed by this batch
+    std::vector<FontInfo> fonts;
+};
+
+/*
+ * FamilyFaceJob - One face loading pass over the families of g_fonts
+ *
+ * The queues are shared with the UI thread under mutex; done is the
+ * worker's own.
+ */
+struct FamilyFaceJob {
+    UINT generation = 0;
+    std::atomic<bool> cancelled{ false };
+    std::mutex mutex;
+    std::deque<std::wstring> expanded;      // Requested by expanding a group, served first
+    std::deque<std::wstring> sweep;         // Every family, in list order
+    std::unordered_set<std::wstring> done;
+};
+
+std::unordered_map<UINT32, FamilyGroup> g_familyGroups;    // Group state per family string ID (UI thread)
+size_t g_familyGroupsLoaded = 0;
+std::unique_ptr<FamilyFaceJob> g_familyFaceJob;
+std::thread g_familyFaceThread;
+UINT g_familyFaceGeneration = 0;
+
+/*
+ * Face loader - reads the faces of each queued family
+ *
+ * Families are looked up by name in the session's system collection,
+ * which the group rows were read from. Batches are posted every
+ * FAMILY_FACE_BATCH_SIZE faces, and right away after an expanded family.
+ * Posts WM_APP_FAMILY_FACES_DONE when finished (or cancelled).
+ */
+void FamilyFaceThreadProc(FamilyFaceJob* job)
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+    IDWriteFactory* pDWriteFactory = nullptr;
+    IDWriteFontCollection* pFontCollection = nullptr;
+    if (SUCCEEDED(GetSessionFontCollection(FALSE, &pDWriteFactory, &pFontCollection))) {
+        std::unique_ptr<FamilyFacesBatch> batch;
+        auto post = [&]() {
+            if (batch && PostMessageW(g_hWnd, WM_APP_FAMILY_FACES, job->generation,
+                    reinterpret_cast<LPARAM>(batch.get()))) {
+                batch.release();    // Owned by the UI thread now
+            }
+            batch.reset();
+        };
+
+        StageClock clock;
+        while (!job->cancelled) {
+            std::wstring name;
+            bool expanded = false;
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                std::deque<std::wstring>& queue = !job->expanded.empty() ? job->expanded : job->sweep;
+                if (queue.empty()) break;
+                expanded = &queue == &job->expanded;
+                name = std::move(queue.front());
+                queue.pop_front();
+            }
+            if (!job->done.insert(name).second) continue;
+
+            if (!batch) {
+                batch = std::make_unique<FamilyFacesBatch>();
+                batch->generation = job->generation;
+            }
+            UINT32 index = 0;
+            BOOL exists = FALSE;
+            IDWriteFontFamily* pFontFamily = nullptr;
+            if (SUCCEEDED(pFontCollection->FindFamilyName(name.c_str(), &index, &exists)) && exists &&
+                SUCCEEDED(pFontCollection->GetFontFamily(index, &pFontFamily))) {
+                UINT32 fontCount = pFontFamily->GetFontCount();
+                for (UINT32 j = 0; j < fontCount && !job->cancelled; j++) {
+                    IDWriteFont* pFont = nullptr;
+                    if (FAILED(pFontFamily->GetFont(j, &pFont))) continue;
+                    FontInfo info(&batch->arena);
+                    ReadDirectWriteFace(pFont, name, info, clock);
+                    batch->fonts.push_back(std::move(info));
+                    pFont->Release();
                 }
-                pLoader->Release();
+                pFontFamily->Release();
+            }
+            batch->families.push_back(std::move(name));     // Also if it vanished
+
+            if (expanded || batch->fonts.size() >= FAMILY_FACE_BATCH_SIZE) {
+                post();
+            }
+        }
+        post();
+    }
+    if (pFontCollection) pFontCollection->Release();
+    if (pDWriteFactory) pDWriteFactory->Release();
+
+    PostMessageW(g_hWnd, WM_APP_FAMILY_FACES_DONE, job->generation, 0);
+}
+
+/*
+ * Stops the running face loader, if any, and waits for it to exit
+ */
+void CancelFamilyFaceLoad()
+{
+    if (g_familyFaceJob) {
+        g_familyFaceJob->cancelled = true;
+    }
+    if (g_familyFaceThread.joinable()) {
+        g_familyFaceThread.join();
+    }
+    g_familyFaceJob.reset();
+}
+
+/*
+ * Starts loading the faces of every group row in g_fonts
+ *
+ * Called once the Families enumeration is complete and sorted.
+ */
+void StartFamilyFaceLoad()
+{
+    CancelFamilyFaceLoad();
+
+    auto job = std::make_unique<FamilyFaceJob>();
+    for (size_t i = 0; i < g_fonts.size(); i++) {
+        auto it = g_familyGroups.find(g_fonts.FamilyId(i));
+        if (!g_fonts.IsGroup(i) || it == g_familyGroups.end() || it->second.loaded) continue;
+        if (it->second.expanded) {
+            job->expanded.emplace_back(g_fonts.Family(i));
+        } else {
+            job->sweep.emplace_back(g_fonts.Family(i));
+        }
+    }
+    if (job->expanded.empty() && job->sweep.empty()) return;
+
+    job->generation = ++g_familyFaceGeneration;
+    g_familyFaceJob = std::move(job);
+    g_familyFaceThread = std::thread(FamilyFaceThreadProc, g_familyFaceJob.get());
+}
+
+/*
+ * Moves family to the front of the face loader's queue
+ */
+void RequestFamilyFaces(std::wstring_view family)
+{
+    if (!g_familyFaceJob) return;
+    {
+        std::lock_guard<std::mutex> lock(g_familyFaceJob->mutex);
+        g_familyFaceJob->expanded.emplace_back(family);
+    }
+}
+
+/*
+ * Arranges g_filteredIndices as group rows, each followed by its faces
+ * if expanded (Families mode only)
+ *
+ * Takes the matched rows in sort order. A family is placed where its
+ * group row sorts, whether its faces are loaded or not, so expanding a
+ * group or the background sweep never moves it. Once its faces are
+ * loaded it is shown only if one of them matches, otherwise when its
+ * group row does.
+ */
+void ApplyFamilyGrouping()
+{
+    if (g_currentMode != EnumMode::Families) return;
+
+    std::unordered_map<UINT32, std::vector<size_t>> faces;     // Matching faces per family, in list order
+    std::vector<bool> matches(g_fonts.size(), false);           // Matching group rows
+    for (size_t font : g_filteredIndices) {
+        if (g_fonts.IsGroup(font)) {
+            matches[font] = true;
+        } else {
+            faces[g_fonts.FamilyId(font)].push_back(font);
+        }
+    }
+
+    // Group rows in the active order; faces are appended after them, so
+    // with the default order group rows keep their sorted positions
+    std::vector<size_t> groupRows;
+    auto addGroupRow = [&](size_t font) {
+        if (g_fonts.IsGroup(font)) groupRows.push_back(font);
+    };
+    if (g_sortColumn < 0) {
+        for (size_t i = 0; i < g_fonts.size(); i++) addGroupRow(i);
+    } else {
+        const std::vector<UINT32>& order = GetSortOrder(g_sortColumn);
+        if (g_sortDescending) {
+            for (auto it = order.rbegin(); it != order.rend(); ++it) addGroupRow(*it);
+        } else {
+            for (UINT32 font : order) addGroupRow(font);
+        }
+    }
+
+    g_filteredIndices.clear();
+    for (size_t row : groupRows) {
+        UINT32 family = g_fonts.FamilyId(row);
+        auto group = g_familyGroups.find(family);
+        if (group == g_familyGroups.end()) continue;
+        auto members = faces.find(family);
+        bool shown = group->second.loaded ? members != faces.end() : matches[row];
+        if (!shown) continue;
+
+        g_filteredIndices.push_back(row);
+        if (group->second.expanded && members != faces.end()) {
+            g_filteredIndices.insert(g_filteredIndices.end(), members->second.begin(), members->second.end());
+        }
+    }
+}
+
+// ============================================================================
+// FILTER QUERIES - The filter box, compiled to a predicate chain
+// ============================================================================
+//
+//   arial bold              Family or style contains each word
+//   "segoe ui"              ... or the quoted phrase
+//   family:seg style:light  Family / style contains (values may be quoted)
+//   path:C:\Windows\Fonts   File path contains
+//   weight>=600             Weight compared with =, <, <=, > or >= (weight:700 means =)
+//   italic:yes mono:no      Italic / fixed-pitch flag (yes or no)
+//   var:yes var:wght        Variable font / axes contain the text
+//   gdi:yes dwrite:no       Reported by an API (All APIs mode; also fontset:)
+//   covers:U+20AC,U+1F600   Maps every listed code point (covers:text - its characters)
+//   dup:yes                 File has an identical copy elsewhere (see DUPLICATE FILES)
+//
+// Terms are ANDed and case-insensitive (covers: values are not folded). A term still being typed (e.g.
+// "weight>=") is ignored until it is complete; unknown fields are
+// searched as plain text, so "C:" alone still finds names.
+
+#define QUERY_SAMPLE_SIZE   256     // Faces sampled to estimate a term's selectivity
+
+enum class QueryField {
+    Name,       // Search index entry (family or style)
+    Family,
+    Style,
+    Path,
+    Axes,
+    Weight,
+    Flag,       // FONT_FLAG_* bit
+    Source,     // FONT_SOURCE_* bit
+    Coverage,   // Code points in the face's cmap (see COVERAGE INDEX)
+    Duplicate   // File has an identical copy (see DUPLICATE FILES)
+};
+
+enum class QueryOp { Contains, Equal, Less, LessEqual, Greater, GreaterEqual };
+
+/*
+ * QueryTerm - One compiled test of the filter
+ *
+ * Weight, flag and source tests read the packed FontStore columns.
+ * Family, style, path and axes tests are answered once per interned
+ * string and memoized by string ID, so a path shared by every face of
+ * a collection is folded and searched once. Name terms search the
+ * folded index entry like the plain filter always did. Coverage tests
+ * are memoized by coverage set ID the same way.
+ */
+struct QueryTerm {
+    QueryField field = QueryField::Name;
+    QueryOp op = QueryOp::Contains;
+    std::wstring text;              // Folded needle (Contains)
+    int number = 0;                 // Weight operand
+    BYTE bit = 0;                   // FONT_FLAG_* or FONT_SOURCE_*
+    std::vector<UINT32> codePoints; // Sorted, unique (Coverage)
+    bool wanted = true;             // Flag value that matches
+    double rank = 0;                // Evaluation order, lowest first (see CompileQuery)
+    std::vector<signed char> memo;  // Per string or set ID: -1 unknown, else the result
+};
+
+/*
+ * FilterQuery - A parsed filter: terms in evaluation order
+ */
+struct FilterQuery {
+    std::vector<QueryTerm> terms;
+    bool usesDetails = false;       // Tests fixed pitch or axes (deferred in FontSet mode)
+    bool usesCoverage = false;      // Tests the coverage index (built in the background)
+    bool usesDuplicates = false;    // Tests the duplicate groups (found in the background)
+};
+
+FilterQuery g_query;                // Compiled from g_filterText
+FilterQuery g_appliedQuery;         // Terms g_filteredIndices currently reflects (no memos)
+std::vector<wchar_t> g_queryFolded; // Scratch buffer for memoized string tests
+
+/*
+ * Returns true if term's text occurs in the (folded) pool string id
+ */
+bool TestQueryString(QueryTerm& term, UINT32 id)
+{
+    if (id >= term.memo.size()) {
+        term.memo.resize(g_fonts.Pool().Count(), -1);
+    }
+    if (term.memo[id] < 0) {
+        std::wstring_view str = g_fonts.Pool().View(id);
+        g_queryFolded.clear();
+        FoldCaseAppend(str.data(), str.size(), g_queryFolded);
+        term.memo[id] = FindSubstring(g_queryFolded.data(), g_queryFolded.size(), 0,
+            term.text) != std::wstring_view::npos ? 1 : 0;
+    }
+    return term.memo[id] != 0;
+}
+
+/*
+ * Returns true if g_fonts[fontIndex] passes term
+ *
+ * Faces whose details are still pending fail fixed-pitch, variable and
+ * axes tests; the filter is re-run once the details sweep finishes.
+ */
+bool TestQueryTerm(QueryTerm& term, size_t fontIndex)
+{
+    switch (term.field) {
+    case QueryField::Name: {
+        UINT32 begin = g_searchIndex.offsets[fontIndex];
+        UINT32 end = g_searchIndex.offsets[fontIndex + 1];
+        return FindSubstring(g_searchIndex.text.data() + begin, end - begin, 0,
+            term.text) != std::wstring_view::npos;
+    }
+    case QueryField::Family: return TestQueryString(term, g_fonts.FamilyId(fontIndex));
+    case QueryField::Style: return TestQueryString(term, g_fonts.StyleId(fontIndex));
+    case QueryField::Path: return TestQueryString(term, g_fonts.PathId(fontIndex));
+    case QueryField::Axes:
+        return !g_fonts.DetailsPending(fontIndex) && TestQueryString(term, g_fonts.AxesId(fontIndex));
+    case QueryField::Weight: {
+        int weight = g_fonts.Weight(fontIndex);
+        switch (term.op) {
+        case QueryOp::Less: return weight < term.number;
+        case QueryOp::LessEqual: return weight <= term.number;
+        case QueryOp::Greater: return weight > term.number;
+        case QueryOp::GreaterEqual: return weight >= term.number;
+        default: return weight == term.number;
+        }
+    }
+    case QueryField::Flag: {
+        BYTE flags = g_fonts.Flags(fontIndex);
+        if ((flags & FONT_FLAG_PENDING) && term.bit != FONT_FLAG_ITALIC) return false;
+        return ((flags & term.bit) != 0) == term.wanted;
+    }
+    case QueryField::Source:
+        return ((g_fonts.Sources(fontIndex) & term.bit) != 0) == term.wanted;
+    case QueryField::Coverage: {
+        UINT32 set = GetFaceCoverage(fontIndex);
+        if (set == COVERAGE_NONE) return false;     // Not indexed yet
+        if (set >= term.memo.size()) {
+            term.memo.resize(g_coverage.SetCount(), -1);
+        }
+        if (term.memo[set] < 0) {
+            term.memo[set] = std::all_of(term.codePoints.begin(), term.codePoints.end(),
+                [set](UINT32 cp) { return g_coverage.Covers(set, cp); }) ? 1 : 0;
+        }
+        return term.memo[set] != 0;
+    }
+    case QueryField::Duplicate:
+        return (GetFontDuplicateGroup(fontIndex) != 0) == term.wanted;
+    }
+    return true;
+}
+
+/*
+ * Parses a yes/no query value
+ */
+bool ParseQueryBool(const std::wstring& value, bool& result)
+{
+    const wchar_t* yes[] = { L"yes", L"y", L"true", L"1" };
+    const wchar_t* no[] = { L"no", L"n", L"false", L"0" };
+    for (const wchar_t* word : yes) {
+        if (_wcsicmp(value.c_str(), word) == 0) { result = true; return true; }
+    }
+    for (const wchar_t* word : no) {
+        if (_wcsicmp(value.c_str(), word) == 0) { result = false; return true; }
+    }
+    return false;
+}
+
+/*
+ * Parses a covers: value into sorted, unique code points: either
+ * comma-separated U+XXXX (or 0xXXXX) values, or literal characters
+ */
+bool ParseQueryCodePoints(const std::wstring& value, std::vector<UINT32>& codePoints)
+{
+    codePoints.clear();
+    if (value.size() >= 2 && (_wcsnicmp(value.c_str(), L"U+", 2) == 0 || _wcsnicmp(value.c_str(), L"0x", 2) == 0)) {
+        size_t pos = 0;
+        while (pos < value.size()) {
+            size_t comma = value.find(L',', pos);
+            std::wstring item = value.substr(pos, comma == std::wstring::npos ? std::wstring::npos : comma - pos);
+            if (item.size() < 3 || (_wcsnicmp(item.c_str(), L"U+", 2) != 0 && _wcsnicmp(item.c_str(), L"0x", 2) != 0)) {
+                return false;   // Incomplete, e.g. "U+41,U"
+            }
+            wchar_t* end = nullptr;
+            unsigned long cp = wcstoul(item.c_str() + 2, &end, 16);
+            if (*end != L'\0' || cp > 0x10FFFF) return false;
+            codePoints.push_back(static_cast<UINT32>(cp));
+            if (comma == std::wstring::npos) break;
+            pos = comma + 1;
+        }
+    } else {
+        for (size_t i = 0; i < value.size(); i++) {
+            UINT32 cp = value[i];
+            if (IS_HIGH_SURROGATE(value[i]) && i + 1 < value.size() && IS_LOW_SURROGATE(value[i + 1])) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (value[i + 1] - 0xDC00);
+                i++;
+            }
+            codePoints.push_back(cp);
+        }
+    }
+    std::sort(codePoints.begin(), codePoints.end());
+    codePoints.erase(std::unique(codePoints.begin(), codePoints.end()), codePoints.end());
+    return !codePoints.empty();
+}
+
+/*
+ * Compiles one whitespace-delimited token into query (if it is complete)
+ */
+void AddQueryTerm(const std::wstring& token, FilterQuery& query)
+{
+    auto unquote = [](std::wstring value) {
+        value.erase(std::remove(value.begin(), value.end(), L'"'), value.end());
+        return value;
+    };
+
+    QueryTerm term;
+    size_t split = token.find_first_of(L":<>=");
+    std::wstring key = split == std::wstring::npos ? std::wstring() : token.substr(0, split);
+    std::wstring rest = split == std::wstring::npos ? std::wstring() : token.substr(split);
+
+    // Operator for weight comparisons
+    QueryOp op = QueryOp::Equal;
+    size_t opLength = 1;
+    if (rest.compare(0, 2, L">=") == 0) { op = QueryOp::GreaterEqual; opLength = 2; }
+    else if (rest.compare(0, 2, L"<=") == 0) { op = QueryOp::LessEqual; opLength = 2; }
+    else if (rest.compare(0, 1, L">") == 0) op = QueryOp::Greater;
+    else if (rest.compare(0, 1, L"<") == 0) op = QueryOp::Less;
+    std::wstring value = rest.empty() ? std::wstring() : unquote(rest.substr(opLength));
+    bool colon = !rest.empty() && rest[0] == L':';
+    bool flag = false;
+
+    const wchar_t* k = key.c_str();
+    if (_wcsicmp(k, L"weight") == 0) {
+        wchar_t* end = nullptr;
+        long number = wcstol(value.c_str(), &end, 10);
+        if (value.empty() || *end != L'\0') return;     // Incomplete
+        term.field = QueryField::Weight;
+        term.op = op;
+        term.number = static_cast<int>(number);
+    } else if (colon && (_wcsicmp(k, L"family") == 0 || _wcsicmp(k, L"style") == 0 ||
+                         _wcsicmp(k, L"path") == 0 || _wcsicmp(k, L"axes") == 0)) {
+        if (value.empty()) return;
+        term.field = _wcsicmp(k, L"family") == 0 ? QueryField::Family
+                   : _wcsicmp(k, L"style") == 0 ? QueryField::Style
+                   : _wcsicmp(k, L"path") == 0 ? QueryField::Path : QueryField::Axes;
+        term.text = FoldCase(value);
+        query.usesDetails |= term.field == QueryField::Axes;
+    } else if (colon && (_wcsicmp(k, L"var") == 0 || _wcsicmp(k, L"variable") == 0)) {
+        if (value.empty()) return;
+        if (ParseQueryBool(value, flag)) {
+            term.field = QueryField::Flag;
+            term.bit = FONT_FLAG_VARIABLE;
+            term.wanted = flag;
+        } else {
+            term.field = QueryField::Axes;  // var:wght - has that axis
+            term.text = FoldCase(value);
+        }
+        query.usesDetails = true;
+    } else if (colon && (_wcsicmp(k, L"italic") == 0 || _wcsicmp(k, L"mono") == 0 ||
+                         _wcsicmp(k, L"fixed") == 0)) {
+        if (!ParseQueryBool(value, flag)) return;
+        term.field = QueryField::Flag;
+        term.bit = _wcsicmp(k, L"italic") == 0 ? FONT_FLAG_ITALIC : FONT_FLAG_FIXED;
+        term.wanted = flag;
+        query.usesDetails |= term.bit == FONT_FLAG_FIXED;
+    } else if (colon && (_wcsicmp(k, L"gdi") == 0 || _wcsicmp(k, L"dwrite") == 0 ||
+                         _wcsicmp(k, L"directwrite") == 0 || _wcsicmp(k, L"fontset") == 0)) {
+        if (!ParseQueryBool(value, flag)) return;
+        term.field = QueryField::Source;
+        term.bit = _wcsicmp(k, L"gdi") == 0 ? FONT_SOURCE_GDI
+                 : _wcsicmp(k, L"fontset") == 0 ? FONT_SOURCE_FONTSET : FONT_SOURCE_DWRITE;
+        term.wanted = flag;
+    } else if (colon && (_wcsicmp(k, L"dup") == 0 || _wcsicmp(k, L"duplicate") == 0)) {
+        if (!ParseQueryBool(value, flag)) return;
+        term.field = QueryField::Duplicate;
+        term.wanted = flag;
+        query.usesDuplicates = true;
+    } else if (colon && _wcsicmp(k, L"covers") == 0) {
+        if (!ParseQueryCodePoints(value, term.codePoints)) return;
+        term.field = QueryField::Coverage;
+        query.usesCoverage = true;
+    } else {
+        std::wstring text = unquote(token);
+        if (text.empty()) return;
+        term.field = QueryField::Name;
+        term.text = FoldCase(text);
+    }
+    query.terms.push_back(std::move(term));
+}
+
+/*
+ * Parses the filter text into query and orders its terms
+ *
+ * Each term's pass rate p is estimated on up to QUERY_SAMPLE_SIZE faces
+ * spread over g_fonts, and terms run in increasing (p - 1) / cost: the
+ * classic predicate order, which puts cheap tests that reject many
+ * faces first. Packed-column tests cost 1, memoized string tests 2 and
+ * name searches 8.
+ */
+void CompileQuery(const std::wstring& text, FilterQuery& query)
+{
+    query.terms.clear();
+    query.usesDetails = false;
+    query.usesCoverage = false;
+    query.usesDuplicates = false;
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        while (pos < text.size() && iswspace(text[pos])) pos++;
+        size_t start = pos;
+        bool quoted = false;
+        while (pos < text.size() && (quoted || !iswspace(text[pos]))) {
+            if (text[pos] == L'"') quoted = !quoted;
+            pos++;
+        }
+        if (pos > start) {
+            AddQueryTerm(text.substr(start, pos - start), query);
+        }
+    }
+
+    size_t sampleCount = (std::min)(g_fonts.size(), static_cast<size_t>(QUERY_SAMPLE_SIZE));
+    for (QueryTerm& term : query.terms) {
+        size_t passed = 0;
+        for (size_t s = 0; s < sampleCount; s++) {
+            if (TestQueryTerm(term, s * g_fonts.size() / sampleCount)) passed++;
+        }
+        double p = sampleCount ? static_cast<double>(passed) / sampleCount : 0.5;
+        double cost = term.field == QueryField::Name ? 8
+            : (term.field == QueryField::Weight || term.field == QueryField::Flag ||
+               term.field == QueryField::Source || term.field == QueryField::Duplicate) ? 1 : 2;
+        term.rank = (p - 1) / cost;
+    }
+    std::stable_sort(query.terms.begin(), query.terms.end(),
+        [](const QueryTerm& a, const QueryTerm& b) { return a.rank < b.rank; });
+}
+
+/*
+ * Drops the memoized string results (the pool's IDs are being reused)
+ */
+void ResetQueryMemos()
+{
+    for (QueryTerm& term : g_query.terms) {
+        term.memo.clear();
+    }
+}
+
+/*
+ * Returns true if every face matching next also matches prev, judging
+ * by the terms alone: each term of prev has a counterpart in next that
+ * is the same test or, for text, searches for a longer needle (for
+ * coverage, more code points)
+ */
+bool QueryNarrows(const FilterQuery& next, const FilterQuery& prev)
+{
+    for (const QueryTerm& p : prev.terms) {
+        bool implied = false;
+        for (const QueryTerm& n : next.terms) {
+            if (n.field != p.field || n.op != p.op || n.bit != p.bit || n.wanted != p.wanted) continue;
+            if (p.field == QueryField::Coverage
+                    ? std::includes(n.codePoints.begin(), n.codePoints.end(),
+                                    p.codePoints.begin(), p.codePoints.end())
+                    : p.op == QueryOp::Contains ? n.text.find(p.text) != std::wstring::npos
+                                                : n.number == p.number) {
+                implied = true;
+                break;
+            }
+        }
+        if (!implied) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// FONT DATA MANAGEMENT
+// ============================================================================
+
+/*
+ * Clears all font data and resets selection state
+ * Called before each new enumeration
+ */
+void ClearFonts()
+{
+    CancelFamilyFaceLoad();     // Its batches would refer to the old families
+    g_familyGroups.clear();
+    g_familyGroupsLoaded = 0;
+    CancelDuplicateScan();      // Groups are by path ID, which the next
+    g_duplicateGroups.clear();  // enumeration reuses
+    g_duplicateGroupSizes.clear();
+    g_fonts.clear();
+    ResetQueryMemos();          // String IDs are reused by the next enumeration
+    g_filteredIndices.clear();
+    g_fontsFromSnapshot = false;
+    g_rescanFonts.clear();
+    g_rescanAdded = 0;
+    g_rescanRemoved = 0;
+    RebuildSearchIndex();
+    StartDetailSweep();
+    ListView_DeleteAllItems(g_hListView);
+    g_selectedFont.clear();
+    g_selectedStyle.clear();
+    g_selectedWeight = FW_NORMAL;
+    g_selectedItalic = false;
+    g_selectedPath.clear();
+    g_selectedFaceIndex = 0;
+    SelectPreviewFont();
+}
+
+/*
+ * Sorts g_fonts by family name, then by style name
+ * Called once an enumeration has delivered all of its batches
+ *
+ * Returns the permutation applied: entry i is the old index of the face
+ * now at index i.
+ */
+std::vector<UINT32> SortFonts()
+{
+    // Interned strings compare equal by ID, which skips most comparisons
+    // between faces of the same family
+    std::vector<UINT32> order(g_fonts.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<UINT32>(i);
+    }
+    std::sort(order.begin(), order.end(),
+        [](UINT32 a, UINT32 b) {
+            if (g_fonts.FamilyId(a) != g_fonts.FamilyId(b)) {
+                int cmp = g_fonts.Family(a).compare(g_fonts.Family(b));
+                if (cmp != 0) return cmp < 0;
+            }
+            if (g_fonts.StyleId(a) == g_fonts.StyleId(b)) return false;
+            return g_fonts.Style(a) < g_fonts.Style(b);
+        });
+    g_fonts.Select(order);
+    return order;
+}
+
+/*
+ * Appends the folded names of g_fonts[first..] to the search index
+ */
+void AppendSearchIndex(size_t first)
+{
+    g_prefixIndex.fontsValid = false;
+    g_prefixIndex.rowsValid = false;
+    for (size_t i = first; i < g_fonts.size(); i++) {
+        std::wstring_view family = g_fonts.Family(i);
+        std::wstring_view style = g_fonts.Style(i);
+        FoldCaseAppend(family.data(), family.size(), g_searchIndex.text);
+        g_searchIndex.text.push_back(L'\0');
+        FoldCaseAppend(style.data(), style.size(), g_searchIndex.text);
+        g_searchIndex.text.push_back(L'\0');
+        g_searchIndex.offsets.push_back(static_cast<UINT32>(g_searchIndex.text.size()));
+    }
+}
+
+/*
+ * Rebuilds the search index for all of g_fonts (after sorting)
+ */
+void RebuildSearchIndex()
+{
+    g_searchIndex.text.clear();
+    g_searchIndex.offsets.assign(1, 0);
+    AppendSearchIndex(0);
+    g_appliedFilterValid = false;  // Existing indices refer to the old order
+    InvalidateSortOrders(-1);
+    ResetFaceCoverage();
+}
+
+/*
+ * Returns true if g_fonts[fontIndex] matches the current filter query
+ *
+ * Used for faces arriving while an enumeration streams in.
+ */
+bool MatchesFilter(size_t fontIndex)
+{
+    for (QueryTerm& term : g_query.terms) {
+        if (!TestQueryTerm(term, fontIndex)) return false;
+    }
+    return true;
+}
+
+/*
+ * Fills g_filteredIndices with every font whose index entry contains
+ * query (every font if query is empty)
+ *
+ * Runs the search kernel once over the whole index buffer; each hit is
+ * mapped back to its font through the offsets table, and the scan then
+ * resumes at the next font's entry so a font is reported once.
+ */
+void ScanSearchIndex(std::wstring_view query)
+{
+    g_filteredIndices.clear();
+
+    if (query.empty()) {
+        g_filteredIndices.resize(g_fonts.size());
+        for (size_t i = 0; i < g_fonts.size(); i++) {
+            g_filteredIndices[i] = i;
+        }
+        return;
+    }
+
+    const wchar_t* text = g_searchIndex.text.data();
+    const size_t length = g_searchIndex.text.size();
+    auto cursor = g_searchIndex.offsets.begin();
+    size_t pos = 0;
+    while ((pos = FindSubstring(text, length, pos, query)) != std::wstring_view::npos) {
+        // Matches are increasing, so search only past the previous font
+        cursor = std::upper_bound(cursor, g_searchIndex.offsets.end(), static_cast<UINT32>(pos)) - 1;
+        size_t fontIndex = static_cast<size_t>(cursor - g_searchIndex.offsets.begin());
+        g_filteredIndices.push_back(fontIndex);
+        pos = *++cursor;
+    }
+}
+
+/*
+ * Removes the faces failing term from g_filteredIndices
+ */
+void FilterByTerm(QueryTerm& term)
+{
+    g_filteredIndices.erase(
+        std::remove_if(g_filteredIndices.begin(), g_filteredIndices.end(),
+            [&term](size_t i) { return !TestQueryTerm(term, i); }),
+        g_filteredIndices.end());
+}
+
+/*
+ * Applies the compiled filter query (g_query) to the font list
+ *
+ * Creates a list of indices into g_fonts for fonts that pass every
+ * term. The first name term in evaluation order seeds the list from a
+ * scan of the prebuilt g_searchIndex; the other terms then run one at a
+ * time over the shrinking list, in the order CompileQuery chose.
+ *
+ * When the new query implies the previously applied one (the usual
+ * case while typing), the result can only shrink, so only the current
+ * g_filteredIndices are re-tested instead of all of g_fonts.
+ */
+void ApplyFilter()
+{
+    // Grouped rows hide faces a narrower query must still see
+    bool narrowing = g_appliedFilterValid && g_currentMode != EnumMode::Families &&
+                     QueryNarrows(g_query, g_appliedQuery);
+
+    GUID activity;
+    bool tracing = BeginTraceActivity(activity);
+    size_t candidates = narrowing ? g_filteredIndices.size() : g_fonts.size();
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "ApplyFilter", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_START),
+            TraceLoggingWideString(g_filterText.c_str(), "Query"),
+            TraceLoggingUInt32(static_cast<UINT32>(g_query.terms.size()), "Terms"),
+            TraceLoggingBool(narrowing, "Narrowing"),
+            TraceLoggingUInt64(candidates, "Candidates"));
+    }
+
+    if (narrowing && QueryNarrows(g_appliedQuery, g_query)) {
+        UpdateStatusText();  // Nothing changed; keep the selection
+    } else {
+        if (narrowing) {
+            for (QueryTerm& term : g_query.terms) {
+                FilterByTerm(term);
+            }
+        } else {
+            QueryTerm* seed = nullptr;
+            for (QueryTerm& term : g_query.terms) {
+                if (term.field == QueryField::Name) { seed = &term; break; }
+            }
+            ScanSearchIndex(seed ? std::wstring_view(seed->text) : std::wstring_view());
+            for (QueryTerm& term : g_query.terms) {
+                if (&term != seed) FilterByTerm(term);
+            }
+            ApplySortOrder();   // Narrowing keeps the order it filters
+        }
+
+        g_appliedQuery.terms = g_query.terms;
+        for (QueryTerm& term : g_appliedQuery.terms) {
+            term.memo.clear();
+        }
+        g_appliedFilterValid = true;
+
+        PopulateListView();
+        UpdateStatusText();
+    }
+
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "ApplyFilter", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+            TraceLoggingUInt64(g_filteredIndices.size(), "Matches"));
+    }
+}
+
+// ============================================================================
+// LIST SORTING - Click-to-sort columns
+// ============================================================================
+
+#define LIST_COLUMN_COUNT   11      // Including the All APIs presence columns
+#define LIST_COLUMN_DUPLICATES 7    // Duplicate group (see DUPLICATE FILES)
+#define LIST_COLUMN_SOURCES 8       // First All APIs presence column
+
+/*
+ * SortOrders - Row orders for click-to-sort, cached per column
+ *
+ * String columns compare by collation rank: every interned string gets
+ * its LCMapStringEx sort key once, the keys are ordered with memcmp, and
+ * faces then compare ranks as integers. byColumn[c] is the ascending
+ * order of all of g_fonts by column c (descending walks it backwards);
+ * an entry is rebuilt only when g_fonts changed since it was computed.
+ */
+struct SortOrders {
+    std::vector<UINT32> rank;                       // Collation rank per pool string ID
+    std::vector<UINT32> byColumn[LIST_COLUMN_COUNT];
+};
+
+SortOrders g_sortOrders;
+
+/*
+ * Drops the cached orders of column, or of every column if column < 0
+ *
+ * Called when g_fonts is replaced or reordered (see RebuildSearchIndex),
+ * and for the detail columns when deferred details arrive.
+ */
+void InvalidateSortOrders(int column)
+{
+    if (column >= 0) {
+        g_sortOrders.byColumn[column].clear();
+        return;
+    }
+    g_sortOrders.rank.clear();
+    for (auto& order : g_sortOrders.byColumn) {
+        order.clear();
+    }
+}
+
+/*
+ * Assigns every string in the g_fonts pool its collation rank
+ *
+ * Equal sort keys (e.g. names differing only in case) share a rank.
+ */
+void BuildCollationRanks()
+{
+    const StringPool& pool = g_fonts.Pool();
+    size_t count = pool.Count();
+    std::vector<BYTE> keys;
+    std::vector<UINT32> offsets(count + 1, 0);
+    const DWORD flags = LCMAP_SORTKEY | LINGUISTIC_IGNORECASE | SORT_DIGITSASNUMBERS;
+    for (size_t id = 0; id < count; id++) {
+        std::wstring_view str = pool.View(static_cast<UINT32>(id));
+        int size = str.empty() ? 0 : LCMapStringEx(LOCALE_NAME_USER_DEFAULT, flags,
+            str.data(), static_cast<int>(str.size()), NULL, 0, NULL, NULL, 0);
+        if (size > 0) {
+            size_t start = keys.size();
+            keys.resize(start + size);
+            LCMapStringEx(LOCALE_NAME_USER_DEFAULT, flags, str.data(), static_cast<int>(str.size()),
+                reinterpret_cast<LPWSTR>(&keys[start]), size, NULL, NULL, 0);
+        }
+        offsets[id + 1] = static_cast<UINT32>(keys.size());
+    }
+
+    // Sort keys are NUL-terminated byte strings, so memcmp over the
+    // shorter length (terminator included) orders them like strcmp
+    auto compare = [&](UINT32 a, UINT32 b) {
+        size_t lengthA = offsets[a + 1] - offsets[a];
+        size_t lengthB = offsets[b + 1] - offsets[b];
+        int cmp = memcmp(keys.data() + offsets[a], keys.data() + offsets[b], (std::min)(lengthA, lengthB));
+        if (cmp != 0) return cmp;
+        return lengthA < lengthB ? -1 : lengthA > lengthB ? 1 : 0;
+    };
+
+    std::vector<UINT32> ids(count);
+    for (size_t id = 0; id < count; id++) {
+        ids[id] = static_cast<UINT32>(id);
+    }
+    std::sort(ids.begin(), ids.end(), [&](UINT32 a, UINT32 b) { return compare(a, b) < 0; });
+
+    g_sortOrders.rank.assign(count, 0);
+    UINT32 rank = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0 && compare(ids[i - 1], ids[i]) != 0) rank++;
+        g_sortOrders.rank[ids[i]] = rank;
+    }
+}
+
+/*
+ * Returns the ascending order of g_fonts by column, computing it if needed
+ *
+ * Ties are broken by family, then style, then storage order, so every
+ * order is total and rows don't shuffle between identical re-sorts.
+ */
+const std::vector<UINT32>& GetSortOrder(int column)
+{
+    std::vector<UINT32>& order = g_sortOrders.byColumn[column];
+    if (order.size() == g_fonts.size() && !order.empty()) {
+        return order;
+    }
+    if (g_sortOrders.rank.size() != g_fonts.Pool().Count()) {
+        BuildCollationRanks();  // Pool grew (new batches or details)
+        for (auto& other : g_sortOrders.byColumn) {
+            other.clear();
+        }
+    }
+    const std::vector<UINT32>& rank = g_sortOrders.rank;
+
+    BYTE sourceBit = column == LIST_COLUMN_SOURCES ? FONT_SOURCE_GDI
+                   : column == LIST_COLUMN_SOURCES + 1 ? FONT_SOURCE_DWRITE : FONT_SOURCE_FONTSET;
+    std::vector<UINT32> primary(g_fonts.size());
+    std::vector<UINT32> secondary(g_fonts.size(), 0);
+    for (size_t i = 0; i < g_fonts.size(); i++) {
+        switch (column) {
+        case 0: primary[i] = rank[g_fonts.FamilyId(i)]; break;
+        case 1: primary[i] = rank[g_fonts.StyleId(i)]; break;
+        case 2: primary[i] = static_cast<UINT32>(g_fonts.Weight(i)); break;
+        case 3: primary[i] = g_fonts.IsItalic(i) ? 1 : 0; break;
+        case 4:
+            // Rows still waiting for their details sort first, like blanks
+            primary[i] = g_fonts.DetailsPending(i) ? 0 : g_fonts.IsFixedPitch(i) ? 2 : 1;
+            break;
+        case 5:
+            primary[i] = rank[g_fonts.PathId(i)];
+            secondary[i] = g_fonts.FaceIndex(i);
+            break;
+        case 6:
+            primary[i] = g_fonts.IsVariable(i) ? 1 : 0;
+            secondary[i] = rank[g_fonts.AxesId(i)];
+            break;
+        case LIST_COLUMN_DUPLICATES:
+            // Files without duplicates (group 0) sort first, like blanks
+            primary[i] = GetFontDuplicateGroup(i);
+            secondary[i] = rank[g_fonts.PathId(i)];
+            break;
+        default:
+            primary[i] = (g_fonts.Sources(i) & sourceBit) ? 1 : 0;
+            break;
+        }
+    }
+
+    order.resize(g_fonts.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = static_cast<UINT32>(i);
+    }
+    std::sort(order.begin(), order.end(), [&](UINT32 a, UINT32 b) {
+        if (primary[a] != primary[b]) return primary[a] < primary[b];
+        if (secondary[a] != secondary[b]) return secondary[a] < secondary[b];
+        UINT32 familyA = rank[g_fonts.FamilyId(a)], familyB = rank[g_fonts.FamilyId(b)];
+        if (familyA != familyB) return familyA < familyB;
+        UINT32 styleA = rank[g_fonts.StyleId(a)], styleB = rank[g_fonts.StyleId(b)];
+        if (styleA != styleB) return styleA < styleB;
+        return a < b;
+    });
+    return order;
+}
+
+/*
+ * Reorders g_filteredIndices by the active sort column
+ *
+ * The filter result is a set of faces; walking the cached order of the
+ * column and keeping the matching faces intersects the two in O(n).
+ */
+void ApplySortOrder()
+{
+    if (g_sortColumn < 0 || g_fonts.empty()) {
+        ApplyFamilyGrouping();
+        return;
+    }
+    const std::vector<UINT32>& order = GetSortOrder(g_sortColumn);
+
+    std::vector<bool> matches(g_fonts.size(), false);
+    for (size_t font : g_filteredIndices) {
+        matches[font] = true;
+    }
+    size_t count = g_filteredIndices.size();
+    g_filteredIndices.clear();
+    g_filteredIndices.reserve(count);
+    if (g_sortDescending) {
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (matches[*it]) g_filteredIndices.push_back(*it);
+        }
+    } else {
+        for (UINT32 font : order) {
+            if (matches[font]) g_filteredIndices.push_back(font);
+        }
+    }
+    ApplyFamilyGrouping();
+}
+
+/*
+ * Shows the sort arrow on the active column's header
+ */
+void UpdateSortArrows()
+{
+    HWND hHeader = ListView_GetHeader(g_hListView);
+    int count = Header_GetItemCount(hHeader);
+    for (int c = 0; c < count; c++) {
+        HDITEMW hdi = {};
+        hdi.mask = HDI_FORMAT;
+        if (!Header_GetItem(hHeader, c, &hdi)) continue;
+        hdi.fmt &= ~(HDF_SORTUP | HDF_SORTDOWN);
+        if (c == g_sortColumn) {
+            hdi.fmt |= g_sortDescending ? HDF_SORTDOWN : HDF_SORTUP;
+        }
+        Header_SetItem(hHeader, c, &hdi);
+    }
+}
+
+/*
+ * Handles LVN_COLUMNCLICK - sorts by the column, or reverses the
+ * direction when it is already the sort column
+ *
+ * The selected face stays selected and scrolled into view.
+ */
+void OnColumnClick(int column)
+{
+    if (column < 0 || column >= LIST_COLUMN_COUNT) return;
+    if (column == g_sortColumn) {
+        g_sortDescending = !g_sortDescending;
+    } else {
+        g_sortColumn = column;
+        g_sortDescending = false;
+    }
+    UpdateSortArrows();
+
+    int selectedRow = ListView_GetNextItem(g_hListView, -1, LVNI_SELECTED);
+    size_t selected = selectedRow >= 0 && static_cast<size_t>(selectedRow) < g_filteredIndices.size()
+        ? g_filteredIndices[selectedRow] : SIZE_MAX;
+
+    ApplySortOrder();
+    PopulateListView();
+
+    int row = FindRowForFont(selected);
+    if (row >= 0) {
+        ListView_SetItemState(g_hListView, row, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+        ListView_EnsureVisible(g_hListView, row, FALSE);
+    }
+}
+
+// ============================================================================
+// TYPE-AHEAD - Jumping to a family from the keyboard (LVN_ODFINDITEM)
+// ============================================================================
+
+/*
+ * Returns the folded family name of g_fonts[fontIndex] from the search
+ * index entry (NUL-terminated there)
+ */
+std::wstring_view GetFoldedFamily(size_t fontIndex)
+{
+    return std::wstring_view(g_searchIndex.text.data() + g_searchIndex.offsets[fontIndex]);
+}
+
+/*
+ * Brings g_prefixIndex up to date with g_fonts and g_filteredIndices
+ *
+ * g_fonts is already sorted by family, so the font order usually only
+ * needs checking; the row order is then read off it in O(n), sorting
+ * just the runs of faces that share a family.
+ */
+void UpdatePrefixIndex()
+{
+    PrefixIndex& index = g_prefixIndex;
+    if (!index.fontsValid) {
+        auto byFamily = [](UINT32 a, UINT32 b) {
+            int cmp = GetFoldedFamily(a).compare(GetFoldedFamily(b));
+            return cmp != 0 ? cmp < 0 : a < b;
+        };
+        index.fonts.resize(g_fonts.size());
+        for (size_t i = 0; i < index.fonts.size(); i++) {
+            index.fonts[i] = static_cast<UINT32>(i);
+        }
+        if (!std::is_sorted(index.fonts.begin(), index.fonts.end(), byFamily)) {
+            std::sort(index.fonts.begin(), index.fonts.end(), byFamily);
+        }
+        index.fontsValid = true;
+        index.rowsValid = false;
+    }
+    if (index.rowsValid) return;
+
+    std::vector<UINT32> rowOfFont(g_fonts.size(), UINT32_MAX);
+    for (size_t row = 0; row < g_filteredIndices.size(); row++) {
+        rowOfFont[g_filteredIndices[row]] = static_cast<UINT32>(row);
+    }
+    index.rows.clear();
+    index.rows.reserve(g_filteredIndices.size());
+    for (size_t i = 0; i < index.fonts.size();) {
+        std::wstring_view family = GetFoldedFamily(index.fonts[i]);
+        size_t first = index.rows.size();
+        for (; i < index.fonts.size() && GetFoldedFamily(index.fonts[i]) == family; i++) {
+            UINT32 row = rowOfFont[index.fonts[i]];
+            if (row != UINT32_MAX) index.rows.push_back(row);
+        }
+        std::sort(index.rows.begin() + first, index.rows.end());
+    }
+    index.rowRank.resize(index.rows.size());
+    for (size_t pos = 0; pos < index.rows.size(); pos++) {
+        index.rowRank[index.rows[pos]] = static_cast<UINT32>(pos);
+    }
+    index.rowsValid = true;
+}
+
+/*
+ * Handles LVN_ODFINDITEM - the ListView's incremental search
+ *
+ * Returns the row to jump to, or -1. The typed text is matched as a
+ * case-insensitive prefix of the family name by binary search, so each
+ * keystroke costs O(log n) and the rows themselves are left alone. If
+ * the row at iStart matches it is kept (the ListView starts one past the
+ * focus when the same letter is typed again, stepping through a family);
+ * otherwise the search goes to the alphabetically first match.
+ */
+int OnFindItem(const NMLVFINDITEMW* pFind)
+{
+    const LVFINDINFOW& info = pFind->lvfi;
+    if (!(info.flags & (LVFI_STRING | LVFI_PARTIAL)) || !info.psz || g_filteredIndices.empty()) {
+        return -1;
+    }
+    UpdatePrefixIndex();
+
+    std::wstring prefix = FoldCase(info.psz);
+    bool partial = (info.flags & LVFI_PARTIAL) != 0;
+    const std::vector<UINT32>& rows = g_prefixIndex.rows;
+    auto familyOf = [](UINT32 row) { return GetFoldedFamily(g_filteredIndices[row]); };
+
+    // Matching rows are contiguous in the index: [lo, hi)
+    auto lo = std::partition_point(rows.begin(), rows.end(),
+        [&](UINT32 row) { return familyOf(row) < prefix; });
+    auto hi = std::partition_point(lo, rows.end(), [&](UINT32 row) {
+        std::wstring_view family = familyOf(row);
+        return partial ? family.compare(0, prefix.size(), prefix) == 0 : family == prefix;
+    });
+    if (lo == hi) return -1;
+
+    size_t start = pFind->iStart >= 0 && static_cast<size_t>(pFind->iStart) < rows.size()
+        ? static_cast<size_t>(pFind->iStart) : 0;
+    auto pos = rows.begin() + g_prefixIndex.rowRank[start];
+    return static_cast<int>(pos >= lo && pos < hi ? *pos : *lo);
+}
+
+// ============================================================================
+// BACKGROUND ENUMERATION - Starting, cancelling and receiving results
+// ============================================================================
+
+/*
+ * Stops the running enumeration, if any, and waits for its worker to exit
+ *
+ * Batches already posted by the cancelled worker are discarded on arrival
+ * because their generation no longer matches.
+ */
+void CancelEnumeration()
+{
+    if (g_enumJob) {
+        g_enumJob->cancelled = true;
+    }
+    if (g_enumThread.joinable()) {
+        g_enumThread.join();
+    }
+    g_enumJob.reset();
+}
+
+/*
+ * Starts enumerating fonts with the given API on a worker thread
+ *
+ * Any run in progress is cancelled first, so clicking another mode
+ * button while the list is still filling switches to the new mode.
+ * With useSnapshot, an on-disk snapshot is streamed instead when the
+ * installed fonts haven't changed since it was written.
+ */
+void StartEnumeration(EnumMode mode, bool useSnapshot)
+{
+    CancelEnumeration();
+    ClearFonts();
+
+    g_currentMode = mode;
+    g_enumProcessed = 0;
+    g_enumTotal = 0;
+    ShowSourceColumns(mode == EnumMode::All);
+
+    g_enumJob = std::make_unique<EnumJob>();
+    g_enumJob->mode = mode;
+    g_enumJob->generation = ++g_enumGeneration;
+    g_enumJob->useSnapshot = useSnapshot;
+    if (mode == EnumMode::Folder) {
+        g_enumJob->folderPath = g_folderPath;
+    }
+    g_enumThread = std::thread(EnumerationThreadProc, g_enumJob.get());
+
+    UpdateStatusText();
+}
+
+/*
+ * Asks for the folder to open in Folder mode, starting at path
+ *
+ * Returns true and updates path if a file system folder was chosen.
+ */
+bool ChooseFontFolder(HWND hWnd, std::wstring& path)
+{
+    IFileOpenDialog* pDialog = nullptr;
+    if (FAILED(CoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_INPROC_SERVER,
+            IID_PPV_ARGS(&pDialog)))) {
+        MessageBoxW(hWnd, L"Failed to create the folder picker", L"Error", MB_OK | MB_ICONERROR);
+        return false;
+    }
+
+    DWORD options = 0;
+    pDialog->GetOptions(&options);
+    pDialog->SetOptions(options | FOS_PICKFOLDERS | FOS_FORCEFILESYSTEM);
+    pDialog->SetTitle(L"Open font folder");
+    if (!path.empty()) {
+        IShellItem* pFolder = nullptr;
+        if (SUCCEEDED(SHCreateItemFromParsingName(path.c_str(), NULL, IID_PPV_ARGS(&pFolder)))) {
+            pDialog->SetFolder(pFolder);
+            pFolder->Release();
+        }
+    }
+
+    bool chosen = false;
+    IShellItem* pItem = nullptr;
+    if (SUCCEEDED(pDialog->Show(hWnd)) && SUCCEEDED(pDialog->GetResult(&pItem))) {
+        PWSTR pszPath = nullptr;
+        if (SUCCEEDED(pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
+            path = pszPath;
+            chosen = true;
+            CoTaskMemFree(pszPath);
+        }
+        pItem->Release();
+    }
+    pDialog->Release();
+    return chosen;
+}
+
+/*
+ * Shows the most recently written snapshot immediately at startup
+ *
+ * The list is filled straight from the mapped file on the UI thread
+ * (see ReadSnapshot); a background job then recomputes the font
+ * fingerprint and triggers a full enumeration only if the fonts changed.
+ */
+void LoadStartupSnapshot()
+{
+    const EnumMode modes[] = { EnumMode::GDI, EnumMode::DirectWrite, EnumMode::FontSet, EnumMode::OpenType };
+    EnumMode newest = EnumMode::None;
+    FILETIME newestTime = {};
+    for (EnumMode mode : modes) {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        std::wstring path = GetSnapshotPath(mode);
+        if (!path.empty() && GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data) &&
+            CompareFileTime(&data.ftLastWriteTime, &newestTime) > 0) {
+            newest = mode;
+            newestTime = data.ftLastWriteTime;
+        }
+    }
+
+    if (newest == EnumMode::None) return;
+
+    // Nothing is loaded yet, and ReadSnapshot leaves g_fonts empty on failure
+    UINT64 fingerprint = 0;
+    ClearFonts();
+    if (!ReadSnapshot(newest, &fingerprint, g_fonts)) {   // Stored already sorted
+        return;
+    }
+    g_currentMode = newest;
+    g_fontsFromSnapshot = true;
+    g_fontsFingerprint = fingerprint;
+    RebuildSearchIndex();
+    StartDetailSweep();
+    StartCoverageBuild();
+    StartDuplicateScan();
+    PublishFontInventory();
+
+    g_enumJob = std::make_unique<EnumJob>();
+    g_enumJob->mode = newest;
+    g_enumJob->generation = ++g_enumGeneration;
+    g_enumJob->revalidateOnly = true;
+    g_enumJob->snapshotFingerprint = fingerprint;
+    g_enumThread = std::thread(EnumerationThreadProc, g_enumJob.get());
+
+    ApplyFilter();
+}
+
+/*
+ * Handles WM_APP_FONT_BATCH - appends a batch of fonts to g_fonts
+ *
+ * Only the new fonts are filtered and appended to the virtual ListView;
+ * the full sort and repopulate happen once in OnEnumerationDone.
+ */
+void OnFontBatch(FontBatch* pBatch)
+{
+    std::unique_ptr<FontBatch> batch(pBatch);
+    if (!g_enumJob || batch->generation != g_enumJob->generation) {
+        return;  // Stale batch from a cancelled run
+    }
+
+    if (g_enumJob->rescan) {
+        // Collected separately and diffed against g_fonts when complete
+        for (const auto& font : batch->fonts) {
+            g_rescanFonts.Add(font);
+        }
+        g_enumProcessed = batch->processed;
+        g_enumTotal = batch->total;
+        UpdateStatusText();
+        return;
+    }
+
+    size_t first = g_fonts.size();
+    for (const auto& font : batch->fonts) {
+        g_fonts.Add(font);
+        if (font.isGroup) {
+            g_familyGroups[g_fonts.FamilyId(g_fonts.size() - 1)].faceCount = font.faceCount;
+        }
+    }
+    g_enumProcessed = batch->processed;
+    g_enumTotal = batch->total;
+
+    AppendSearchIndex(first);
+    for (size_t i = first; i < g_fonts.size(); i++) {
+        if (MatchesFilter(i)) {
+            g_filteredIndices.push_back(i);
+        }
+    }
+
+    // Grow the virtual list without repainting or scrolling existing rows
+    ListView_SetItemCountEx(g_hListView, static_cast<int>(g_filteredIndices.size()),
+        LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+
+    UpdateStatusText();
+}
+
+/*
+ * Handles WM_APP_ENUM_DONE - finalizes the current enumeration
+ */
+void OnEnumerationDone(UINT generation)
+{
+    if (!g_enumJob || generation != g_enumJob->generation) {
+        return;
+    }
+
+    if (g_enumThread.joinable()) {
+        g_enumThread.join();
+    }
+    std::unique_ptr<EnumJob> job = std::move(g_enumJob);
+
+    if (job->revalidateOnly) {
+        // g_fonts came from the startup snapshot; rescan only if it's stale
+        if (job->snapshotStale) {
+            StartEnumeration(job->mode, false);
+        } else {
+            UpdateStatusText();
+        }
+        return;
+    }
+
+    if (job->rescan) {
+        // A failed rescan keeps the current list; the next change retries
+        if (!job->errorText) {
+            g_fontsFromSnapshot = false;
+            g_fontsFingerprint = job->fingerprint;
+            ApplyRescan(g_rescanFonts);
+            SaveSnapshot(job->mode, job->fingerprint, g_fonts);
+            PublishFontInventory();
+            StartCoverageBuild();
+            StartDuplicateScan();
+        } else {
+            UpdateStatusText();
+        }
+        g_rescanFonts.clear();
+        return;
+    }
+
+    SortFonts();
+    RebuildSearchIndex();
+    StartDetailSweep();
+    g_fontsFromSnapshot = job->fromSnapshot;
+    g_fontsFingerprint = job->fingerprint;
+    StartCoverageBuild();
+    StartDuplicateScan();
+    ApplyFilter();
+
+    if (job->errorText) {
+        MessageBoxW(g_hWnd, job->errorText, L"Error", MB_OK | MB_ICONERROR);
+    } else if (!job->fromSnapshot) {
+        SaveSnapshot(job->mode, job->fingerprint, g_fonts);
+    }
+    if (!job->errorText) {
+        PublishFontInventory();
+    }
+    if (job->mode == EnumMode::Families && !job->errorText) {
+        StartFamilyFaceLoad();
+    }
+}
+
+// ============================================================================
+// FONT CHANGE HANDLING - Incremental rescans
+// ============================================================================
+
+/*
+ * Builds the identity key used to match faces across rescans
+ *
+ * File path (case-insensitive) and face index identify a face; family
+ * and style are included because one face of a variable font appears
+ * once per named instance. GDI results have no path, so they match by
+ * family and style alone. In All APIs mode a face whose set of reporting
+ * APIs changed counts as replaced, so its presence columns are updated.
+ */
+std::wstring MakeFontIdentityKey(const FontStore& fonts, size_t i)
+{
+    std::wstring key = FoldCase(std::wstring(fonts.Path(i)));
+    key += L'\0';
+    key += std::to_wstring(fonts.FaceIndex(i));
+    key += L'\0';
+    key += fonts.Family(i);
+    key += L'\0';
+    key += fonts.Style(i);
+    key += L'\0';
+    key += static_cast<wchar_t>(L'0' + fonts.Sources(i));
+    return key;
+}
+
+/*
+ * Starts a background re-enumeration of the current mode after a font
+ * change; the results are diffed against g_fonts in ApplyRescan
+ *
+ * If another job is running, the rescan is retried after RESCAN_DELAY_MS.
+ */
+void StartRescan()
+{
+    // System font changes don't affect an opened folder
+    if (g_currentMode == EnumMode::None || g_currentMode == EnumMode::Folder) return;
+    if (g_enumJob) {
+        SetTimer(g_hWnd, IDT_RESCAN_TIMER, RESCAN_DELAY_MS, NULL);
+        return;
+    }
+    if (g_currentMode == EnumMode::Families) {
+        // Group rows are cheap to list again; faces reload in the background
+        StartEnumeration(EnumMode::Families, false);
+        return;
+    }
+
+    g_rescanFonts.clear();
+    g_enumProcessed = 0;
+    g_enumTotal = 0;
+
+    g_enumJob = std::make_unique<EnumJob>();
+    g_enumJob->mode = g_currentMode;
+    g_enumJob->generation = ++g_enumGeneration;
+    g_enumJob->useSnapshot = false;
+    g_enumJob->rescan = true;
+    g_enumJob->checkForUpdates = true;
+    g_enumThread = std::thread(EnumerationThreadProc, g_enumJob.get());
+
+    UpdateStatusText();
+}
+
+/*
+ * Returns the ListView row showing fontIndex, or -1 if it's filtered out
+ */
+int FindRowForFont(size_t fontIndex)
+{
+    auto it = std::find(g_filteredIndices.begin(), g_filteredIndices.end(), fontIndex);
+    return it == g_filteredIndices.end() ? -1 : static_cast<int>(it - g_filteredIndices.begin());
+}
+
+/*
+ * Scrolls the ListView so that row is at the top (row 0 scrolls home)
+ *
+ * ListView_Scroll is relative, so the distance is measured from the
+ * current top row.
+ */
+void ScrollListViewToRow(int row)
+{
+    RECT itemRect;
+    if (!ListView_GetItemRect(g_hListView, 0, &itemRect, LVIR_BOUNDS)) return;
+    int delta = row - ListView_GetTopIndex(g_hListView);
+    if (delta != 0) {
+        ListView_Scroll(g_hListView, 0, delta * (itemRect.bottom - itemRect.top));
+    }
+}
+
+/*
+ * Applies a completed rescan: removes faces that disappeared, adds new
+ * ones, and keeps the selected face and the scroll position
+ *
+ * When nothing changed, the list isn't touched at all. Otherwise g_fonts
+ * is re-sorted and the search index, details sweep and filter are rebuilt
+ * as after a full enumeration; only the selection and top row carry over.
+ */
+void ApplyRescan(const FontStore& fresh)
+{
+    std::unordered_set<std::wstring> freshKeys;
+    freshKeys.reserve(fresh.size());
+    for (size_t i = 0; i < fresh.size(); i++) {
+        freshKeys.insert(MakeFontIdentityKey(fresh, i));
+    }
+
+    // Remember what the user is looking at, by index until the faces move
+    size_t selectedFont = SIZE_MAX, topFont = SIZE_MAX;
+    int selectedRow = ListView_GetNextItem(g_hListView, -1, LVNI_SELECTED);
+    int topRow = ListView_GetTopIndex(g_hListView);
+    if (selectedRow >= 0 && static_cast<size_t>(selectedRow) < g_filteredIndices.size()) {
+        selectedFont = g_filteredIndices[selectedRow];
+    }
+    if (topRow >= 0 && static_cast<size_t>(topRow) < g_filteredIndices.size()) {
+        topFont = g_filteredIndices[topRow];
+    }
+
+    // Drop removed faces, remembering the keys of the ones that stay and
+    // following the selected and top faces to their new indices
+    std::unordered_set<std::wstring> currentKeys;
+    currentKeys.reserve(g_fonts.size());
+    std::vector<UINT32> kept;
+    kept.reserve(g_fonts.size());
+    size_t keptSelected = SIZE_MAX, keptTop = SIZE_MAX;
+    for (size_t i = 0; i < g_fonts.size(); i++) {
+        std::wstring key = MakeFontIdentityKey(g_fonts, i);
+        if (freshKeys.count(key) != 0) {
+            if (i == selectedFont) keptSelected = kept.size();
+            if (i == topFont) keptTop = kept.size();
+            currentKeys.insert(std::move(key));
+            kept.push_back(static_cast<UINT32>(i));
+        }
+    }
+    size_t removed = g_fonts.size() - kept.size();
+    if (removed != 0) {
+        g_fonts.Select(kept);
+    }
+
+    // Append new faces
+    size_t added = 0;
+    for (size_t i = 0; i < fresh.size(); i++) {
+        if (currentKeys.insert(MakeFontIdentityKey(fresh, i)).second) {
+            g_fonts.Add(fresh.Get(i));
+            added++;
+        }
+    }
+
+    g_rescanAdded = added;
+    g_rescanRemoved = removed;
+    if (added == 0 && removed == 0) {
+        UpdateStatusText();
+        return;
+    }
+
+    std::vector<UINT32> order = SortFonts();
+    RebuildSearchIndex();
+    StartDetailSweep();
+    ApplyFilter();
+
+    // Map the kept indices through the sort
+    size_t sortedSelected = SIZE_MAX, sortedTop = SIZE_MAX;
+    for (size_t i = 0; i < order.size(); i++) {
+        if (order[i] == keptSelected) sortedSelected = i;
+        if (order[i] == keptTop) sortedTop = i;
+    }
+
+    // Restore scroll position, then selection (which may be gone)
+    int newTop = FindRowForFont(sortedTop);
+    if (newTop >= 0) {
+        ScrollListViewToRow(newTop);
+    }
+    int newSelected = FindRowForFont(sortedSelected);
+    if (newSelected >= 0) {
+        ListView_SetItemState(g_hListView, newSelected,
+            LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+    }
+}
+
+/*
+ * Watches the DirectWrite system font collection for expiry
+ *
+ * Runs on its own thread. IDWriteFontCollection3::GetExpirationEvent is
+ * signaled when the collection no longer matches the installed fonts
+ * (including changes WM_FONTCHANGE doesn't report, such as per-user
+ * installs by other processes). Exits when g_hWatcherStop is signaled,
+ * or immediately on systems without IDWriteFontCollection3.
+ */
+void FontCollectionWatcherProc()
+{
+    IDWriteFactory6* pDWriteFactory6 = nullptr;
+    if (FAILED(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory6),
+            reinterpret_cast<IUnknown**>(&pDWriteFactory6)))) {
+        return;
+    }
+
+    for (;;) {
+        IDWriteFontCollection2* pCollection2 = nullptr;
+        IDWriteFontCollection3* pCollection3 = nullptr;
+        HANDLE hExpired = NULL;
+        if (SUCCEEDED(pDWriteFactory6->GetSystemFontCollection(FALSE,
+                DWRITE_FONT_FAMILY_MODEL_WEIGHT_STRETCH_STYLE, &pCollection2))) {
+            if (SUCCEEDED(pCollection2->QueryInterface(__uuidof(IDWriteFontCollection3), (void**)&pCollection3))) {
+                hExpired = pCollection3->GetExpirationEvent();  // Owned by the collection
+            }
+        }
+
+        DWORD wait = WAIT_FAILED;
+        if (hExpired) {
+            HANDLE handles[2] = { g_hWatcherStop, hExpired };
+            wait = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        }
+
+        if (pCollection3) pCollection3->Release();
+        if (pCollection2) pCollection2->Release();
+        if (wait != WAIT_OBJECT_0 + 1) break;
+
+        // Refresh the factory's cached collection before waiting again,
+        // and drop the session's copy of the old state
+        IDWriteFontCollection* pFreshCollection = nullptr;
+        if (SUCCEEDED(static_cast<IDWriteFactory*>(pDWriteFactory6)->GetSystemFontCollection(&pFreshCollection, TRUE))) {
+            pFreshCollection->Release();
+        }
+        InvalidateFontSession();
+        PostMessageW(g_hWnd, WM_APP_FONTS_EXPIRED, 0, 0);
+    }
+
+    pDWriteFactory6->Release();
+}
+
+/*
+ * Starts and stops the font collection watcher thread
+ */
+void StartFontWatcher()
+{
+    g_hWatcherStop = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (g_hWatcherStop) {
+        g_watcherThread = std::thread(FontCollectionWatcherProc);
+    }
+}
+
+void StopFontWatcher()
+{
+    if (g_hWatcherStop) {
+        SetEvent(g_hWatcherStop);
+        if (g_watcherThread.joinable()) {
+            g_watcherThread.join();
+        }
+        CloseHandle(g_hWatcherStop);
+        g_hWatcherStop = NULL;
+    }
+}
+
+// ============================================================================
+// DEFERRED FACE DETAILS - Monospace flag and axes, read on demand
+// ============================================================================
+
+/*
+ * FontDetailsBatch - Details computed by the details worker
+ *
+ * Posted via WM_APP_FONT_DETAILS; the UI thread takes ownership.
+ */
+struct FontDetailsBatch {
+    UINT generation = 0;
+    std::vector<FontDetails> details;
+};
+
+/*
+ * DetailRequest - A face whose details should be read
+ *
+ * Carries its own copy of the location so the worker never touches
+ * g_fonts.
+ */
+struct DetailRequest {
+    UINT32 fontIndex;
+    UINT32 faceIndex;
+    std::wstring filePath;
+};
+
+/*
+ * State shared with the details worker, guarded by g_detailMutex
+ *
+ * Visible rows (from LVN_ODCACHEHINT) are queued in front of the
+ * background sweep. Requests refer to g_fonts indices, so every reorder
+ * of g_fonts starts a new generation, which drops queued requests and
+ * makes the UI thread discard results still in flight.
+ */
+std::mutex g_detailMutex;
+std::condition_variable g_detailWake;
+std::deque<DetailRequest> g_detailVisible;  // Rows on screen, served first
+std::deque<DetailRequest> g_detailSweep;    // Every other pending face
+std::vector<bool> g_detailDone;             // Indices already read this generation
+UINT g_detailGeneration = 0;
+bool g_detailStop = false;
+std::thread g_detailThread;
+size_t g_detailsPending = 0;                // Faces still pending (UI thread)
+
+/*
+ * Details worker - reads face details from the font files
+ *
+ * Runs below normal priority so the sweep doesn't compete with the UI.
+ * Results are posted in batches of DETAIL_BATCH_SIZE, or immediately
+ * once the visible rows are done.
+ */
+void DetailThreadProc()
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+    IDWriteFactory* pDWriteFactory = nullptr;
+    IDWriteFactory3* pDWriteFactory3 = nullptr;
+    if (FAILED(GetSessionFactory(&pDWriteFactory)) ||
+        FAILED(pDWriteFactory->QueryInterface(__uuidof(IDWriteFactory3), (void**)&pDWriteFactory3))) {
+        pDWriteFactory3 = nullptr;  // Requests still complete, with empty details
+    }
+    if (pDWriteFactory) pDWriteFactory->Release();
+
+    std::unique_ptr<FontDetailsBatch> batch;
+    auto post = [&]() {
+        if (batch && !batch->details.empty() &&
+            PostMessageW(g_hWnd, WM_APP_FONT_DETAILS, batch->generation,
+                reinterpret_cast<LPARAM>(batch.get()))) {
+            batch.release();  // Owned by the UI thread now
+        }
+        batch.reset();
+    };
+
+    std::unique_lock<std::mutex> lock(g_detailMutex);
+    for (;;) {
+        if (g_detailVisible.empty() && g_detailSweep.empty()) {
+            lock.unlock();
+            post();
+            ReleaseSessionFiles();  // Sweep done; the next one starts a new cache
+            lock.lock();
+            g_detailWake.wait(lock, [] {
+                return g_detailStop || !g_detailVisible.empty() || !g_detailSweep.empty();
+            });
+        }
+        if (g_detailStop) break;
+
+        bool visible = !g_detailVisible.empty();
+        std::deque<DetailRequest>& queue = visible ? g_detailVisible : g_detailSweep;
+        DetailRequest request = std::move(queue.front());
+        queue.pop_front();
+        if (request.fontIndex >= g_detailDone.size()) {
+            g_detailDone.resize(request.fontIndex + 1);
+        }
+        if (g_detailDone[request.fontIndex]) continue;
+        g_detailDone[request.fontIndex] = true;
+        UINT generation = g_detailGeneration;
+        bool visibleDone = visible && g_detailVisible.empty();
+        lock.unlock();
+
+        if (batch && batch->generation != generation) {
+            post();
+        }
+        if (!batch) {
+            batch = std::make_unique<FontDetailsBatch>();
+            batch->generation = generation;
+            batch->details.reserve(DETAIL_BATCH_SIZE);
+        }
+
+        // Faces of one file share the session's file reference, and
+        // named instances its font resource
+        FontDetails details;
+        details.fontIndex = request.fontIndex;
+        IDWriteFontResource* pFontResource = GetSessionFontResource(request.filePath, request.faceIndex);
+        IDWriteFontFaceReference* pFontFaceRef = nullptr;
+        if (pFontResource) {
+            ReadFontResourceDetails(pFontResource, details);
+            pFontResource->Release();
+        } else if (pDWriteFactory3 && SUCCEEDED(pDWriteFactory3->CreateFontFaceReference(
+                request.filePath.c_str(), NULL, request.faceIndex,
+                DWRITE_FONT_SIMULATIONS_NONE, &pFontFaceRef))) {
+            ReadFontFaceDetails(pFontFaceRef, details);
+            pFontFaceRef->Release();
+        }
+        batch->details.push_back(std::move(details));
+
+        if (visibleDone || batch->details.size() >= DETAIL_BATCH_SIZE) {
+            post();
+        }
+        lock.lock();
+    }
+    lock.unlock();
+
+    if (pDWriteFactory3) pDWriteFactory3->Release();
+}
+
+/*
+ * Starts a new details generation for the current g_fonts order and
+ * queues every pending face for the background sweep
+ *
+ * Called whenever g_fonts is replaced or reordered.
+ */
+void StartDetailSweep()
+{
+    std::deque<DetailRequest> sweep;
+    g_detailsPending = 0;
+    for (size_t i = 0; i < g_fonts.size(); i++) {
+        if (g_fonts.DetailsPending(i)) {
+            sweep.push_back({ static_cast<UINT32>(i), g_fonts.FaceIndex(i), std::wstring(g_fonts.Path(i)) });
+            g_detailsPending++;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_detailMutex);
+        g_detailGeneration++;
+        g_detailVisible.clear();
+        g_detailSweep.swap(sweep);
+        g_detailDone.assign(g_fonts.size(), false);
+    }
+    g_detailWake.notify_one();
+}
+
+/*
+ * Handles LVN_ODCACHEHINT - queues the rows about to be displayed
+ * ahead of the background sweep
+ */
+void OnCacheHint(const NMLVCACHEHINT* pHint)
+{
+    std::deque<DetailRequest> visible;
+    for (int row = pHint->iFrom; row <= pHint->iTo; row++) {
+        if (row < 0 || static_cast<size_t>(row) >= g_filteredIndices.size()) continue;
+        size_t font = g_filteredIndices[row];
+        if (g_fonts.DetailsPending(font)) {
+            visible.push_back({ static_cast<UINT32>(font), g_fonts.FaceIndex(font), std::wstring(g_fonts.Path(font)) });
+        }
+    }
+    if (visible.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(g_detailMutex);
+        g_detailVisible.swap(visible);  // Replaces the previous, scrolled-away hint
+    }
+    g_detailWake.notify_one();
+}
+
+/*
+ * Handles WM_APP_FONT_DETAILS - stores a batch of details and repaints
+ * the visible rows
+ *
+ * Once every face is resolved the snapshot is rewritten, so the next
+ * start doesn't have to read the details again.
+ */
+void OnFontDetails(FontDetailsBatch* pBatch)
+{
+    std::unique_ptr<FontDetailsBatch> batch(pBatch);
+    if (batch->generation != g_detailGeneration) {
+        return;  // g_fonts was reordered since the request
+    }
+
+    // Rows visible while streaming are resolved before the sweep counts them
+    size_t pendingBefore = g_detailsPending;
+    for (const auto& details : batch->details) {
+        if (details.fontIndex < g_fonts.size() && g_fonts.DetailsPending(details.fontIndex)) {
+            g_fonts.SetDetails(details.fontIndex, details);
+            if (g_detailsPending > 0) g_detailsPending--;
+        }
+    }
+    InvalidateSortOrders(4);    // Fixed pitch and axes changed; the rows
+    InvalidateSortOrders(6);    // keep their order until the next sort
+
+    int top = ListView_GetTopIndex(g_hListView);
+    ListView_RedrawItems(g_hListView, top, top + ListView_GetCountPerPage(g_hListView));
+
+    if (pendingBefore > 0 && g_detailsPending == 0 && !g_enumJob && g_query.usesDetails) {
+        g_appliedFilterValid = false;   // Pending faces failed mono:/var: tests
+        ApplyFilter();
+    }
+    if (pendingBefore > 0 && g_detailsPending == 0 && !g_enumJob && g_currentMode != EnumMode::None) {
+        SaveSnapshot(g_currentMode, g_fontsFingerprint, g_fonts);
+        PublishFontInventory();     // Now with fixed pitch and axes
+    }
+}
+
+/*
+ * Starts and stops the details worker thread
+ */
+void StartDetailWorker()
+{
+    g_detailStop = false;
+    g_detailThread = std::thread(DetailThreadProc);
+}
+
+void StopDetailWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_detailMutex);
+        g_detailStop = true;
+    }
+    g_detailWake.notify_one();
+    if (g_detailThread.joinable()) {
+        g_detailThread.join();
+    }
+}
+
+// ============================================================================
+// COVERAGE RESULTS - Coverage builder messages on the UI thread
+// ============================================================================
+
+/*
+ * Handles WM_APP_COVERAGE_BATCH - adds a batch of range sets to the index
+ *
+ * Only the already resolved faces of the batch's keys are updated; the
+ * rest of g_faceCoverage stays valid, so a covers: query typed during
+ * the build doesn't resolve every face again per batch.
+ */
+void OnCoverageBatch(CoverageBatch* pBatch)
+{
+    std::unique_ptr<CoverageBatch> batch(pBatch);
+    if (!g_coverageJob || batch->generation != g_coverageJob->generation) {
+        return;  // From a cancelled build
+    }
+    for (const auto& result : batch->results) {
+        UINT32 set = g_coverage.AddSet(result.second);
+        g_coverage.SetFace(result.first, set);
+
+        auto pending = g_faceCoveragePending.find(result.first);
+        if (pending == g_faceCoveragePending.end()) continue;
+        for (UINT32 fontIndex : pending->second) {
+            g_faceCoverage[fontIndex] = set;
+        }
+        g_faceCoveragePending.erase(pending);
+    }
+}
+
+/*
+ * Handles WM_APP_COVERAGE_DONE - saves the index and refreshes a
+ * covers: filter that was answered from the partial index
+ */
+void OnCoverageDone(UINT generation)
+{
+    if (!g_coverageJob || generation != g_coverageJob->generation) {
+        return;
+    }
+    bool cancelled = g_coverageJob->cancelled;
+    CancelCoverageBuild();      // Joins the finished thread
+    if (cancelled) return;
+
+    SaveCoverage();             // Written by the data file writer
+    if (g_query.usesCoverage) {
+        g_appliedFilterValid = false;
+        ApplyFilter();
+    }
+}
+
+// ============================================================================
+// DUPLICATE RESULTS - Duplicate finder messages on the UI thread
+// ============================================================================
+
+/*
+ * Handles WM_APP_DUPLICATES_DONE - updates the hash cache, regroups
+ * the files and refreshes the Duplicates column and a dup: filter
+ */
+void OnDuplicatesDone(UINT generation)
+{
+    if (!g_duplicateJob || generation != g_duplicateJob->generation) {
+        return;
+    }
+    if (g_duplicateThread.joinable()) {
+        g_duplicateThread.join();
+    }
+    std::unique_ptr<DuplicateJob> job = std::move(g_duplicateJob);
+    if (job->cancelled) return;
+
+    // Files with the same size and hash, numbered in list order
+    std::unordered_map<UINT64, std::vector<size_t>> byContent;
+    std::vector<UINT64> contentOrder;
+    for (size_t i = 0; i < job->paths.size(); i++) {
+        const FileHashEntry& entry = job->entries[i];
+        if (entry.hashed) {
+            g_fileHashes[job->keys[i]] = entry;
+            UINT64 content = HashBytes(entry.hash, &entry.size, sizeof(entry.size));
+            auto& files = byContent[content];
+            if (files.empty()) contentOrder.push_back(content);
+            files.push_back(i);
+        } else {
+            g_fileHashes.erase(job->keys[i]);
+        }
+    }
+
+    std::vector<UINT32> entryGroups(job->paths.size(), 0);
+    g_duplicateGroupSizes.assign(1, 0);
+    for (UINT64 content : contentOrder) {
+        const std::vector<size_t>& files = byContent[content];
+        if (files.size() < 2) continue;
+        UINT32 group = static_cast<UINT32>(g_duplicateGroupSizes.size());
+        g_duplicateGroupSizes.push_back(static_cast<UINT32>(files.size()));
+        for (size_t i : files) {
+            entryGroups[i] = group;
+        }
+    }
+    g_duplicateGroups.assign(job->pathEntries.size(), 0);
+    for (size_t pathId = 0; pathId < job->pathEntries.size(); pathId++) {
+        UINT32 entry = job->pathEntries[pathId];
+        if (entry != UINT32_MAX) g_duplicateGroups[pathId] = entryGroups[entry];
+    }
+    InvalidateSortOrders(LIST_COLUMN_DUPLICATES);
+
+    if (job->filesHashed > 0) {
+        SaveFileHashes();           // Written by the data file writer
+    }
+    if (g_query.usesDuplicates) {
+        g_appliedFilterValid = false;
+        ApplyFilter();
+    } else {
+        InvalidateRect(g_hListView, NULL, FALSE);
+        UpdateStatusText();
+    }
+}
+
+// ============================================================================
+// FAMILY GROUP RESULTS - Face loader messages and group expansion
+// ============================================================================
+
+/*
+ * Rebuilds the rows after the groups changed, keeping the selection
+ */
+void RefreshGroupRows()
+{
+    int selectedRow = ListView_GetNextItem(g_hListView, -1, LVNI_SELECTED);
+    size_t selected = selectedRow >= 0 && static_cast<size_t>(selectedRow) < g_filteredIndices.size()
+        ? g_filteredIndices[selectedRow] : SIZE_MAX;
+
+    g_appliedFilterValid = false;
+    ApplyFilter();
+
+    int row = FindRowForFont(selected);
+    if (row >= 0) {
+        ListView_SetItemState(g_hListView, row, LVIS_SELECTED | LVIS_FOCUSED, LVIS_SELECTED | LVIS_FOCUSED);
+        ListView_EnsureVisible(g_hListView, row, FALSE);
+    }
+}
+
+/*
+ * Handles WM_APP_FAMILY_FACES - appends loaded faces to g_fonts
+ *
+ * The rows only change when an expanded family arrived; faces of
+ * collapsed groups are picked up by the next filter or sort.
+ */
+void OnFamilyFaces(UINT generation, FamilyFacesBatch* pBatch)
+{
+    std::unique_ptr<FamilyFacesBatch> batch(pBatch);
+    if (!g_familyFaceJob || generation != g_familyFaceJob->generation) {
+        return;
+    }
+
+    size_t first = g_fonts.size();
+    for (const auto& font : batch->fonts) {
+        g_fonts.Add(font);
+    }
+    AppendSearchIndex(first);
+    InvalidateSortOrders(-1);
+    g_appliedFilterValid = false;
+
+    bool expanded = false;
+    for (const auto& family : batch->families) {
+        auto it = g_familyGroups.find(g_fonts.Pool().Find(family));
+        if (it == g_familyGroups.end() || it->second.loaded) continue;
+        it->second.loaded = true;
+        expanded |= it->second.expanded;
+        g_familyGroupsLoaded++;
+    }
+
+    if (expanded) {
+        RefreshGroupRows();
+    } else {
+        UpdateStatusText();
+    }
+}
+
+/*
+ * Handles WM_APP_FAMILY_FACES_DONE - refilters with every face known
+ * and brings the background indexes and the published list up to date
+ */
+void OnFamilyFacesDone(UINT generation)
+{
+    if (!g_familyFaceJob || generation != g_familyFaceJob->generation) {
+        return;
+    }
+    bool cancelled = g_familyFaceJob->cancelled;
+    CancelFamilyFaceLoad();     // Joins the finished thread
+    if (cancelled) return;
+
+    StartFamilyFaceLoad();      // Groups expanded after the loader's last pick-up
+    if (!g_query.terms.empty()) {
+        RefreshGroupRows();
+    } else {
+        UpdateStatusText();
+    }
+    StartCoverageBuild();
+    StartDuplicateScan();
+    PublishFontInventory();
+}
+
+/*
+ * Expands or collapses the group shown in row (Enter, double-click,
+ * Right / Left arrow); returns false if row isn't a group row
+ */
+bool ToggleFamilyGroup(int row, bool expand)
+{
+    if (row < 0 || static_cast<size_t>(row) >= g_filteredIndices.size()) return false;
+    size_t font = g_filteredIndices[row];
+    auto it = g_familyGroups.find(g_fonts.FamilyId(font));
+    if (!g_fonts.IsGroup(font) || it == g_familyGroups.end()) return false;
+    if (it->second.expanded == expand) return true;
+
+    it->second.expanded = expand;
+    if (expand && !it->second.loaded) {
+        RequestFamilyFaces(g_fonts.Family(font));
+    }
+    RefreshGroupRows();
+    return true;
+}
+
+// ============================================================================
+// UI UPDATE FUNCTIONS
+// ============================================================================
+
+/*
+ * Updates the status label with current font count, or with the
+ * progress of a running enumeration
+ */
+void UpdateStatusText()
+{
+    wchar_t status[256];
+    const wchar_t* modeStr = GetModeName(g_currentMode);
+
+    if (g_enumJob && g_enumJob->revalidateOnly) {
+        swprintf_s(status, L"%s Enumeration: Showing %zu of %zu fonts (cached, verifying...)",
+            modeStr, g_filteredIndices.size(), g_fonts.size());
+    } else if (g_enumJob && g_enumJob->rescan) {
+        swprintf_s(status, L"%s Enumeration: Showing %zu of %zu fonts (fonts changed, rescanning...)",
+            modeStr, g_filteredIndices.size(), g_fonts.size());
+    } else if (g_enumJob) {
+        if (g_enumTotal > 0) {
+            swprintf_s(status, L"%s Enumeration: Loading... %zu fonts (%u of %u)",
+                modeStr, g_fonts.size(), g_enumProcessed, g_enumTotal);
+        } else {
+            swprintf_s(status, L"%s Enumeration: Loading... %zu fonts", modeStr, g_fonts.size());
+        }
+    } else {
+        wchar_t suffix[160] = L"";
+        if (g_rescanAdded || g_rescanRemoved) {
+            swprintf_s(suffix, L" (+%zu / -%zu after font change)", g_rescanAdded, g_rescanRemoved);
+        } else if (g_fontsFromSnapshot) {
+            wcscpy_s(suffix, L" (cached)");
+        }
+        if (g_coverageJob && g_query.usesCoverage) {
+            wcscat_s(suffix, L" (indexing coverage...)");
+        }
+        if (g_duplicateJob && g_query.usesDuplicates) {
+            wcscat_s(suffix, L" (finding duplicates...)");
+        }
+        if (g_familyFaceJob) {
+            wchar_t loading[48];
+            swprintf_s(loading, L" (faces: %zu of %zu families)", g_familyGroupsLoaded, g_familyGroups.size());
+            wcscat_s(suffix, loading);
+        }
+
+        if (g_filterText.empty()) {
+            swprintf_s(status, L"%s Enumeration: Found %zu fonts%s", modeStr, g_fonts.size(), suffix);
+        } else {
+            swprintf_s(status, L"%s Enumeration: Showing %zu of %zu fonts%s",
+                modeStr, g_filteredIndices.size(), g_fonts.size(), suffix);
+        }
+    }
+    SetWindowTextW(g_hStatusLabel, status);
+}
+
+/*
+ * Presence columns (subitems 8-10) of the All APIs mode
+ */
+struct SourceColumn {
+    const wchar_t* title;
+    BYTE source;
+};
+
+#define SOURCE_COLUMN_COUNT 3
+
+const SourceColumn g_sourceColumns[SOURCE_COLUMN_COUNT] = {
+    { L"GDI", FONT_SOURCE_GDI },
+    { L"DirectWrite", FONT_SOURCE_DWRITE },
+    { L"FontSet", FONT_SOURCE_FONTSET },
+};
+bool g_sourceColumnsShown = false;
+
+/*
+ * Handles LVN_GETDISPINFO for the owner-data ListView
+ *
+ * The control stores no strings of its own: row i is answered directly
+ * from g_fonts[g_filteredIndices[i]]. Plain strings are returned by
+ * pointer; formatted columns are written into the control's buffer.
+ */
+void OnGetDispInfo(NMLVDISPINFOW* pDispInfo)
+{
+    LVITEMW& item = pDispInfo->item;
+    if (!(item.mask & LVIF_TEXT) || item.iItem < 0 ||
+        static_cast<size_t>(item.iItem) >= g_filteredIndices.size()) {
+        return;
+    }
+
+    size_t font = g_filteredIndices[item.iItem];
+    if (g_fonts.IsGroup(font) && item.iSubItem > 0) {
+        // Group rows show the face count in the Style column only
+        auto it = g_familyGroups.find(g_fonts.FamilyId(font));
+        if (item.iSubItem == 1 && it != g_familyGroups.end() && item.cchTextMax > 0) {
+            swprintf_s(item.pszText, item.cchTextMax, L"%s %u %s", it->second.expanded ? L"\u25BE" : L"\u25B8",
+                it->second.faceCount, it->second.faceCount == 1 ? L"face" : L"faces");
+        } else {
+            item.pszText = const_cast<LPWSTR>(L"");
+        }
+        return;
+    }
+    switch (item.iSubItem) {
+    case 0:
+        item.pszText = const_cast<LPWSTR>(g_fonts.Family(font).data());
+        break;
+    case 1:
+        item.pszText = const_cast<LPWSTR>(g_fonts.Style(font).data());
+        break;
+    case 2:
+        if (item.cchTextMax > 0) {
+            swprintf_s(item.pszText, item.cchTextMax, L"%d", g_fonts.Weight(font));
+        }
+        break;
+    case 3:
+        item.pszText = const_cast<LPWSTR>(g_fonts.IsItalic(font) ? L"Yes" : L"No");
+        break;
+    case 4:
+        if (g_fonts.DetailsPending(font)) {
+            item.pszText = const_cast<LPWSTR>(L"");  // Filled in by OnFontDetails
+        } else {
+            item.pszText = const_cast<LPWSTR>(g_fonts.IsFixedPitch(font) ? L"Yes" : L"No");
+        }
+        break;
+    case 5:
+        item.pszText = const_cast<LPWSTR>(g_fonts.Path(font).data());
+        break;
+    case 6:
+        // Variable font info - show "Yes" with axes or empty
+        if (!g_fonts.IsVariable(font)) {
+            item.pszText = const_cast<LPWSTR>(L"");
+        } else if (item.cchTextMax > 0) {
+            _snwprintf_s(item.pszText, item.cchTextMax, _TRUNCATE, L"Yes: %s", g_fonts.Axes(font).data());
+        }
+        break;
+    case LIST_COLUMN_DUPLICATES:
+        if (UINT32 group = GetFontDuplicateGroup(font)) {
+            if (item.cchTextMax > 0) {
+                swprintf_s(item.pszText, item.cchTextMax, L"#%u (%u files)", group, g_duplicateGroupSizes[group]);
             }
-            pFontFile->Release();
+        } else {
+            item.pszText = const_cast<LPWSTR>(L"");
+        }
+        break;
+    case LIST_COLUMN_SOURCES:
+    case LIST_COLUMN_SOURCES + 1:
+    case LIST_COLUMN_SOURCES + 2:
+        // Per-API presence (All APIs mode only, see ShowSourceColumns)
+        item.pszText = const_cast<LPWSTR>(
+            (g_fonts.Sources(font) & g_sourceColumns[item.iSubItem - LIST_COLUMN_SOURCES].source) ? L"Yes" : L"");
+        break;
+    }
+}
+
+/*
+ * Adds or removes the per-API presence columns shown in All APIs mode
+ */
+void ShowSourceColumns(bool show)
+{
+    if (show == g_sourceColumnsShown) return;
+    g_sourceColumnsShown = show;
+    if (!show && g_sortColumn >= LIST_COLUMN_SOURCES) {
+        g_sortColumn = -1;      // Sorted by a column that is going away
+    }
+
+    for (int c = 0; c < SOURCE_COLUMN_COUNT; c++) {
+        if (show) {
+            LVCOLUMNW col = {};
+            col.mask = LVCF_TEXT | LVCF_WIDTH | LVCF_SUBITEM;
+            col.pszText = const_cast<LPWSTR>(g_sourceColumns[c].title);
+            col.cx = 70;
+            col.iSubItem = LIST_COLUMN_SOURCES + c;
+            ListView_InsertColumn(g_hListView, LIST_COLUMN_SOURCES + c, &col);
+        } else {
+            ListView_DeleteColumn(g_hListView, LIST_COLUMN_SOURCES);
         }
+    }
+    UpdateSortArrows();
+}
 
-        // --- Extract font properties from the font set ---
+/*
+ * Populates the ListView with filtered font data
+ *
+ * The ListView is virtual (LVS_OWNERDATA), so this only resets the item
+ * count and clears the selection; rows are fetched via LVN_GETDISPINFO.
+ */
+void PopulateListView()
+{
+    GUID activity;
+    bool tracing = BeginTraceActivity(activity);
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "PopulateListView", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_START),
+            TraceLoggingUInt64(g_filteredIndices.size(), "Items"));
+    }
 
-        // Get family name
-        IDWriteLocalizedStrings* pFamilyNames = nullptr;
-        BOOL exists = FALSE;
-        hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_FAMILY_NAME, &exists, &pFamilyNames);
-        if (SUCCEEDED(hr) && exists && pFamilyNames) {
-            UINT32 index = 0;
-            BOOL found = FALSE;
-            pFamilyNames->FindLocaleName(L"en-us", &index, &found);
-            if (!found) index = 0;
-
-            UINT32 length = 0;
-            pFamilyNames->GetStringLength(index, &length);
-            info.familyName.resize(length + 1);
-            pFamilyNames->GetString(index, &info.familyName[0], length + 1);
-            info.familyName.resize(length);
-            pFamilyNames->Release();
-        }
+    g_prefixIndex.rowsValid = false;
+    ListView_SetItemState(g_hListView, -1, 0, LVIS_SELECTED | LVIS_FOCUSED);
+    ListView_SetItemCountEx(g_hListView, static_cast<int>(g_filteredIndices.size()), 0);
 
-        // Get style/face name
-        IDWriteLocalizedStrings* pFaceNames = nullptr;
-        hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_FACE_NAME, &exists, &pFaceNames);
-        if (SUCCEEDED(hr) && exists && pFaceNames) {
-            UINT32 index = 0;
-            BOOL found = FALSE;
-            pFaceNames->FindLocaleName(L"en-us", &index, &found);
-            if (!found) index = 0;
-
-            UINT32 length = 0;
-            pFaceNames->GetStringLength(index, &length);
-            info.styleName.resize(length + 1);
-            pFaceNames->GetString(index, &info.styleName[0], length + 1);
-            info.styleName.resize(length);
-            pFaceNames->Release();
-        }
-
-        // Get weight
-        IDWriteLocalizedStrings* pWeightStr = nullptr;
-        hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_WEIGHT, &exists, &pWeightStr);
-        if (SUCCEEDED(hr) && exists && pWeightStr) {
-            wchar_t weightBuf[32] = {};
-            pWeightStr->GetString(0, weightBuf, 32);
-            info.weight = _wtoi(weightBuf);
-            pWeightStr->Release();
-        } else {
-            info.weight = 400;  // Default to normal weight
-        }
-
-        // Get style (italic/oblique)
-        IDWriteLocalizedStrings* pStyleStr = nullptr;
-        hr = pFontSet->GetPropertyValues(i, DWRITE_FONT_PROPERTY_ID_STYLE, &exists, &pStyleStr);
-        if (SUCCEEDED(hr) && exists && pStyleStr) {
-            wchar_t styleBuf[32] = {};
-            pStyleStr->GetString(0, styleBuf, 32);
-            int style = _wtoi(styleBuf);
-            info.italic = (style == DWRITE_FONT_STYLE_ITALIC || style == DWRITE_FONT_STYLE_OBLIQUE);
-            pStyleStr->Release();
-        } else {
-            info.italic = false;
+    if (tracing) {
+        TraceLoggingWriteActivity(g_traceProvider, "PopulateListView", &activity, NULL,
+            TraceLoggingOpcode(WINEVENT_OPCODE_STOP));
+    }
+}
+
+// ============================================================================
+// PREVIEW PANEL
+// ============================================================================
+//
+// Drawn with Direct2D from a text layout that is built once per selection
+// (and only re-wrapped when the panel is resized). Faces with a file are
+// previewed from a collection holding just that file, so the preview
+// shows exactly the selected face.
+//
+// Variable fonts get a slider per axis. Moving one changes the layout's
+// axis values (IDWriteTextLayout4::SetFontAxisValues, Windows 10 1903+),
+// so DirectWrite only swaps the font instance: no font or layout is
+// created per tick, and WM_PAINT with vsync'd presents paces the redraws
+// to the display refresh rate.
+
+#define PREVIEW_FONT_SIZE       28.0f   // DIPs
+#define PREVIEW_MAX_AXES        6       // Sliders created up front
+#define PREVIEW_AXIS_ROW_HEIGHT 30      // Pixels per slider row
+#define PREVIEW_AXIS_LABEL_WIDTH 90
+#define PREVIEW_AXIS_SCALE      10      // Slider positions per axis unit
+
+/*
+ * PreviewAxis - A variable axis of the selected face and its slider value
+ */
+struct PreviewAxis {
+    DWRITE_FONT_AXIS_TAG tag;
+    float minValue;
+    float maxValue;
+    float value;
+};
+
+// Direct2D / DirectWrite objects for the panel (UI thread)
+ID2D1Factory* g_d2dFactory = nullptr;
+ID2D1HwndRenderTarget* g_previewTarget = nullptr;
+ID2D1SolidColorBrush* g_previewTextBrush = nullptr;
+ID2D1SolidColorBrush* g_previewGrayBrush = nullptr;
+IDWriteFactory* g_previewDWriteFactory = nullptr;
+IDWriteTextFormat* g_previewPlaceholderFormat = nullptr;
+
+// The current selection's layout and the font it is drawn with
+IDWriteTextLayout* g_previewLayout = nullptr;
+IDWriteTextLayout4* g_previewLayout4 = nullptr;     // NULL before Windows 10 1903
+IDWriteFontCollection* g_previewCollection = nullptr;  // NULL: system collection
+std::wstring g_previewFamily;               // Family name in g_previewCollection
+DWRITE_FONT_WEIGHT g_previewWeight = DWRITE_FONT_WEIGHT_NORMAL;
+DWRITE_FONT_STYLE g_previewStyle = DWRITE_FONT_STYLE_NORMAL;
+D2D1_SIZE_F g_previewLayoutSize = {};       // Max width / height the layout wraps to
+std::vector<PreviewAxis> g_previewAxes;
+
+HWND g_hAxisLabels[PREVIEW_MAX_AXES] = {};
+HWND g_hAxisSliders[PREVIEW_MAX_AXES] = {};
+int g_axisSliderRows = 0;                   // Sliders shown (rows taken from the preview)
+
+/*
+ * Creates the factories and the placeholder format on first use
+ */
+bool EnsurePreviewFactories()
+{
+    if (!g_d2dFactory && FAILED(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &g_d2dFactory))) {
+        g_d2dFactory = nullptr;
+        return false;
+    }
+    if (!g_previewDWriteFactory) {
+        if (FAILED(DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory),
+                reinterpret_cast<IUnknown**>(&g_previewDWriteFactory)))) {
+            g_previewDWriteFactory = nullptr;
+            return false;
+        }
+        if (SUCCEEDED(g_previewDWriteFactory->CreateTextFormat(L"Segoe UI", NULL,
+                DWRITE_FONT_WEIGHT_NORMAL, DWRITE_FONT_STYLE_NORMAL, DWRITE_FONT_STRETCH_NORMAL,
+                12.0f, L"", &g_previewPlaceholderFormat))) {
+            g_previewPlaceholderFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER);
+            g_previewPlaceholderFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
         }
+    }
+    return true;
+}
 
-        info.fixedPitch = false;  // FontSet doesn't directly expose this
-        info.charSet = DEFAULT_CHARSET;
-        info.isVariable = false;
+/*
+ * Releases the selection's layout, font collection and axes
+ */
+void ReleasePreviewLayout()
+{
+    if (g_previewLayout4) { g_previewLayout4->Release(); g_previewLayout4 = nullptr; }
+    if (g_previewLayout) { g_previewLayout->Release(); g_previewLayout = nullptr; }
+    if (g_previewCollection) { g_previewCollection->Release(); g_previewCollection = nullptr; }
+    g_previewAxes.clear();
+}
 
-        // --- Extract variable font axis information ---
-        // Requires creating a font face and querying IDWriteFontFace5
-        IDWriteFontFace3* pFontFace3 = nullptr;
-        if (SUCCEEDED(pFontFaceRef->CreateFontFace(&pFontFace3))) {
-            IDWriteFontFace5* pFontFace5 = nullptr;
-            if (SUCCEEDED(pFontFace3->QueryInterface(__uuidof(IDWriteFontFace5), (void**)&pFontFace5))) {
-                IDWriteFontResource* pFontResource = nullptr;
-                if (SUCCEEDED(pFontFace5->GetFontResource(&pFontResource))) {
-                    UINT32 axisCount = pFontResource->GetFontAxisCount();
-                    if (axisCount > 0) {
-                        std::vector<DWRITE_FONT_AXIS_RANGE> axisRanges(axisCount);
-                        if (SUCCEEDED(pFontResource->GetFontAxisRanges(axisRanges.data(), axisCount))) {
-                            // Check if any axis has a range (min != max means it's variable)
-                            for (UINT32 a = 0; a < axisCount; a++) {
-                                if (axisRanges[a].minValue != axisRanges[a].maxValue) {
-                                    info.isVariable = true;
-
-                                    // Build axis description string
-                                    if (!info.variableAxes.empty()) {
-                                        info.variableAxes += L", ";
-                                    }
-
-                                    // Convert 4-byte axis tag to string (e.g., "wght", "wdth")
-                                    DWRITE_FONT_AXIS_TAG tag = axisRanges[a].axisTag;
-                                    wchar_t tagStr[5] = {
-                                        (wchar_t)(tag & 0xFF),
-                                        (wchar_t)((tag >> 8) & 0xFF),
-                                        (wchar_t)((tag >> 16) & 0xFF),
-                                        (wchar_t)((tag >> 24) & 0xFF),
-                                        0
-                                    };
-
-                                    wchar_t axisBuf[64];
-                                    swprintf_s(axisBuf, L"%s %.0f-%.0f", tagStr,
-                                        axisRanges[a].minValue, axisRanges[a].maxValue);
-                                    info.variableAxes += axisBuf;
-                                }
-                            }
-                        }
+/*
+ * Releases the render target and its brushes (device resources)
+ */
+void ReleasePreviewTarget()
+{
+    if (g_previewTextBrush) { g_previewTextBrush->Release(); g_previewTextBrush = nullptr; }
+    if (g_previewGrayBrush) { g_previewGrayBrush->Release(); g_previewGrayBrush = nullptr; }
+    if (g_previewTarget) { g_previewTarget->Release(); g_previewTarget = nullptr; }
+}
+
+/*
+ * Releases everything the preview holds
+ *
+ * Called when the panel is destroyed.
+ */
+void ReleasePreviewCache()
+{
+    ReleasePreviewLayout();
+    ReleasePreviewTarget();
+    if (g_previewPlaceholderFormat) { g_previewPlaceholderFormat->Release(); g_previewPlaceholderFormat = nullptr; }
+    if (g_previewDWriteFactory) { g_previewDWriteFactory->Release(); g_previewDWriteFactory = nullptr; }
+    if (g_d2dFactory) { g_d2dFactory->Release(); g_d2dFactory = nullptr; }
+}
+
+/*
+ * Opens the selected face from its file: a one-face collection for the
+ * layout, the face's own weight and style, and its variable axes
+ */
+void LoadPreviewFace()
+{
+    IDWriteFactory3* pDWriteFactory3 = nullptr;
+    if (FAILED(g_previewDWriteFactory->QueryInterface(__uuidof(IDWriteFactory3), (void**)&pDWriteFactory3))) {
+        return;  // Windows 8.1: preview through the system collection
+    }
+
+    IDWriteFontFaceReference* pFontFaceRef = nullptr;
+    IDWriteFontFace3* pFontFace3 = nullptr;
+    if (SUCCEEDED(pDWriteFactory3->CreateFontFaceReference(g_selectedPath.c_str(), NULL,
+            g_selectedFaceIndex, DWRITE_FONT_SIMULATIONS_NONE, &pFontFaceRef)) &&
+        SUCCEEDED(pFontFaceRef->CreateFontFace(&pFontFace3))) {
+        g_fontFacesCreated++;
+        g_previewWeight = pFontFace3->GetWeight();
+        g_previewStyle = pFontFace3->GetStyle();
+
+        // Axes the font varies along and doesn't hide
+        IDWriteFontFace5* pFontFace5 = nullptr;
+        IDWriteFontResource* pResource = nullptr;
+        if (SUCCEEDED(pFontFace3->QueryInterface(__uuidof(IDWriteFontFace5), (void**)&pFontFace5)) &&
+            SUCCEEDED(pFontFace5->GetFontResource(&pResource))) {
+            UINT32 axisCount = pResource->GetFontAxisCount();
+            std::vector<DWRITE_FONT_AXIS_VALUE> defaults(axisCount);
+            std::vector<DWRITE_FONT_AXIS_RANGE> ranges(axisCount);
+            if (axisCount > 0 &&
+                SUCCEEDED(pResource->GetDefaultFontAxisValues(defaults.data(), axisCount)) &&
+                SUCCEEDED(pResource->GetFontAxisRanges(ranges.data(), axisCount))) {
+                for (UINT32 a = 0; a < axisCount && g_previewAxes.size() < PREVIEW_MAX_AXES; a++) {
+                    DWRITE_FONT_AXIS_ATTRIBUTES attributes = pResource->GetFontAxisAttributes(a);
+                    if (!(attributes & DWRITE_FONT_AXIS_ATTRIBUTES_VARIABLE) ||
+                        (attributes & DWRITE_FONT_AXIS_ATTRIBUTES_HIDDEN) ||
+                        ranges[a].minValue >= ranges[a].maxValue) {
+                        continue;
+                    }
+                    PreviewAxis axis = { ranges[a].axisTag, ranges[a].minValue, ranges[a].maxValue, defaults[a].value };
+                    if (axis.tag == DWRITE_FONT_AXIS_TAG_WEIGHT) {
+                        // Named instances share the file; start at the listed weight
+                        axis.value = (std::min)((std::max)(static_cast<float>(g_selectedWeight), axis.minValue), axis.maxValue);
                     }
-                    pFontResource->Release();
+                    g_previewAxes.push_back(axis);
                 }
-                pFontFace5->Release();
             }
-            pFontFace3->Release();
         }
+        if (pResource) pResource->Release();
+        if (pFontFace5) pFontFace5->Release();
+
+        // A collection of just this face, so the layout can't pick a namesake
+        IDWriteFontSetBuilder* pBuilder = nullptr;
+        IDWriteFontSet* pFontSet = nullptr;
+        IDWriteFontCollection1* pCollection = nullptr;
+        IDWriteFontFamily* pFamily = nullptr;
+        IDWriteLocalizedStrings* pNames = nullptr;
+        UINT32 length = 0;
+        if (SUCCEEDED(pDWriteFactory3->CreateFontSetBuilder(&pBuilder)) &&
+            SUCCEEDED(pBuilder->AddFontFaceReference(pFontFaceRef)) &&
+            SUCCEEDED(pBuilder->CreateFontSet(&pFontSet)) &&
+            SUCCEEDED(pDWriteFactory3->CreateFontCollectionFromFontSet(pFontSet, &pCollection)) &&
+            pCollection->GetFontFamilyCount() > 0 &&
+            SUCCEEDED(pCollection->GetFontFamily(0, &pFamily)) &&
+            SUCCEEDED(pFamily->GetFamilyNames(&pNames)) &&
+            SUCCEEDED(pNames->GetStringLength(0, &length))) {
+            std::wstring name(length + 1, L'\0');
+            if (SUCCEEDED(pNames->GetString(0, &name[0], length + 1))) {
+                name.resize(length);
+                g_previewFamily = std::move(name);
+                g_previewCollection = pCollection;
+                pCollection = nullptr;  // Owned by g_previewCollection
+            }
+        }
+        if (pNames) pNames->Release();
+        if (pFamily) pFamily->Release();
+        if (pCollection) pCollection->Release();
+        if (pFontSet) pFontSet->Release();
+        if (pBuilder) pBuilder->Release();
+    }
+    if (pFontFace3) pFontFace3->Release();
+    if (pFontFaceRef) pFontFaceRef->Release();
+    pDWriteFactory3->Release();
+}
+
+/*
+ * Applies the slider values to the layout (only the font instance changes)
+ */
+void ApplyPreviewAxisValues()
+{
+    if (!g_previewLayout4 || g_previewAxes.empty()) return;
+
+    DWRITE_FONT_AXIS_VALUE values[PREVIEW_MAX_AXES];
+    for (size_t a = 0; a < g_previewAxes.size(); a++) {
+        values[a].axisTag = g_previewAxes[a].tag;
+        values[a].value = g_previewAxes[a].value;
+    }
+    DWRITE_TEXT_RANGE all = { 0, UINT32_MAX };
+    g_previewLayout4->SetFontAxisValues(values, static_cast<UINT32>(g_previewAxes.size()), all);
+}
+
+/*
+ * Builds the text layout for the current selection
+ */
+bool BuildPreviewLayout(D2D1_SIZE_F size)
+{
+    IDWriteTextFormat* pFormat = nullptr;
+    if (FAILED(g_previewDWriteFactory->CreateTextFormat(g_previewFamily.c_str(), g_previewCollection,
+            g_previewWeight, g_previewStyle, DWRITE_FONT_STRETCH_NORMAL, PREVIEW_FONT_SIZE, L"", &pFormat))) {
+        return false;
+    }
+
+    // Preview text shows font name, style, and sample characters
+    std::wstring previewText = g_selectedFont + L" " + g_selectedStyle + L"\r\nAaBbCcDdEeFfGgHhIiJjKk\r\n0123456789 !@#$%";
+    g_previewLayoutSize = D2D1::SizeF((std::max)(size.width - 20, 1.0f), (std::max)(size.height - 20, 1.0f));
+    HRESULT hr = g_previewDWriteFactory->CreateTextLayout(previewText.c_str(),
+        static_cast<UINT32>(previewText.size()), pFormat,
+        g_previewLayoutSize.width, g_previewLayoutSize.height, &g_previewLayout);
+    pFormat->Release();
+    if (FAILED(hr)) {
+        g_previewLayout = nullptr;
+        return false;
+    }
+
+    if (FAILED(g_previewLayout->QueryInterface(__uuidof(IDWriteTextLayout4), (void**)&g_previewLayout4))) {
+        g_previewLayout4 = nullptr;
+    }
+    ApplyPreviewAxisValues();
+    return true;
+}
 
-        if (!info.familyName.empty()) {
-            g_fonts.push_back(info);
+/*
+ * Shows one slider per axis of the selected face and hides the rest
+ */
+void ShowAxisSliders()
+{
+    size_t shown = g_previewLayout4 ? g_previewAxes.size() : 0;    // Axis values need 1903+
+    for (size_t a = 0; a < PREVIEW_MAX_AXES; a++) {
+        bool visible = a < shown;
+        if (visible) {
+            const PreviewAxis& axis = g_previewAxes[a];
+            SendMessageW(g_hAxisSliders[a], TBM_SETRANGEMIN, FALSE, static_cast<LPARAM>(axis.minValue * PREVIEW_AXIS_SCALE));
+            SendMessageW(g_hAxisSliders[a], TBM_SETRANGEMAX, FALSE, static_cast<LPARAM>(axis.maxValue * PREVIEW_AXIS_SCALE));
+            SendMessageW(g_hAxisSliders[a], TBM_SETPOS, TRUE, static_cast<LPARAM>(axis.value * PREVIEW_AXIS_SCALE));
+            wchar_t label[32];
+            swprintf_s(label, L"%s %g", FormatAxisTag(axis.tag).c_str(), axis.value);
+            SetWindowTextW(g_hAxisLabels[a], label);
         }
+        ShowWindow(g_hAxisLabels[a], visible ? SW_SHOWNA : SW_HIDE);
+        ShowWindow(g_hAxisSliders[a], visible ? SW_SHOWNA : SW_HIDE);
+    }
+    g_axisSliderRows = static_cast<int>(shown);
+}
 
-        pFontFaceRef->Release();
+/*
+ * Prepares the preview for the selected font (g_selected*): opens the
+ * face, sets up the axis sliders and repaints
+ *
+ * Also called after font changes, since the face may have been replaced.
+ */
+void SelectPreviewFont()
+{
+    ReleasePreviewLayout();
+    if (!g_hPreviewStatic) return;  // Headless (benchmark) runs
+    if (!g_selectedFont.empty() && EnsurePreviewFactories()) {
+        g_previewFamily = g_selectedFont;
+        g_previewWeight = static_cast<DWRITE_FONT_WEIGHT>(g_selectedWeight);
+        g_previewStyle = g_selectedItalic ? DWRITE_FONT_STYLE_ITALIC : DWRITE_FONT_STYLE_NORMAL;
+        if (!g_selectedPath.empty()) {
+            LoadPreviewFace();
+        }
     }
 
-    pFontSet->Release();
-    pDWriteFactory3->Release();
+    // Built now rather than on the next paint: the sliders depend on
+    // whether the layout takes axis values
+    if (!g_selectedFont.empty() && g_previewDWriteFactory) {
+        RECT rect;
+        GetClientRect(g_hPreviewStatic, &rect);
+        BuildPreviewLayout(D2D1::SizeF(static_cast<float>(rect.right - rect.left),
+            static_cast<float>(rect.bottom - rect.top)));
+    }
 
-    // Sort by family name, then by style name
-    std::sort(g_fonts.begin(), g_fonts.end(),
-        [](const FontInfo& a, const FontInfo& b) {
-            if (a.familyName != b.familyName)
-                return a.familyName < b.familyName;
-            return a.styleName < b.styleName;
-        });
+    int rowsBefore = g_axisSliderRows;
+    ShowAxisSliders();
+    if (g_axisSliderRows != rowsBefore) {
+        ResizeControls(g_hWnd);
+    }
+    UpdatePreview();
+}
 
-    g_currentMode = EnumMode::FontSet;
-    ApplyFilter();
+/*
+ * Handles WM_HSCROLL from an axis slider; returns false for other controls
+ */
+bool OnAxisSlider(HWND hSlider)
+{
+    for (size_t a = 0; a < g_previewAxes.size(); a++) {
+        if (g_hAxisSliders[a] != hSlider) continue;
+
+        PreviewAxis& axis = g_previewAxes[a];
+        float value = static_cast<float>(SendMessageW(hSlider, TBM_GETPOS, 0, 0)) / PREVIEW_AXIS_SCALE;
+        if (value != axis.value) {
+            axis.value = value;
+            wchar_t label[32];
+            swprintf_s(label, L"%s %g", FormatAxisTag(axis.tag).c_str(), axis.value);
+            SetWindowTextW(g_hAxisLabels[a], label);
+            ApplyPreviewAxisValues();
+            UpdatePreview();
+        }
+        return true;
+    }
+    return false;
 }
 
-// ============================================================================
-// FONT DATA MANAGEMENT
-// ============================================================================
+/*
+ * Triggers a repaint of the preview panel
+ *
+ * The preview is repainted in full by Direct2D, so no background erase
+ * is needed.
+ */
+void UpdatePreview()
+{
+    InvalidateRect(g_hPreviewStatic, NULL, FALSE);
+}
 
 /*
- * Clears all font data and resets selection state
- * Called before each new enumeration
+ * Draws the preview for the current selection into the render target
+ * (between BeginDraw and EndDraw)
  */
-void ClearFonts()
+void RenderPreview(D2D1_SIZE_F size, bool& layoutCached)
 {
-    g_fonts.clear();
-    g_filteredIndices.clear();
-    ListView_DeleteAllItems(g_hListView);
-    g_selectedFont.clear();
-    g_selectedStyle.clear();
-    g_selectedWeight = FW_NORMAL;
-    g_selectedItalic = false;
+    g_previewTarget->Clear(D2D1::ColorF(D2D1::ColorF::White));
+    g_previewTarget->DrawRectangle(D2D1::RectF(0.5f, 0.5f, size.width - 0.5f, size.height - 0.5f),
+        g_previewGrayBrush);
+
+    layoutCached = g_previewLayout != nullptr;
+    if (!g_selectedFont.empty()) {
+        if (!g_previewLayout) {
+            BuildPreviewLayout(size);
+        } else if (size.width - 20 != g_previewLayoutSize.width || size.height - 20 != g_previewLayoutSize.height) {
+            // Panel resized: re-wrap the existing layout
+            g_previewLayoutSize = D2D1::SizeF((std::max)(size.width - 20, 1.0f), (std::max)(size.height - 20, 1.0f));
+            g_previewLayout->SetMaxWidth(g_previewLayoutSize.width);
+            g_previewLayout->SetMaxHeight(g_previewLayoutSize.height);
+        }
+        if (g_previewLayout) {
+            g_previewTarget->PushAxisAlignedClip(D2D1::RectF(1, 1, size.width - 1, size.height - 1),
+                D2D1_ANTIALIAS_MODE_ALIASED);
+            g_previewTarget->DrawTextLayout(D2D1::Point2F(10, 10), g_previewLayout, g_previewTextBrush);
+            g_previewTarget->PopAxisAlignedClip();
+        }
+    } else if (g_previewPlaceholderFormat) {
+        // Show placeholder text when no font is selected
+        const wchar_t* placeholder = L"Select a font to preview";
+        g_previewTarget->DrawText(placeholder, static_cast<UINT32>(wcslen(placeholder)),
+            g_previewPlaceholderFormat, D2D1::RectF(0, 0, size.width, size.height), g_previewGrayBrush);
+    }
+}
+
+/*
+ * Creates the panel's render target and brushes if needed
+ */
+bool EnsurePreviewTarget(HWND hWnd)
+{
+    if (g_previewTarget) return true;
+    if (!EnsurePreviewFactories()) return false;
+
+    RECT rect;
+    GetClientRect(hWnd, &rect);
+    D2D1_SIZE_U pixelSize = D2D1::SizeU(rect.right - rect.left, rect.bottom - rect.top);
+    if (FAILED(g_d2dFactory->CreateHwndRenderTarget(D2D1::RenderTargetProperties(),
+            D2D1::HwndRenderTargetProperties(hWnd, pixelSize), &g_previewTarget))) {
+        g_previewTarget = nullptr;
+        return false;
+    }
+    g_previewTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), &g_previewTextBrush);
+    g_previewTarget->CreateSolidColorBrush(D2D1::ColorF(0.5f, 0.5f, 0.5f), &g_previewGrayBrush);
+    if (!g_previewTextBrush || !g_previewGrayBrush) {
+        ReleasePreviewTarget();
+        return false;
+    }
+    return true;
 }
 
 /*
- * Applies the current filter text to the font list
+ * Subclassed window procedure for the preview panel
  *
- * Creates a list of indices into g_fonts for fonts that match
- * the filter (case-insensitive search in family name or style name).
+ * Handles custom painting to display the selected font with its
+ * actual weight, style and axis values.
  */
-void ApplyFilter()
+LRESULT CALLBACK PreviewWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam,
+    UINT_PTR uIdSubclass, DWORD_PTR dwRefData)
 {
-    g_filteredIndices.clear();
+    switch (message) {
+    case WM_ERASEBKGND:
+        return 1;  // WM_PAINT covers the whole client area
 
-    for (size_t i = 0; i < g_fonts.size(); i++) {
-        const auto& font = g_fonts[i];
-        if (ContainsIgnoreCase(font.familyName, g_filterText) ||
-            ContainsIgnoreCase(font.styleName, g_filterText)) {
-            g_filteredIndices.push_back(i);
+    case WM_SIZE:
+        if (g_previewTarget) {
+            g_previewTarget->Resize(D2D1::SizeU(LOWORD(lParam), HIWORD(lParam)));
+        }
+        break;
+
+    case WM_PAINT:
+    {
+        PAINTSTRUCT ps;
+        BeginPaint(hWnd, &ps);
+
+        GUID activity;
+        bool tracing = BeginTraceActivity(activity);
+        if (tracing) {
+            RECT rect;
+            GetClientRect(hWnd, &rect);
+            TraceLoggingWriteActivity(g_traceProvider, "PreviewPaint", &activity, NULL,
+                TraceLoggingOpcode(WINEVENT_OPCODE_START),
+                TraceLoggingWideString(g_selectedFont.c_str(), "Family"),
+                TraceLoggingInt32(rect.right - rect.left, "Width"),
+                TraceLoggingInt32(rect.bottom - rect.top, "Height"));
+        }
+
+        bool layoutCached = false;
+        if (EnsurePreviewTarget(hWnd)) {
+            g_previewTarget->BeginDraw();
+            RenderPreview(g_previewTarget->GetSize(), layoutCached);
+            if (g_previewTarget->EndDraw() == D2DERR_RECREATE_TARGET) {
+                ReleasePreviewTarget();     // Device lost; recreated on the next paint
+                InvalidateRect(hWnd, NULL, FALSE);
+            }
+        }
+
+        if (tracing) {
+            TraceLoggingWriteActivity(g_traceProvider, "PreviewPaint", &activity, NULL,
+                TraceLoggingOpcode(WINEVENT_OPCODE_STOP),
+                TraceLoggingBool(layoutCached, "CachedLayout"),
+                TraceLoggingUInt32(static_cast<UINT32>(g_previewAxes.size()), "Axes"));
         }
+
+        EndPaint(hWnd, &ps);
+        return 0;
+    }
+    case WM_NCDESTROY:
+        // Clean up subclass when window is destroyed
+        ReleasePreviewCache();
+        RemoveWindowSubclass(hWnd, PreviewWndProc, uIdSubclass);
+        break;
     }
 
-    PopulateListView();
-    UpdateStatusText();
+    return DefSubclassProc(hWnd, message, wParam, lParam);
 }
 
 // ============================================================================
-// UI UPDATE FUNCTIONS
+// ROW THUMBNAILS - Family names rendered in their own font
 // ============================================================================
+//
+// The Font Family column shows each name in its font. A worker thread
+// renders the names with Direct2D/DirectWrite and the UI thread copies
+// them into one 8-bpp grayscale atlas bitmap, so custom draw is a single
+// BitBlt per row: SRCAND puts dark text on the window background and
+// MERGEPAINT light text on the selection highlight. Rows are shown as
+// plain text until their thumbnail arrives.
+//
+// Thumbnails are keyed by family, weight, slant and DPI, so faces that
+// look alike share one, and sorting or filtering never re-renders.
+// Requests come from painted rows, newest first; the atlas has a fixed
+// byte budget and evicts the least recently drawn thumbnail.
+
+#define THUMBNAIL_WIDTH         240             // DIPs; wider names are clipped
+#define THUMBNAIL_ROW_HEIGHT    26              // DIPs; also the list row height
+#define THUMBNAIL_FONT_SIZE     16.0f           // DIPs
+#define THUMBNAIL_CACHE_BYTES   (4 * 1024 * 1024)   // Atlas budget (8 bpp)
+#define THUMBNAIL_QUEUE_LIMIT   128             // Requests kept; older ones scrolled away
+#define THUMBNAIL_BATCH_SIZE    8               // Thumbnails per WM_APP_THUMBNAILS message
+#define THUMBNAIL_PENDING       UINT32_MAX      // Requested, not rendered yet
+#define THUMBNAIL_FAILED        (UINT32_MAX - 1)    // Renders as plain text
 
 /*
- * Updates the status label with current font count
+ * ThumbnailRequest - A name to render, with everything the worker needs
  */
-void UpdateStatusText()
+struct ThumbnailRequest {
+    std::wstring key;           // See MakeThumbnailKey
+    std::wstring family;
+    int weight = FW_NORMAL;
+    bool italic = false;
+    UINT generation = 0;        // g_thumbGeneration when requested
+};
+
+/*
+ * ThumbnailResult - A rendered name: width x height coverage bytes,
+ * 255 = background, 0 = ink (the SRCAND form); empty if rendering failed
+ */
+struct ThumbnailResult {
+    std::wstring key;
+    UINT generation = 0;
+    std::vector<BYTE> pixels;
+};
+
+struct ThumbnailBatch {
+    std::vector<ThumbnailResult> results;
+};
+
+/*
+ * ThumbnailSlot - One atlas row band and the thumbnail stored in it
+ */
+struct ThumbnailSlot {
+    std::wstring key;
+    UINT64 lastUsed = 0;
+};
+
+// Atlas and key map (UI thread)
+int g_thumbDpi = 96;                        // Of the list, when the controls were created
+SIZE g_thumbSize = {};                      // One thumbnail in pixels
+HDC g_thumbAtlasDC = NULL;                  // Memory DC with g_thumbAtlas selected
+HBITMAP g_thumbAtlas = NULL;                // Slots stacked vertically
+HBITMAP g_thumbAtlasOld = NULL;
+BYTE* g_thumbAtlasBits = nullptr;
+UINT32 g_thumbAtlasStride = 0;
+std::vector<ThumbnailSlot> g_thumbSlots;
+UINT32 g_thumbSlotCapacity = 0;
+std::unordered_map<std::wstring, UINT32> g_thumbIndex;  // Key -> slot, or PENDING / FAILED
+UINT64 g_thumbTick = 0;
+UINT g_thumbGeneration = 0;                 // Bumped when the cache is dropped
+HIMAGELIST g_hRowImageList = NULL;          // Empty; only sets the row height
+
+// Request queue shared with the worker, guarded by g_thumbMutex
+std::mutex g_thumbMutex;
+std::condition_variable g_thumbWake;
+std::deque<ThumbnailRequest> g_thumbQueue;  // Most recently painted first
+SIZE g_thumbRequestSize = {};               // Pixel size and DPI to render at
+int g_thumbRequestDpi = 96;
+bool g_thumbStop = false;
+std::thread g_thumbThread;
+
+/*
+ * Builds the cache key of g_fonts[fontIndex]'s thumbnail
+ */
+std::wstring MakeThumbnailKey(size_t fontIndex)
 {
-    wchar_t status[256];
-    const wchar_t* modeStr;
-    switch (g_currentMode) {
-        case EnumMode::GDI: modeStr = L"GDI"; break;
-        case EnumMode::DirectWrite: modeStr = L"DirectWrite"; break;
-        case EnumMode::FontSet: modeStr = L"FontSet"; break;
-        default: modeStr = L"No"; break;
-    }
+    std::wstring key(g_fonts.Family(fontIndex));
+    key += L'\0';
+    key += std::to_wstring(g_fonts.Weight(fontIndex));
+    key += g_fonts.IsItalic(fontIndex) ? L'I' : L'N';
+    key += std::to_wstring(g_thumbDpi);
+    return key;
+}
 
-    if (g_filterText.empty()) {
-        swprintf_s(status, L"%s Enumeration: Found %zu fonts", modeStr, g_fonts.size());
-    } else {
-        swprintf_s(status, L"%s Enumeration: Showing %zu of %zu fonts",
-            modeStr, g_filteredIndices.size(), g_fonts.size());
+/*
+ * Renders request.family into pixels (see ThumbnailResult)
+ *
+ * The DC render target is bound to a 32-bpp DIB section owned by the
+ * worker; grayscale antialiasing keeps the raster-op blits free of
+ * ClearType color fringes.
+ */
+bool RenderThumbnail(ID2D1DCRenderTarget* pTarget, ID2D1SolidColorBrush* pBrush,
+    IDWriteFactory* pDWriteFactory, HDC hdcMem, const BYTE* dibBits, SIZE size, int dpi,
+    const ThumbnailRequest& request, std::vector<BYTE>& pixels)
+{
+    IDWriteTextFormat* pFormat = nullptr;
+    if (FAILED(pDWriteFactory->CreateTextFormat(request.family.c_str(), NULL,
+            static_cast<DWRITE_FONT_WEIGHT>(request.weight),
+            request.italic ? DWRITE_FONT_STYLE_ITALIC : DWRITE_FONT_STYLE_NORMAL,
+            DWRITE_FONT_STRETCH_NORMAL, THUMBNAIL_FONT_SIZE, L"", &pFormat))) {
+        return false;
     }
-    SetWindowTextW(g_hStatusLabel, status);
+    pFormat->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+    pFormat->SetParagraphAlignment(DWRITE_PARAGRAPH_ALIGNMENT_CENTER);
+
+    RECT bounds = { 0, 0, size.cx, size.cy };
+    bool ok = SUCCEEDED(pTarget->BindDC(hdcMem, &bounds));
+    if (ok) {
+        pTarget->SetDpi(static_cast<float>(dpi), static_cast<float>(dpi));
+        pTarget->BeginDraw();
+        pTarget->Clear(D2D1::ColorF(D2D1::ColorF::White));
+        pTarget->DrawText(request.family.c_str(), static_cast<UINT32>(request.family.size()), pFormat,
+            D2D1::RectF(0, 0, THUMBNAIL_WIDTH, THUMBNAIL_ROW_HEIGHT), pBrush,
+            D2D1_DRAW_TEXT_OPTIONS_CLIP);
+        ok = SUCCEEDED(pTarget->EndDraw());
+    }
+    pFormat->Release();
+    if (!ok) return false;
+
+    GdiFlush();
+    pixels.resize(static_cast<size_t>(size.cx) * size.cy);
+    for (LONG y = 0; y < size.cy; y++) {
+        const BYTE* src = dibBits + static_cast<size_t>(y) * size.cx * 4;
+        BYTE* dst = pixels.data() + static_cast<size_t>(y) * size.cx;
+        for (LONG x = 0; x < size.cx; x++) {
+            dst[x] = src[x * 4 + 1];    // Green of the gray BGRA pixel
+        }
+    }
+    return true;
 }
 
 /*
- * Populates the ListView with filtered font data
+ * Thumbnail worker - renders queued names, most recently painted first
+ *
+ * Results are posted in batches of THUMBNAIL_BATCH_SIZE, or as soon as
+ * the queue runs dry, so the visible rows fill in together.
  */
-void PopulateListView()
+void ThumbnailThreadProc()
 {
-    ListView_DeleteAllItems(g_hListView);
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
 
-    for (size_t i = 0; i < g_filteredIndices.size(); i++) {
-        const auto& font = g_fonts[g_filteredIndices[i]];
+    ID2D1Factory* pD2DFactory = nullptr;
+    IDWriteFactory* pDWriteFactory = nullptr;
+    ID2D1DCRenderTarget* pTarget = nullptr;
+    ID2D1SolidColorBrush* pBrush = nullptr;
+    HDC hdcMem = CreateCompatibleDC(NULL);
+    HBITMAP hDib = NULL;
+    HBITMAP hOldDib = NULL;
+    void* dibBits = nullptr;
+    SIZE dibSize = {};
+
+    if (SUCCEEDED(D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &pD2DFactory))) {
+        DWriteCreateFactory(DWRITE_FACTORY_TYPE_SHARED, __uuidof(IDWriteFactory),
+            reinterpret_cast<IUnknown**>(&pDWriteFactory));
+    }
 
-        // Insert main item (family name)
-        LVITEMW item = {};
-        item.mask = LVIF_TEXT | LVIF_PARAM;
-        item.iItem = static_cast<int>(i);
-        item.iSubItem = 0;
-        item.pszText = const_cast<LPWSTR>(font.familyName.c_str());
-        item.lParam = static_cast<LPARAM>(g_filteredIndices[i]);  // Store original index
-        ListView_InsertItem(g_hListView, &item);
+    std::unique_ptr<ThumbnailBatch> batch;
+    auto post = [&]() {
+        if (batch && !batch->results.empty() &&
+            PostMessageW(g_hWnd, WM_APP_THUMBNAILS, 0, reinterpret_cast<LPARAM>(batch.get()))) {
+            batch.release();  // Owned by the UI thread now
+        }
+        batch.reset();
+    };
+
+    std::unique_lock<std::mutex> lock(g_thumbMutex);
+    for (;;) {
+        if (g_thumbQueue.empty()) {
+            lock.unlock();
+            post();
+            lock.lock();
+            g_thumbWake.wait(lock, [] { return g_thumbStop || !g_thumbQueue.empty(); });
+        }
+        if (g_thumbStop) break;
+
+        ThumbnailRequest request = std::move(g_thumbQueue.front());
+        g_thumbQueue.pop_front();
+        SIZE size = g_thumbRequestSize;
+        int dpi = g_thumbRequestDpi;
+        lock.unlock();
+
+        // (Re)create the target surface when the thumbnail size changes
+        if (hdcMem && (size.cx != dibSize.cx || size.cy != dibSize.cy)) {
+            if (hDib) {
+                SelectObject(hdcMem, hOldDib);
+                DeleteObject(hDib);
+            }
+            BITMAPINFO bmi = {};
+            bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+            bmi.bmiHeader.biWidth = size.cx;
+            bmi.bmiHeader.biHeight = -size.cy;     // Top-down
+            bmi.bmiHeader.biPlanes = 1;
+            bmi.bmiHeader.biBitCount = 32;
+            bmi.bmiHeader.biCompression = BI_RGB;
+            hDib = CreateDIBSection(hdcMem, &bmi, DIB_RGB_COLORS, &dibBits, NULL, 0);
+            hOldDib = hDib ? (HBITMAP)SelectObject(hdcMem, hDib) : NULL;
+            dibSize = hDib ? size : SIZE{};
+        }
+        if (pD2DFactory && !pTarget) {
+            D2D1_RENDER_TARGET_PROPERTIES props = D2D1::RenderTargetProperties(
+                D2D1_RENDER_TARGET_TYPE_DEFAULT,
+                D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE));
+            if (SUCCEEDED(pD2DFactory->CreateDCRenderTarget(&props, &pTarget))) {
+                pTarget->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+                pTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Black), &pBrush);
+            }
+        }
 
-        // Set subitem columns
-        ListView_SetItemText(g_hListView, static_cast<int>(i), 1,
-            const_cast<LPWSTR>(font.styleName.c_str()));
+        if (!batch) {
+            batch = std::make_unique<ThumbnailBatch>();
+            batch->results.reserve(THUMBNAIL_BATCH_SIZE);
+        }
+        ThumbnailResult result;
+        result.key = std::move(request.key);
+        result.generation = request.generation;
+        if (!pTarget || !pBrush || !pDWriteFactory || !hDib ||
+            !RenderThumbnail(pTarget, pBrush, pDWriteFactory, hdcMem, static_cast<const BYTE*>(dibBits),
+                size, dpi, request, result.pixels)) {
+            result.pixels.clear();
+            if (pBrush) { pBrush->Release(); pBrush = nullptr; }
+            if (pTarget) { pTarget->Release(); pTarget = nullptr; }     // e.g. D2DERR_RECREATE_TARGET
+        }
+        batch->results.push_back(std::move(result));
 
-        wchar_t weightStr[32];
-        swprintf_s(weightStr, L"%d", font.weight);
-        ListView_SetItemText(g_hListView, static_cast<int>(i), 2, weightStr);
+        if (batch->results.size() >= THUMBNAIL_BATCH_SIZE) {
+            post();
+        }
+        lock.lock();
+    }
+    lock.unlock();
+
+    if (pBrush) pBrush->Release();
+    if (pTarget) pTarget->Release();
+    if (pDWriteFactory) pDWriteFactory->Release();
+    if (pD2DFactory) pD2DFactory->Release();
+    if (hDib) {
+        SelectObject(hdcMem, hOldDib);
+        DeleteObject(hDib);
+    }
+    if (hdcMem) DeleteDC(hdcMem);
+}
 
-        ListView_SetItemText(g_hListView, static_cast<int>(i), 3,
-            font.italic ? const_cast<LPWSTR>(L"Yes") : const_cast<LPWSTR>(L"No"));
+/*
+ * Starts and stops the thumbnail worker thread
+ */
+void StartThumbnailWorker()
+{
+    g_thumbStop = false;
+    g_thumbThread = std::thread(ThumbnailThreadProc);
+}
 
-        ListView_SetItemText(g_hListView, static_cast<int>(i), 4,
-            font.fixedPitch ? const_cast<LPWSTR>(L"Yes") : const_cast<LPWSTR>(L"No"));
+void StopThumbnailWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_thumbMutex);
+        g_thumbStop = true;
+    }
+    g_thumbWake.notify_one();
+    if (g_thumbThread.joinable()) {
+        g_thumbThread.join();
+    }
+}
 
-        ListView_SetItemText(g_hListView, static_cast<int>(i), 5,
-            const_cast<LPWSTR>(font.filePath.c_str()));
+/*
+ * Creates the atlas for the current thumbnail size: as many slots as
+ * fit in THUMBNAIL_CACHE_BYTES
+ */
+bool EnsureThumbnailAtlas()
+{
+    if (g_thumbAtlas) return true;
+
+    struct {
+        BITMAPINFOHEADER header;
+        RGBQUAD colors[256];
+    } bmi = {};
+    for (int i = 0; i < 256; i++) {
+        bmi.colors[i].rgbRed = bmi.colors[i].rgbGreen = bmi.colors[i].rgbBlue = static_cast<BYTE>(i);
+    }
+    g_thumbAtlasStride = (g_thumbSize.cx + 3) & ~3u;
+    g_thumbSlotCapacity = (std::max)(1u, static_cast<UINT32>(THUMBNAIL_CACHE_BYTES / (g_thumbAtlasStride * g_thumbSize.cy)));
+    bmi.header.biSize = sizeof(bmi.header);
+    bmi.header.biWidth = g_thumbSize.cx;
+    bmi.header.biHeight = -static_cast<LONG>(g_thumbSize.cy * g_thumbSlotCapacity);  // Top-down
+    bmi.header.biPlanes = 1;
+    bmi.header.biBitCount = 8;
+    bmi.header.biCompression = BI_RGB;
+    bmi.header.biClrUsed = 256;
+
+    void* bits = nullptr;
+    g_thumbAtlasDC = CreateCompatibleDC(NULL);
+    g_thumbAtlas = g_thumbAtlasDC ? CreateDIBSection(g_thumbAtlasDC,
+        reinterpret_cast<BITMAPINFO*>(&bmi), DIB_RGB_COLORS, &bits, NULL, 0) : NULL;
+    if (!g_thumbAtlas) {
+        if (g_thumbAtlasDC) DeleteDC(g_thumbAtlasDC);
+        g_thumbAtlasDC = NULL;
+        return false;
+    }
+    g_thumbAtlasBits = static_cast<BYTE*>(bits);
+    g_thumbAtlasOld = (HBITMAP)SelectObject(g_thumbAtlasDC, g_thumbAtlas);
+    return true;
+}
 
-        // Variable font info - show "Yes" with axes or empty
-        std::wstring varStr = font.isVariable ? (L"Yes: " + font.variableAxes) : L"";
-        ListView_SetItemText(g_hListView, static_cast<int>(i), 6,
-            const_cast<LPWSTR>(varStr.c_str()));
+/*
+ * Drops every thumbnail and queued request
+ *
+ * Called when the installed fonts change (a family name may now
+ * resolve to a different font) and when the window is destroyed.
+ */
+void ReleaseThumbnailCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_thumbMutex);
+        g_thumbQueue.clear();
+    }
+    g_thumbGeneration++;        // Discards renders still in flight
+    g_thumbIndex.clear();
+    g_thumbSlots.clear();
+    if (g_thumbAtlasDC) {
+        SelectObject(g_thumbAtlasDC, g_thumbAtlasOld);
+        DeleteDC(g_thumbAtlasDC);
+        g_thumbAtlasDC = NULL;
+    }
+    if (g_thumbAtlas) {
+        DeleteObject(g_thumbAtlas);
+        g_thumbAtlas = NULL;
+        g_thumbAtlasBits = nullptr;
     }
 }
 
-// ============================================================================
-// PREVIEW PANEL
-// ============================================================================
+/*
+ * Sets the list row height and thumbnail size for the list's DPI
+ */
+void InitRowThumbnails()
+{
+    HDC hdc = GetDC(g_hListView);
+    g_thumbDpi = hdc ? GetDeviceCaps(hdc, LOGPIXELSY) : 96;
+    if (hdc) ReleaseDC(g_hListView, hdc);
+
+    g_thumbSize.cx = MulDiv(THUMBNAIL_WIDTH, g_thumbDpi, 96);
+    g_thumbSize.cy = MulDiv(THUMBNAIL_ROW_HEIGHT, g_thumbDpi, 96);
+    {
+        std::lock_guard<std::mutex> lock(g_thumbMutex);
+        g_thumbRequestSize = g_thumbSize;
+        g_thumbRequestDpi = g_thumbDpi;
+    }
+
+    // Report-view rows are as tall as the small image list
+    g_hRowImageList = ImageList_Create(1, g_thumbSize.cy, ILC_COLOR32, 0, 0);
+    ListView_SetImageList(g_hListView, g_hRowImageList, LVSIL_SMALL);
+}
 
 /*
- * Triggers a repaint of the preview panel
+ * Queues key for rendering in front of older requests
  */
-void UpdatePreview()
+void RequestThumbnail(const std::wstring& key, size_t fontIndex)
 {
-    InvalidateRect(g_hPreviewStatic, NULL, TRUE);
+    g_thumbIndex[key] = THUMBNAIL_PENDING;
+
+    ThumbnailRequest request;
+    request.key = key;
+    request.family = g_fonts.Family(fontIndex);
+    request.weight = g_fonts.Weight(fontIndex);
+    request.italic = g_fonts.IsItalic(fontIndex);
+    request.generation = g_thumbGeneration;
+
+    std::wstring dropped;
+    {
+        std::lock_guard<std::mutex> lock(g_thumbMutex);
+        g_thumbQueue.push_front(std::move(request));
+        if (g_thumbQueue.size() > THUMBNAIL_QUEUE_LIMIT) {
+            dropped = std::move(g_thumbQueue.back().key);
+            g_thumbQueue.pop_back();
+        }
+    }
+    g_thumbWake.notify_one();
+    if (!dropped.empty()) {
+        g_thumbIndex.erase(dropped);    // Requested again if it is painted again
+    }
 }
 
 /*
- * Subclassed window procedure for the preview panel
- *
- * Handles custom painting to display the selected font with its
- * actual weight and italic style.
+ * Handles WM_APP_THUMBNAILS - copies rendered names into the atlas
+ * and repaints the list
  */
-LRESULT CALLBACK PreviewWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam,
-    UINT_PTR uIdSubclass, DWORD_PTR dwRefData)
+void OnThumbnails(ThumbnailBatch* pBatch)
 {
-    switch (message) {
-    case WM_PAINT:
-    {
-        PAINTSTRUCT ps;
-        HDC hdc = BeginPaint(hWnd, &ps);
+    std::unique_ptr<ThumbnailBatch> batch(pBatch);
+    bool added = false;
+    for (ThumbnailResult& result : batch->results) {
+        if (result.generation != g_thumbGeneration) continue;
+        size_t size = static_cast<size_t>(g_thumbSize.cx) * g_thumbSize.cy;
+        if (result.pixels.size() != size || !EnsureThumbnailAtlas()) {
+            g_thumbIndex[result.key] = THUMBNAIL_FAILED;
+            continue;
+        }
 
-        RECT rect;
-        GetClientRect(hWnd, &rect);
-
-        // Fill background with white
-        FillRect(hdc, &rect, (HBRUSH)GetStockObject(WHITE_BRUSH));
-
-        // Draw border
-        FrameRect(hdc, &rect, (HBRUSH)GetStockObject(GRAY_BRUSH));
-
-        if (!g_selectedFont.empty()) {
-            // Create font for preview with actual weight and italic
-            HFONT hFont = CreateFontW(
-                32, 0, 0, 0,                    // Height, width, escapement, orientation
-                g_selectedWeight,               // Use actual weight (400, 700, etc.)
-                g_selectedItalic ? TRUE : FALSE, // Use actual italic flag
-                FALSE, FALSE,                   // No underline/strikeout
-                DEFAULT_CHARSET,
-                OUT_DEFAULT_PRECIS,
-                CLIP_DEFAULT_PRECIS,
-                CLEARTYPE_QUALITY,
-                DEFAULT_PITCH | FF_DONTCARE,
-                g_selectedFont.c_str());
-
-            if (hFont) {
-                HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
-
-                SetBkMode(hdc, TRANSPARENT);
-                SetTextColor(hdc, RGB(0, 0, 0));
-
-                // Preview text shows font name, style, and sample characters
-                std::wstring previewText = g_selectedFont + L" " + g_selectedStyle + L"\r\nAaBbCcDdEeFfGgHhIiJjKk\r\n0123456789 !@#$%";
-
-                RECT textRect = rect;
-                textRect.left += 10;
-                textRect.top += 10;
-                textRect.right -= 10;
-                textRect.bottom -= 10;
-
-                DrawTextW(hdc, previewText.c_str(), -1, &textRect,
-                    DT_LEFT | DT_TOP | DT_WORDBREAK);
-
-                SelectObject(hdc, hOldFont);
-                DeleteObject(hFont);
-            }
+        // Take a free slot, or evict the least recently drawn thumbnail
+        UINT32 slot;
+        if (g_thumbSlots.size() < g_thumbSlotCapacity) {
+            slot = static_cast<UINT32>(g_thumbSlots.size());
+            g_thumbSlots.emplace_back();
         } else {
-            // Show placeholder text when no font is selected
-            SetBkMode(hdc, TRANSPARENT);
-            SetTextColor(hdc, RGB(128, 128, 128));
-            DrawTextW(hdc, L"Select a font to preview", -1, &rect,
-                DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+            slot = 0;
+            for (UINT32 s = 1; s < g_thumbSlots.size(); s++) {
+                if (g_thumbSlots[s].lastUsed < g_thumbSlots[slot].lastUsed) slot = s;
+            }
+            g_thumbIndex.erase(g_thumbSlots[slot].key);
         }
-
-        EndPaint(hWnd, &ps);
-        return 0;
+        g_thumbSlots[slot].key = result.key;
+        g_thumbSlots[slot].lastUsed = ++g_thumbTick;
+        g_thumbIndex[result.key] = slot;
+
+        GdiFlush();
+        BYTE* dst = g_thumbAtlasBits + static_cast<size_t>(slot) * g_thumbSize.cy * g_thumbAtlasStride;
+        for (LONG y = 0; y < g_thumbSize.cy; y++) {
+            memcpy(dst + static_cast<size_t>(y) * g_thumbAtlasStride,
+                result.pixels.data() + static_cast<size_t>(y) * g_thumbSize.cx, g_thumbSize.cx);
+        }
+        added = true;
     }
-    case WM_NCDESTROY:
-        // Clean up subclass when window is destroyed
-        RemoveWindowSubclass(hWnd, PreviewWndProc, uIdSubclass);
+    if (added) {
+        InvalidateRect(g_hListView, NULL, FALSE);
+    }
+}
+
+/*
+ * Handles NM_CUSTOMDRAW for the ListView - draws the Font Family cell
+ * from the thumbnail atlas, or requests the thumbnail and lets the
+ * control draw the plain name meanwhile
+ */
+LRESULT OnListCustomDraw(NMLVCUSTOMDRAW* pDraw)
+{
+    switch (pDraw->nmcd.dwDrawStage) {
+    case CDDS_PREPAINT:
+        return CDRF_NOTIFYITEMDRAW;
+    case CDDS_ITEMPREPAINT:
+        return CDRF_NOTIFYSUBITEMDRAW;
+    case CDDS_ITEMPREPAINT | CDDS_SUBITEM:
         break;
+    default:
+        return CDRF_DODEFAULT;
     }
 
-    return DefSubclassProc(hWnd, message, wParam, lParam);
+    int row = static_cast<int>(pDraw->nmcd.dwItemSpec);
+    if (pDraw->iSubItem != 0 || row < 0 || static_cast<size_t>(row) >= g_filteredIndices.size()) {
+        return CDRF_DODEFAULT;
+    }
+
+    size_t font = g_filteredIndices[row];
+    std::wstring key = MakeThumbnailKey(font);
+    auto it = g_thumbIndex.find(key);
+    if (it == g_thumbIndex.end()) {
+        RequestThumbnail(key, font);
+        return CDRF_DODEFAULT;
+    }
+    if (it->second == THUMBNAIL_PENDING || it->second == THUMBNAIL_FAILED) {
+        return CDRF_DODEFAULT;
+    }
+    UINT32 slot = it->second;
+    g_thumbSlots[slot].lastUsed = ++g_thumbTick;
+
+    RECT bounds, label;
+    ListView_GetItemRect(g_hListView, row, &bounds, LVIR_BOUNDS);
+    ListView_GetItemRect(g_hListView, row, &label, LVIR_LABEL);
+    RECT cell = { bounds.left, bounds.top, label.right, bounds.bottom };
+
+    // Owner-data rows don't report selection in nmcd.uItemState reliably
+    bool selected = (ListView_GetItemState(g_hListView, row, LVIS_SELECTED) & LVIS_SELECTED) != 0;
+    bool highlighted = selected && GetFocus() == g_hListView;
+    HDC hdc = pDraw->nmcd.hdc;
+    FillRect(hdc, &cell, GetSysColorBrush(highlighted ? COLOR_HIGHLIGHT : selected ? COLOR_BTNFACE : COLOR_WINDOW));
+
+    int x = label.left + 2;
+    int width = (std::min)(static_cast<int>(g_thumbSize.cx), static_cast<int>(label.right - x));
+    int y = cell.top + (cell.bottom - cell.top - g_thumbSize.cy) / 2;
+    if (width > 0) {
+        BitBlt(hdc, x, y, width, g_thumbSize.cy, g_thumbAtlasDC, 0, slot * g_thumbSize.cy,
+            highlighted ? MERGEPAINT : SRCAND);
+    }
+    return CDRF_SKIPDEFAULT;
 }
 
 // ============================================================================
@@ -799,12 +7884,13 @@ LRESULT CALLBACK PreviewWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM l
  *
  * Layout:
  * +------------------------------------------------------------------+
- * | [GDI] [DirectWrite] [FontSet API]  Filter: [____]  Status text   |
+ * | [GDI] [DWrite] [FontSet] [All] [Folder...] [OpenType] Filter: [_] |
  * +--------------------------------+--------------------------------+
  * |                                |                                 |
  * |         ListView               |        Preview Panel            |
  * |     (font list table)          |    (sample text in font)        |
- * |                                |                                 |
+ * |                                +---------------------------------+
+ * |                                |  wght [=====o=====]  (per axis) |
  * +--------------------------------+---------------------------------+
  */
 void CreateControls(HWND hWnd)
@@ -828,32 +7914,57 @@ void CreateControls(HWND hWnd)
         210, 10, 100, 30,
         hWnd, (HMENU)IDC_FONTSET_BUTTON, g_hInstance, NULL);
 
+    g_hAllButton = CreateWindowW(
+        L"BUTTON", L"All APIs",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        320, 10, 80, 30,
+        hWnd, (HMENU)IDC_ALL_BUTTON, g_hInstance, NULL);
+
+    g_hFolderButton = CreateWindowW(
+        L"BUTTON", L"Open folder...",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        410, 10, 100, 30,
+        hWnd, (HMENU)IDC_FOLDER_BUTTON, g_hInstance, NULL);
+
+    g_hOpenTypeButton = CreateWindowW(
+        L"BUTTON", L"OpenType",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        520, 10, 80, 30,
+        hWnd, (HMENU)IDC_OPENTYPE_BUTTON, g_hInstance, NULL);
+
+    g_hFamiliesButton = CreateWindowW(
+        L"BUTTON", L"Families",
+        WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+        610, 10, 80, 30,
+        hWnd, (HMENU)IDC_FAMILIES_BUTTON, g_hInstance, NULL);
+
     // --- Filter controls ---
     g_hSearchLabel = CreateWindowW(
         L"STATIC", L"Filter:",
         WS_CHILD | WS_VISIBLE | SS_LEFT,
-        330, 17, 40, 20,
+        710, 17, 40, 20,
         hWnd, (HMENU)IDC_SEARCH_LABEL, g_hInstance, NULL);
 
     g_hSearchEdit = CreateWindowExW(
         WS_EX_CLIENTEDGE,  // Sunken edge style
         L"EDIT", L"",
         WS_CHILD | WS_VISIBLE | ES_AUTOHSCROLL,
-        375, 12, 180, 24,
+        755, 12, 180, 24,
         hWnd, (HMENU)IDC_SEARCH_EDIT, g_hInstance, NULL);
 
     // --- Status label ---
     g_hStatusLabel = CreateWindowW(
         L"STATIC", L"Click a button to enumerate fonts",
         WS_CHILD | WS_VISIBLE | SS_LEFT,
-        570, 17, 350, 20,
+        950, 17, 350, 20,
         hWnd, (HMENU)IDC_STATUS_LABEL, g_hInstance, NULL);
 
     // --- ListView (font list) ---
+    // Virtual (owner-data) list: rows are supplied on demand via LVN_GETDISPINFO
     g_hListView = CreateWindowExW(
         WS_EX_CLIENTEDGE,
         WC_LISTVIEWW, L"",
-        WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL | LVS_SHOWSELALWAYS,
+        WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_SINGLESEL | LVS_SHOWSELALWAYS | LVS_OWNERDATA,
         10, 50, 600, 400,
         hWnd, (HMENU)IDC_LISTVIEW, g_hInstance, NULL);
 
@@ -900,6 +8011,11 @@ void CreateControls(HWND hWnd)
     col.iSubItem = 6;
     ListView_InsertColumn(g_hListView, 6, &col);
 
+    col.pszText = const_cast<LPWSTR>(L"Duplicates");
+    col.cx = 100;
+    col.iSubItem = LIST_COLUMN_DUPLICATES;
+    ListView_InsertColumn(g_hListView, LIST_COLUMN_DUPLICATES, &col);
+
     // --- Preview panel ---
     // Using owner-draw STATIC control for custom painting
     g_hPreviewStatic = CreateWindowW(
@@ -911,15 +8027,38 @@ void CreateControls(HWND hWnd)
     // Subclass the preview panel to handle custom painting
     SetWindowSubclass(g_hPreviewStatic, PreviewWndProc, 0, 0);
 
+    // --- Variable axis sliders (below the preview, shown per selection) ---
+    for (int a = 0; a < PREVIEW_MAX_AXES; a++) {
+        g_hAxisLabels[a] = CreateWindowW(
+            L"STATIC", L"",
+            WS_CHILD | SS_LEFT,
+            0, 0, PREVIEW_AXIS_LABEL_WIDTH, 20,
+            hWnd, (HMENU)(INT_PTR)(IDC_AXIS_LABEL + a), g_hInstance, NULL);
+        g_hAxisSliders[a] = CreateWindowW(
+            TRACKBAR_CLASSW, L"",
+            WS_CHILD | WS_TABSTOP | TBS_HORZ | TBS_NOTICKS,
+            0, 0, 100, PREVIEW_AXIS_ROW_HEIGHT,
+            hWnd, (HMENU)(INT_PTR)(IDC_AXIS_SLIDER + a), g_hInstance, NULL);
+    }
+
     // --- Set default GUI font on all controls ---
     HFONT hFont = (HFONT)GetStockObject(DEFAULT_GUI_FONT);
     SendMessage(g_hGdiButton, WM_SETFONT, (WPARAM)hFont, TRUE);
     SendMessage(g_hDWriteButton, WM_SETFONT, (WPARAM)hFont, TRUE);
     SendMessage(g_hFontSetButton, WM_SETFONT, (WPARAM)hFont, TRUE);
+    SendMessage(g_hAllButton, WM_SETFONT, (WPARAM)hFont, TRUE);
+    SendMessage(g_hFolderButton, WM_SETFONT, (WPARAM)hFont, TRUE);
+    SendMessage(g_hOpenTypeButton, WM_SETFONT, (WPARAM)hFont, TRUE);
+    SendMessage(g_hFamiliesButton, WM_SETFONT, (WPARAM)hFont, TRUE);
     SendMessage(g_hSearchLabel, WM_SETFONT, (WPARAM)hFont, TRUE);
     SendMessage(g_hSearchEdit, WM_SETFONT, (WPARAM)hFont, TRUE);
     SendMessage(g_hStatusLabel, WM_SETFONT, (WPARAM)hFont, TRUE);
     SendMessage(g_hListView, WM_SETFONT, (WPARAM)hFont, TRUE);
+    for (HWND hLabel : g_hAxisLabels) {
+        SendMessage(hLabel, WM_SETFONT, (WPARAM)hFont, TRUE);
+    }
+
+    InitRowThumbnails();
 }
 
 // ============================================================================
@@ -929,7 +8068,9 @@ void CreateControls(HWND hWnd)
 /*
  * Resizes child controls when the window size changes
  *
- * The layout splits the content area 2/3 for list, 1/3 for preview panel.
+ * The layout splits the content area 2/3 for list, 1/3 for preview panel;
+ * the axis sliders of a variable font take rows at the bottom of the
+ * preview column.
  */
 void ResizeControls(HWND hWnd)
 {
@@ -943,8 +8084,16 @@ void ResizeControls(HWND hWnd)
     int previewWidth = width - listWidth - 30;
     int listHeight = height - 70;  // Leave space for toolbar
 
+    int previewHeight = listHeight - g_axisSliderRows * PREVIEW_AXIS_ROW_HEIGHT;
+
     MoveWindow(g_hListView, 10, 50, listWidth, listHeight, TRUE);
-    MoveWindow(g_hPreviewStatic, listWidth + 20, 50, previewWidth, listHeight, TRUE);
+    MoveWindow(g_hPreviewStatic, listWidth + 20, 50, previewWidth, previewHeight, TRUE);
+    for (int a = 0; a < g_axisSliderRows; a++) {
+        int y = 50 + previewHeight + a * PREVIEW_AXIS_ROW_HEIGHT;
+        MoveWindow(g_hAxisLabels[a], listWidth + 20, y + 6, PREVIEW_AXIS_LABEL_WIDTH, 20, TRUE);
+        MoveWindow(g_hAxisSliders[a], listWidth + 20 + PREVIEW_AXIS_LABEL_WIDTH, y,
+            previewWidth - PREVIEW_AXIS_LABEL_WIDTH, PREVIEW_AXIS_ROW_HEIGHT, TRUE);
+    }
 }
 
 // ============================================================================
@@ -958,7 +8107,19 @@ void ResizeControls(HWND hWnd)
  * - WM_CREATE: Initialize child controls
  * - WM_SIZE: Resize controls to fit window
  * - WM_COMMAND: Button clicks and edit control changes
- * - WM_NOTIFY: ListView selection changes
+ * - WM_HSCROLL: Variable axis sliders under the preview
+ * - WM_TIMER: Deferred filter update after typing pauses, deferred rescans
+ * - WM_FONTCHANGE / WM_APP_FONTS_EXPIRED: Incremental rescan after font changes
+ * - WM_NOTIFY: ListView row data (LVN_GETDISPINFO), row thumbnails
+ *   (NM_CUSTOMDRAW), visible-row hints (LVN_ODCACHEHINT), type-ahead
+ *   (LVN_ODFINDITEM), family groups (LVN_ITEMACTIVATE, LVN_KEYDOWN),
+ *   header clicks (LVN_COLUMNCLICK) and selection changes
+ * - WM_APP_FONT_BATCH / WM_APP_ENUM_DONE: Results from the enumeration worker
+ * - WM_APP_FONT_DETAILS: Deferred face details from the details worker
+ * - WM_APP_COVERAGE_BATCH/DONE: Unicode coverage from the coverage builder
+ * - WM_APP_THUMBNAILS: Rendered row thumbnails from the thumbnail worker
+ * - WM_APP_DUPLICATES_DONE: Duplicate groups from the duplicate finder
+ * - WM_APP_FAMILY_FACES/DONE: Faces of the Families mode from the face loader
  * - WM_GETMINMAXINFO: Set minimum window size
  * - WM_DESTROY: Clean up and exit
  */
@@ -977,57 +8138,154 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     case WM_COMMAND:
         switch (LOWORD(wParam)) {
         case IDC_GDI_BUTTON:
-            EnumerateGDIFonts();
+            StartEnumeration(EnumMode::GDI);
             break;
         case IDC_DWRITE_BUTTON:
-            EnumerateDirectWriteFonts();
+            StartEnumeration(EnumMode::DirectWrite);
             break;
         case IDC_FONTSET_BUTTON:
-            EnumerateFontSetFonts();
+            StartEnumeration(EnumMode::FontSet);
+            break;
+        case IDC_ALL_BUTTON:
+            StartEnumeration(EnumMode::All);
+            break;
+        case IDC_OPENTYPE_BUTTON:
+            StartEnumeration(EnumMode::OpenType);
+            break;
+        case IDC_FAMILIES_BUTTON:
+            StartEnumeration(EnumMode::Families);
+            break;
+        case IDC_FOLDER_BUTTON:
+            if (ChooseFontFolder(hWnd, g_folderPath)) {
+                StartEnumeration(EnumMode::Folder);
+            }
             break;
         case IDC_SEARCH_EDIT:
-            // Filter text changed - reapply filter
+            // Filter text changed - (re)start the coalescing timer so a
+            // burst of keystrokes or a paste filters only once
             if (HIWORD(wParam) == EN_CHANGE) {
-                wchar_t buffer[256] = {};
-                GetWindowTextW(g_hSearchEdit, buffer, 256);
-                g_filterText = buffer;
-                ApplyFilter();
+                SetTimer(hWnd, IDT_FILTER_TIMER, FILTER_DELAY_MS, NULL);
             }
             break;
         }
         break;
 
-    // Handle ListView notifications (selection changes)
+    // Fonts were installed or removed; coalesce bursts (e.g. scripted
+    // installs) into one incremental rescan
+    case WM_FONTCHANGE:
+    case WM_APP_FONTS_EXPIRED:
+        SelectPreviewFont();        // The selected face may have been replaced
+        ReleaseThumbnailCache();
+        InvalidateRect(g_hListView, NULL, FALSE);
+        SetTimer(hWnd, IDT_RESCAN_TIMER, RESCAN_DELAY_MS, NULL);
+        break;
+
+    // Preview axis sliders
+    case WM_HSCROLL:
+        if (lParam && OnAxisSlider(reinterpret_cast<HWND>(lParam))) {
+            return 0;
+        }
+        return DefWindowProcW(hWnd, message, wParam, lParam);
+
+    case WM_TIMER:
+        if (wParam == IDT_RESCAN_TIMER) {
+            KillTimer(hWnd, IDT_RESCAN_TIMER);
+            StartRescan();
+        } else if (wParam == IDT_FILTER_TIMER) {
+            KillTimer(hWnd, IDT_FILTER_TIMER);
+            wchar_t buffer[256] = {};
+            GetWindowTextW(g_hSearchEdit, buffer, 256);
+            g_filterText = buffer;
+            CompileQuery(g_filterText, g_query);    // Once per change, not per face
+            ApplyFilter();
+        }
+        break;
+
+    // Handle ListView notifications (row data requests, selection changes)
     case WM_NOTIFY:
     {
         LPNMHDR pnmh = (LPNMHDR)lParam;
         if (pnmh->idFrom == IDC_LISTVIEW) {
-            if (pnmh->code == LVN_ITEMCHANGED) {
+            if (pnmh->code == LVN_GETDISPINFOW) {
+                OnGetDispInfo(reinterpret_cast<NMLVDISPINFOW*>(lParam));
+            } else if (pnmh->code == NM_CUSTOMDRAW) {
+                return OnListCustomDraw(reinterpret_cast<NMLVCUSTOMDRAW*>(lParam));
+            } else if (pnmh->code == LVN_ODCACHEHINT) {
+                OnCacheHint(reinterpret_cast<NMLVCACHEHINT*>(lParam));
+            } else if (pnmh->code == LVN_ODFINDITEMW) {
+                return OnFindItem(reinterpret_cast<NMLVFINDITEMW*>(lParam));
+            } else if (pnmh->code == LVN_ITEMACTIVATE) {
+                // Enter or double-click toggles a family group
+                int row = reinterpret_cast<NMITEMACTIVATE*>(lParam)->iItem;
+                if (row >= 0 && static_cast<size_t>(row) < g_filteredIndices.size()) {
+                    auto it = g_familyGroups.find(g_fonts.FamilyId(g_filteredIndices[row]));
+                    ToggleFamilyGroup(row, it != g_familyGroups.end() && !it->second.expanded);
+                }
+            } else if (pnmh->code == LVN_KEYDOWN) {
+                WORD key = reinterpret_cast<NMLVKEYDOWN*>(lParam)->wVKey;
+                if (key == VK_RIGHT || key == VK_LEFT) {
+                    ToggleFamilyGroup(ListView_GetNextItem(g_hListView, -1, LVNI_FOCUSED), key == VK_RIGHT);
+                }
+            } else if (pnmh->code == LVN_COLUMNCLICK) {
+                OnColumnClick(reinterpret_cast<NMLISTVIEW*>(lParam)->iSubItem);
+            } else if (pnmh->code == LVN_ITEMCHANGED) {
                 LPNMLISTVIEW pnmlv = (LPNMLISTVIEW)lParam;
-                // Only respond to selection (not deselection)
-                if (pnmlv->uNewState & LVIS_SELECTED) {
-                    // Get the original font index from lParam
-                    LVITEMW item = {};
-                    item.mask = LVIF_PARAM;
-                    item.iItem = pnmlv->iItem;
-                    if (ListView_GetItem(g_hListView, &item)) {
-                        size_t fontIndex = static_cast<size_t>(item.lParam);
-                        if (fontIndex < g_fonts.size()) {
-                            // Update selected font state
-                            const auto& font = g_fonts[fontIndex];
-                            g_selectedFont = font.familyName;
-                            g_selectedStyle = font.styleName;
-                            g_selectedWeight = font.weight;
-                            g_selectedItalic = font.italic;
-                            UpdatePreview();
-                        }
-                    }
+                // Only respond to selection (not deselection); the row
+                // index maps to a font through g_filteredIndices
+                if ((pnmlv->uNewState & LVIS_SELECTED) && pnmlv->iItem >= 0 &&
+                    static_cast<size_t>(pnmlv->iItem) < g_filteredIndices.size()) {
+                    // Update selected font state
+                    size_t font = g_filteredIndices[pnmlv->iItem];
+                    g_selectedFont = g_fonts.Family(font);
+                    g_selectedStyle = g_fonts.Style(font);
+                    g_selectedWeight = g_fonts.Weight(font);
+                    g_selectedItalic = g_fonts.IsItalic(font);
+                    g_selectedPath = g_fonts.Path(font);
+                    g_selectedFaceIndex = g_fonts.FaceIndex(font);
+                    SelectPreviewFont();
                 }
             }
         }
         break;
     }
 
+    // Results streamed from the enumeration worker thread
+    case WM_APP_FONT_BATCH:
+        OnFontBatch(reinterpret_cast<FontBatch*>(lParam));
+        break;
+
+    case WM_APP_FONT_DETAILS:
+        OnFontDetails(reinterpret_cast<FontDetailsBatch*>(lParam));
+        break;
+
+    case WM_APP_COVERAGE_BATCH:
+        OnCoverageBatch(reinterpret_cast<CoverageBatch*>(lParam));
+        break;
+
+    case WM_APP_COVERAGE_DONE:
+        OnCoverageDone(static_cast<UINT>(wParam));
+        break;
+
+    case WM_APP_DUPLICATES_DONE:
+        OnDuplicatesDone(static_cast<UINT>(wParam));
+        break;
+
+    case WM_APP_FAMILY_FACES:
+        OnFamilyFaces(static_cast<UINT>(wParam), reinterpret_cast<FamilyFacesBatch*>(lParam));
+        break;
+
+    case WM_APP_FAMILY_FACES_DONE:
+        OnFamilyFacesDone(static_cast<UINT>(wParam));
+        break;
+
+    case WM_APP_THUMBNAILS:
+        OnThumbnails(reinterpret_cast<ThumbnailBatch*>(lParam));
+        break;
+
+    case WM_APP_ENUM_DONE:
+        OnEnumerationDone(static_cast<UINT>(wParam));
+        break;
+
     // Set minimum window size
     case WM_GETMINMAXINFO:
     {
@@ -1038,6 +8296,16 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     }
 
     case WM_DESTROY:
+        StopFontWatcher();
+        StopDetailWorker();
+        StopThumbnailWorker();
+        ReleaseThumbnailCache();
+        CancelEnumeration();
+        CancelCoverageBuild();
+        CancelDuplicateScan();
+        CancelFamilyFaceLoad();
+        UnpublishFontInventory();
+        StopDataFileWriter();       // Finishes the snapshots still queued
         PostQuitMessage(0);
         break;
 
@@ -1047,6 +8315,582 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     return 0;
 }
 
+// ============================================================================
+// COMMAND-LINE MODE - Headless export for scripted inventories
+// ============================================================================
+//
+//   FontEnum.exe --mode=gdi|directwrite|fontset|all|opentype [--format=jsonl|csv]
+//                [--out=<file>] [--threads=<n>]
+//   FontEnum.exe --folder=<dir> [--mode=opentype] [--format=...] [--out=<file>] [--threads=<n>]
+//   FontEnum.exe --benchmark[=<runs>] [--mode=...] [--folder=<dir>] [--out=<file>] [--threads=<n>]
+//
+// Fonts are written to the output as they are enumerated; nothing is
+// kept in g_fonts and no window is created. The benchmark runs the full
+// pipeline (including sort and row formatting) and reports stage timings.
+
+#define OUTPUT_BUFFER_SIZE  (64 * 1024)     // UTF-8 bytes buffered before a write
+
+/*
+ * Appends text to out as UTF-8
+ */
+void AppendUtf8(std::string& out, const std::wstring& text)
+{
+    if (text.empty()) return;
+    int size = WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), NULL, 0, NULL, NULL);
+    if (size <= 0) return;
+    size_t offset = out.size();
+    out.resize(offset + size);
+    WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.size()),
+        &out[offset], size, NULL, NULL);
+}
+
+enum class OutputFormat {
+    JsonLines,  // One JSON object per line
+    Csv         // Header row, then one row per face
+};
+
+/*
+ * FontOutputStream - Formats fonts as JSON lines or CSV into a buffered
+ * UTF-8 stream
+ *
+ * Thread-safe: FontSet enumeration writes from several threads, so
+ * records appear in completion order, not sorted.
+ */
+class FontOutputStream : public FontSink {
+public:
+    FontOutputStream(HANDLE hOutput, OutputFormat format, bool withSources = false)
+        : m_hOutput(hOutput), m_format(format), m_withSources(withSources)
+    {
+        m_buffer.reserve(OUTPUT_BUFFER_SIZE + 4096);
+        if (m_format == OutputFormat::Csv) {
+            AppendUtf8(m_buffer, m_withSources
+                ? L"family,style,weight,italic,fixedPitch,filePath,faceIndex,variable,axes,charSet,gdi,directWrite,fontSet\r\n"
+                : L"family,style,weight,italic,fixedPitch,filePath,faceIndex,variable,axes,charSet\r\n");
+        }
+    }
+
+    FontOutputStream(const FontOutputStream&) = delete;
+    FontOutputStream& operator=(const FontOutputStream&) = delete;
+
+    void Write(const std::vector<FontInfo>& fonts) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& font : fonts) {
+            m_line.clear();
+            if (m_format == OutputFormat::JsonLines) {
+                FormatJson(font);
+            } else {
+                FormatCsv(font);
+            }
+            AppendUtf8(m_buffer, m_line);
+            m_count++;
+            if (m_buffer.size() >= OUTPUT_BUFFER_SIZE) {
+                FlushLocked();
+            }
+        }
+    }
+
+    bool Flush()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        FlushLocked();
+        return !m_failed;
+    }
+
+    size_t Count() const { return m_count; }
+
+private:
+    void FlushLocked()
+    {
+        if (!m_buffer.empty() && !m_failed && !WriteAll(m_hOutput, m_buffer.data(), m_buffer.size())) {
+            m_failed = true;
+        }
+        m_buffer.clear();
+    }
+
+    void AppendJsonString(const wchar_t* name, std::wstring_view value)
+    {
+        m_line += L'"';
+        m_line += name;
+        m_line += L"\":\"";
+        for (wchar_t c : value) {
+            if (c == L'"' || c == L'\\') {
+                m_line += L'\\';
+                m_line += c;
+            } else if (c < 0x20) {
+                wchar_t escape[8];
+                swprintf_s(escape, L"\\u%04x", c);
+                m_line += escape;
+            } else {
+                m_line += c;
+            }
+        }
+        m_line += L'"';
+    }
+
+    void AppendCsvField(std::wstring_view value)
+    {
+        if (value.find_first_of(L",\"\r\n") == std::wstring_view::npos) {
+            m_line += value;
+            return;
+        }
+        m_line += L'"';
+        for (wchar_t c : value) {
+            if (c == L'"') m_line += L'"';
+            m_line += c;
+        }
+        m_line += L'"';
+    }
+
+    void FormatJson(const FontInfo& font)
+    {
+        wchar_t numbers[160];
+        m_line += L'{';
+        AppendJsonString(L"family", font.familyName);
+        m_line += L',';
+        AppendJsonString(L"style", font.styleName);
+        swprintf_s(numbers, L",\"weight\":%d,\"italic\":%s,\"fixedPitch\":%s,",
+            font.weight, font.italic ? L"true" : L"false", font.fixedPitch ? L"true" : L"false");
+        m_line += numbers;
+        AppendJsonString(L"filePath", font.filePath);
+        swprintf_s(numbers, L",\"faceIndex\":%u,\"variable\":%s,",
+            font.faceIndex, font.isVariable ? L"true" : L"false");
+        m_line += numbers;
+        AppendJsonString(L"axes", font.variableAxes);
+        swprintf_s(numbers, L",\"charSet\":%d", font.charSet);
+        m_line += numbers;
+        if (m_withSources) {
+            swprintf_s(numbers, L",\"gdi\":%s,\"directWrite\":%s,\"fontSet\":%s",
+                (font.sources & FONT_SOURCE_GDI) ? L"true" : L"false",
+                (font.sources & FONT_SOURCE_DWRITE) ? L"true" : L"false",
+                (font.sources & FONT_SOURCE_FONTSET) ? L"true" : L"false");
+            m_line += numbers;
+        }
+        m_line += L"}\n";
+    }
+
+    void FormatCsv(const FontInfo& font)
+    {
+        wchar_t numbers[64];
+        AppendCsvField(font.familyName);
+        m_line += L',';
+        AppendCsvField(font.styleName);
+        swprintf_s(numbers, L",%d,%d,%d,", font.weight, font.italic ? 1 : 0, font.fixedPitch ? 1 : 0);
+        m_line += numbers;
+        AppendCsvField(font.filePath);
+        swprintf_s(numbers, L",%u,%d,", font.faceIndex, font.isVariable ? 1 : 0);
+        m_line += numbers;
+        AppendCsvField(font.variableAxes);
+        swprintf_s(numbers, L",%d", font.charSet);
+        m_line += numbers;
+        if (m_withSources) {
+            swprintf_s(numbers, L",%d,%d,%d",
+                (font.sources & FONT_SOURCE_GDI) ? 1 : 0,
+                (font.sources & FONT_SOURCE_DWRITE) ? 1 : 0,
+                (font.sources & FONT_SOURCE_FONTSET) ? 1 : 0);
+            m_line += numbers;
+        }
+        m_line += L"\r\n";
+    }
+
+    HANDLE m_hOutput;
+    OutputFormat m_format;
+    bool m_withSources;         // Append the per-API presence fields (All APIs mode)
+    std::mutex m_mutex;
+    std::string m_buffer;       // Pending UTF-8 output
+    std::wstring m_line;        // Record being formatted
+    size_t m_count = 0;
+    bool m_failed = false;
+};
+
+// ----------------------------------------------------------------------------
+// Benchmark
+// ----------------------------------------------------------------------------
+
+#define BENCHMARK_DEFAULT_RUNS  5
+#define MAX_THREADS_OPTION      256     // Largest accepted --threads value
+
+/*
+ * FontStoreSink - Collects enumerated fonts into g_fonts (benchmark only)
+ */
+class FontStoreSink : public FontSink {
+public:
+    void Write(const std::vector<FontInfo>& fonts) override
+    {
+        // Storing is the UI thread's work in the window; not counted
+        // as enumerator allocations
+        AllocationScope notCounted(nullptr);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& font : fonts) {
+            g_fonts.Add(font);
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+};
+
+/*
+ * BenchmarkRun - Timings of one benchmark iteration, in milliseconds
+ */
+struct BenchmarkRun {
+    double stageMs[ENUM_STAGE_COUNT] = {};
+    double totalMs = 0;         // Elapsed time of the whole iteration
+    size_t fontCount = 0;
+    UINT64 allocations = 0;     // Heap allocations of the enumerator threads
+    UINT64 allocatedBytes = 0;
+};
+
+double TicksToMilliseconds(INT64 ticks)
+{
+    static const double frequency = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return static_cast<double>(f.QuadPart);
+    }();
+    return ticks * 1000.0 / frequency;
+}
+
+/*
+ * Runs one full enumeration of mode the way the GUI processes it:
+ * enumerate (with details), store, sort, index, filter and produce the
+ * text of every row as LVN_GETDISPINFO would
+ *
+ * Returns the job's error text on failure, nullptr on success.
+ */
+const wchar_t* RunBenchmarkIteration(EnumMode mode, BenchmarkRun& run)
+{
+    ClearFonts();
+
+    StageTimings timings;
+    FontStoreSink sink;
+    EnumJob job;
+    job.mode = mode;
+    job.folderPath = g_folderPath;
+    job.sink = &sink;
+    job.deferDetails = false;
+    job.timings = &timings;
+
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    RunEnumerator(job);
+    if (job.errorText) return job.errorText;
+
+    StageClock clock(job);
+    SortFonts();
+    clock.Lap(EnumStage::Sort);
+
+    RebuildSearchIndex();
+    ApplyFilter();
+    wchar_t buffer[MAX_PATH * 2];
+    NMLVDISPINFOW dispInfo = {};
+    int lastColumn = mode == EnumMode::All ? LIST_COLUMN_COUNT - 1 : LIST_COLUMN_DUPLICATES;   // With the presence columns
+    for (size_t row = 0; row < g_filteredIndices.size(); row++) {
+        for (int column = 0; column <= lastColumn; column++) {
+            dispInfo.item.mask = LVIF_TEXT;
+            dispInfo.item.iItem = static_cast<int>(row);
+            dispInfo.item.iSubItem = column;
+            dispInfo.item.pszText = buffer;
+            dispInfo.item.cchTextMax = ARRAYSIZE(buffer);
+            OnGetDispInfo(&dispInfo);
+        }
+    }
+    clock.Lap(EnumStage::Populate);
+    QueryPerformanceCounter(&end);
+
+    for (size_t stage = 0; stage < ENUM_STAGE_COUNT; stage++) {
+        run.stageMs[stage] = TicksToMilliseconds(timings.ticks[stage]);
+    }
+    run.totalMs = TicksToMilliseconds(end.QuadPart - start.QuadPart);
+    run.fontCount = g_fonts.size();
+    run.allocations = job.allocations.count.load();
+    run.allocatedBytes = job.allocations.bytes.load();
+    return nullptr;
+}
+
+/*
+ * Computes min, median and 95th percentile (nearest rank) of values
+ */
+void SummarizeTimings(std::vector<double> values, double& minimum, double& median, double& p95)
+{
+    std::sort(values.begin(), values.end());
+    size_t count = values.size();
+    minimum = values.front();
+    median = count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+    size_t rank = static_cast<size_t>(count * 95 + 99) / 100;  // ceil(0.95 * count)
+    p95 = values[(std::max)(rank, static_cast<size_t>(1)) - 1];
+}
+
+/*
+ * Appends one row of the benchmark table: the cold (first) run and the
+ * min/median/p95 of the warm runs
+ */
+void AppendBenchmarkRow(std::wstring& report, const wchar_t* label, const std::vector<double>& values)
+{
+    wchar_t line[160];
+    if (values.size() > 1) {
+        double minimum, median, p95;
+        SummarizeTimings(std::vector<double>(values.begin() + 1, values.end()), minimum, median, p95);
+        swprintf_s(line, L"  %-14s %10.2f %10.2f %10.2f %10.2f\r\n", label, values[0], minimum, median, p95);
+    } else {
+        swprintf_s(line, L"  %-14s %10.2f %10s %10s %10s\r\n", label, values[0], L"-", L"-", L"-");
+    }
+    report += line;
+}
+
+/*
+ * Runs every backend (or only onlyMode) runs times and writes a report
+ *
+ * The first iteration of each backend is reported as the cold run: it
+ * pays for DirectWrite's first-use initialization and for font files
+ * not yet mapped in this process. The OS file cache may still be warm.
+ * Returns 0, or 2 if a backend failed.
+ */
+int RunBenchmark(EnumMode onlyMode, int runs, HANDLE hOutput)
+{
+    static const wchar_t* const stageNames[ENUM_STAGE_COUNT] = {
+        L"Factory", L"Font source", L"Names", L"Paths", L"Details", L"Store", L"Sort", L"Populate"
+    };
+    const EnumMode modes[] = {
+        EnumMode::GDI, EnumMode::DirectWrite, EnumMode::FontSet, EnumMode::OpenType, EnumMode::All, EnumMode::Folder
+    };
+
+    int exitCode = 0;
+    for (EnumMode mode : modes) {
+        if (onlyMode != EnumMode::None && mode != onlyMode) continue;
+        if (mode == EnumMode::Folder && onlyMode != EnumMode::Folder) continue;   // Needs --folder
+
+        std::vector<BenchmarkRun> results(runs);
+        const wchar_t* error = nullptr;
+        for (int r = 0; r < runs && !error; r++) {
+            error = RunBenchmarkIteration(mode, results[r]);
+        }
+
+        std::wstring report;
+        wchar_t line[200];
+        if (error) {
+            swprintf_s(line, L"%s: failed: %s\r\n\r\n", GetModeName(mode), error);
+            report += line;
+            exitCode = 2;
+        } else {
+            size_t fontCount = results.back().fontCount;
+            unsigned threads = 1;
+            if (mode == EnumMode::FontSet) {
+                threads = GetEnumThreadCount(static_cast<UINT32>(fontCount), FONTSET_CHUNK_SIZE);
+            } else if (mode == EnumMode::All) {
+                threads = GetEnumThreadCount(static_cast<UINT32>(fontCount), FONTSET_CHUNK_SIZE) + 2;
+            } else if (mode == EnumMode::Folder || mode == EnumMode::OpenType) {
+                threads = GetFolderReaderCount();
+            }
+            swprintf_s(line, L"%s: %zu fonts, %d run(s), %u thread(s)\r\n", GetModeName(mode), fontCount, runs, threads);
+            report += line;
+            swprintf_s(line, L"  %-14s %10s %10s %10s %10s\r\n", L"Stage", L"Cold ms", L"Min ms", L"Median ms", L"P95 ms");
+            report += line;
+
+            std::vector<double> values(runs);
+            for (size_t stage = 0; stage < ENUM_STAGE_COUNT; stage++) {
+                for (int r = 0; r < runs; r++) values[r] = results[r].stageMs[stage];
+                AppendBenchmarkRow(report, stageNames[stage], values);
+            }
+            for (int r = 0; r < runs; r++) values[r] = results[r].totalMs;
+            AppendBenchmarkRow(report, L"Total (wall)", values);
+
+            double minimum, median = values[0], p95;
+            if (runs > 1) {
+                SummarizeTimings(std::vector<double>(values.begin() + 1, values.end()), minimum, median, p95);
+            }
+            swprintf_s(line, L"  Throughput: %.0f fonts/s cold, %.0f fonts/s warm (median)\r\n",
+                values[0] > 0 ? fontCount * 1000.0 / values[0] : 0.0,
+                median > 0 ? fontCount * 1000.0 / median : 0.0);
+            report += line;
+
+            // Heap traffic of the enumerator itself (the store isn't counted)
+            const BenchmarkRun& last = results.back();
+            swprintf_s(line, L"  Heap: %llu allocations, %.1f KB (%.2f per font, last run)\r\n\r\n",
+                static_cast<unsigned long long>(last.allocations), last.allocatedBytes / 1024.0,
+                fontCount > 0 ? static_cast<double>(last.allocations) / fontCount : 0.0);
+            report += line;
+        }
+
+        std::string utf8;
+        AppendUtf8(utf8, report);
+        WriteAll(hOutput, utf8.data(), utf8.size());
+    }
+
+    std::string footnote;
+    AppendUtf8(footnote, L"Per-face stages of parallel (FontSet, All APIs) runs are summed across threads.\r\n");
+    WriteAll(hOutput, footnote.data(), footnote.size());
+
+    ClearFonts();
+    return exitCode;
+}
+
+/*
+ * Writes a message to the console the command was started from
+ */
+void PrintConsoleMessage(const wchar_t* text)
+{
+    HANDLE hError = GetStdHandle(STD_ERROR_HANDLE);
+    if (!hError || hError == INVALID_HANDLE_VALUE) return;
+
+    DWORD written = 0;
+    if (!WriteConsoleW(hError, text, static_cast<DWORD>(wcslen(text)), &written, NULL)) {
+        // Redirected: write UTF-8 instead
+        int size = WideCharToMultiByte(CP_UTF8, 0, text, -1, NULL, 0, NULL, NULL);
+        if (size > 1) {
+            std::string utf8(size, '\0');
+            WideCharToMultiByte(CP_UTF8, 0, text, -1, &utf8[0], size, NULL, NULL);
+            WriteAll(hError, utf8.data(), size - 1);
+        }
+    }
+}
+
+/*
+ * Returns true if the process was started with command-line options,
+ * i.e. should run headless
+ */
+bool IsCommandLineMode(int argc, wchar_t** argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (wcscmp(argv[i], L"--publish") == 0) continue;     // A window option
+        if (wcsncmp(argv[i], L"--", 2) == 0 || wcscmp(argv[i], L"/?") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Runs the headless export described by the command line
+ *
+ * Returns the process exit code: 0 on success, 1 for usage errors,
+ * 2 if enumeration failed and 3 if the output couldn't be written.
+ */
+int RunCommandLine(int argc, wchar_t** argv)
+{
+    static const wchar_t usage[] =
+        L"Usage: FontEnum.exe --mode=gdi|directwrite|fontset|all|opentype [--format=jsonl|csv]\r\n"
+        L"                    [--out=<file>] [--threads=<n>]\r\n"
+        L"       FontEnum.exe --folder=<dir> [--mode=opentype] [--format=...] [--out=<file>] [--threads=<n>]\r\n"
+        L"       FontEnum.exe --benchmark[=<runs>] [--mode=...] [--folder=<dir>] [--out=<file>] [--threads=<n>]\r\n"
+        L"       FontEnum.exe --publish    (window; shares the font list, see FontInventory.h)\r\n";
+
+    // Messages go to the console of the parent (cmd, PowerShell, agent)
+    AttachConsole(ATTACH_PARENT_PROCESS);
+
+    EnumMode mode = EnumMode::None;
+    OutputFormat format = OutputFormat::JsonLines;
+    const wchar_t* outPath = nullptr;
+    int benchmarkRuns = 0;
+    for (int i = 1; i < argc; i++) {
+        const wchar_t* arg = argv[i];
+        if (wcsncmp(arg, L"--mode=", 7) == 0) {
+            const wchar_t* value = arg + 7;
+            if (_wcsicmp(value, L"gdi") == 0) mode = EnumMode::GDI;
+            else if (_wcsicmp(value, L"directwrite") == 0 || _wcsicmp(value, L"dwrite") == 0) mode = EnumMode::DirectWrite;
+            else if (_wcsicmp(value, L"fontset") == 0) mode = EnumMode::FontSet;
+            else if (_wcsicmp(value, L"all") == 0) mode = EnumMode::All;
+            else if (_wcsicmp(value, L"opentype") == 0) mode = EnumMode::OpenType;
+            else mode = EnumMode::None;
+            if (mode == EnumMode::None) {
+                PrintConsoleMessage(L"Unknown --mode\r\n");
+                PrintConsoleMessage(usage);
+                return 1;
+            }
+        } else if (wcsncmp(arg, L"--format=", 9) == 0) {
+            const wchar_t* value = arg + 9;
+            if (_wcsicmp(value, L"jsonl") == 0 || _wcsicmp(value, L"json") == 0) {
+                format = OutputFormat::JsonLines;
+            } else if (_wcsicmp(value, L"csv") == 0) {
+                format = OutputFormat::Csv;
+            } else {
+                PrintConsoleMessage(L"Unknown --format\r\n");
+                PrintConsoleMessage(usage);
+                return 1;
+            }
+        } else if (wcsncmp(arg, L"--folder=", 9) == 0 && arg[9] != L'\0') {
+            g_folderPath = arg + 9;
+        } else if (wcsncmp(arg, L"--out=", 6) == 0 && arg[6] != L'\0') {
+            outPath = arg + 6;
+        } else if (wcscmp(arg, L"--benchmark") == 0) {
+            benchmarkRuns = BENCHMARK_DEFAULT_RUNS;
+        } else if (wcsncmp(arg, L"--benchmark=", 12) == 0) {
+            benchmarkRuns = (std::max)(_wtoi(arg + 12), 1);
+        } else if (wcsncmp(arg, L"--threads=", 10) == 0) {
+            // Digits only: wcstoul would take a sign and wrap "-1" around
+            const wchar_t* value = arg + 10;
+            wchar_t* end = nullptr;
+            unsigned long threads = iswdigit(value[0]) ? wcstoul(value, &end, 10) : ULONG_MAX;
+            if (!end || *end != L'\0' || threads > MAX_THREADS_OPTION) {
+                PrintConsoleMessage(L"Invalid --threads\r\n");
+                PrintConsoleMessage(usage);
+                return 1;
+            }
+            g_enumThreadCount = static_cast<unsigned>(threads);
+        } else {
+            PrintConsoleMessage(usage);
+            return wcscmp(arg, L"--help") == 0 || wcscmp(arg, L"/?") == 0 ? 0 : 1;
+        }
+    }
+    if (!g_folderPath.empty()) {
+        // A folder is read by Folder mode (the default) or the OpenType parser
+        if (mode == EnumMode::None) {
+            mode = EnumMode::Folder;
+        } else if (mode != EnumMode::OpenType) {
+            PrintConsoleMessage(L"--folder only works with --mode=opentype\r\n");
+            PrintConsoleMessage(usage);
+            return 1;
+        }
+    }
+    if (mode == EnumMode::None && benchmarkRuns == 0) {
+        PrintConsoleMessage(usage);
+        return 1;
+    }
+
+    HANDLE hOutput = NULL;
+    bool ownsOutput = false;
+    if (outPath) {
+        hOutput = CreateFileW(outPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        ownsOutput = true;
+    } else {
+        hOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        if (GetFileType(hOutput) == FILE_TYPE_CHAR) {
+            SetConsoleOutputCP(CP_UTF8);  // Output goes straight to the console
+        }
+    }
+    if (!hOutput || hOutput == INVALID_HANDLE_VALUE) {
+        PrintConsoleMessage(L"Cannot open the output\r\n");
+        return 3;
+    }
+
+    if (benchmarkRuns > 0) {
+        int exitCode = RunBenchmark(mode, benchmarkRuns, hOutput);
+        if (ownsOutput) CloseHandle(hOutput);
+        return exitCode;
+    }
+
+    FontOutputStream stream(hOutput, format, mode == EnumMode::All);
+    EnumJob job;
+    job.mode = mode;
+    job.folderPath = g_folderPath;
+    job.sink = &stream;
+    job.deferDetails = false;   // Nothing would fill them in later
+    RunEnumerator(job);
+    bool written = stream.Flush();
+    if (ownsOutput) CloseHandle(hOutput);
+
+    if (job.errorText) {
+        PrintConsoleMessage(job.errorText);
+        PrintConsoleMessage(L"\r\n");
+        return 2;
+    }
+    if (!written) {
+        PrintConsoleMessage(L"Failed to write the output\r\n");
+        return 3;
+    }
+    return 0;
+}
+
 // ============================================================================
 // ENTRY POINT
 // ============================================================================
@@ -1054,11 +8898,28 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow)
 {
     g_hInstance = hInstance;
+    TraceLoggingRegister(g_traceProvider);
+
+    // Options such as --mode=fontset run headless, without a window
+    if (IsCommandLineMode(__argc, __wargv)) {
+        int exitCode = RunCommandLine(__argc, __wargv);
+        ReleaseFontSession();
+        TraceLoggingUnregister(g_traceProvider);
+        return exitCode;
+    }
+
+    // --publish shares each completed list with other processes
+    for (int i = 1; i < __argc; i++) {
+        if (wcscmp(__wargv[i], L"--publish") == 0) g_publishInventory = true;
+    }
+
+    // The folder picker is a COM object created on this thread
+    HRESULT hrCom = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
 
     // Initialize common controls (required for ListView)
     INITCOMMONCONTROLSEX icex = {};
     icex.dwSize = sizeof(icex);
-    icex.dwICC = ICC_LISTVIEW_CLASSES;
+    icex.dwICC = ICC_LISTVIEW_CLASSES | ICC_BAR_CLASSES;   // ListView, axis trackbars
     InitCommonControlsEx(&icex);
 
     // Register the main window class
@@ -1085,7 +8946,7 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
         L"Font Enumerator - GDI, DirectWrite & FontSet API",
         WS_OVERLAPPEDWINDOW,
         CW_USEDEFAULT, CW_USEDEFAULT,  // Default position
-        1100, 650,                      // Initial size
+        1390, 650,                      // Initial size
         NULL, NULL, hInstance, NULL);
 
     if (!g_hWnd) {
@@ -1096,6 +8957,15 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
     ShowWindow(g_hWnd, nCmdShow);
     UpdateWindow(g_hWnd);
 
+    // Show the last enumeration right away; it is revalidated in the background
+    StartDetailWorker();
+    StartThumbnailWorker();
+    LoadStartupSnapshot();
+    StartFontWatcher();
+
+    // The window has painted; load DirectWrite's system fonts ahead of the first click
+    StartSessionWarmup();
+
     // Standard Win32 message loop
     MSG msg;
     while (GetMessage(&msg, NULL, 0, 0)) {
@@ -1103,5 +8973,8 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
         DispatchMessage(&msg);
     }
 
+    ReleaseFontSession();
+    if (SUCCEEDED(hrCom)) CoUninitialize();
+    TraceLoggingUnregister(g_traceProvider);
     return (int)msg.wParam;
 }